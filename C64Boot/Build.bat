@@ -1,2 +1,4 @@
 ..\Microcode\acme.exe -v3 --msvc BootROM.a
 ..\Microcode\acme.exe -v3 --msvc C64BootEntry.a
+..\Microcode\acme.exe -v3 --msvc CoProcessor.a
+..\Microcode\acme.exe -v3 --msvc -DCPU_65C02=1 BootROM.a
@@ -60,6 +60,10 @@ SOURCE=.\BootROM.a
 
 SOURCE=.\C64BootEntry.a
 # End Source File
+# Begin Source File
+
+SOURCE=.\CoProcessor.a
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -122,8 +122,9 @@ SOURCE=.\BASICROM.a
 InputPath=.\BASICROM.a
 InputName=BASICROM
 
-"../$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+"../$(InputName).bin" "../65C02/$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
 	ACME.exe --msvc $(InputName).a
+	ACME.exe --msvc -DCPU_65C02=1 $(InputName).a
 
 # End Custom Build
 
@@ -133,8 +134,9 @@ InputName=BASICROM
 InputPath=.\BASICROM.a
 InputName=BASICROM
 
-"../$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+"../$(InputName).bin" "../65C02/$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
 	ACME.exe --msvc $(InputName).a
+	ACME.exe --msvc -DCPU_65C02=1 $(InputName).a
 
 # End Custom Build
 
@@ -152,8 +154,9 @@ USERDEP__KERNA="LCD.a"
 InputPath=.\KernalROM.a
 InputName=KernalROM
 
-"../$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+"../$(InputName).bin" "../65C02/$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
 	ACME.exe --msvc $(InputName).a
+	ACME.exe --msvc -DCPU_65C02=1 $(InputName).a
 
 # End Custom Build
 
@@ -164,8 +167,9 @@ USERDEP__KERNA="LCD.a"
 InputPath=.\KernalROM.a
 InputName=KernalROM
 
-"../$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
+"../$(InputName).bin" "../65C02/$(InputName).bin" : $(SOURCE) "$(INTDIR)" "$(OUTDIR)"
 	ACME.exe --msvc $(InputName).a
+	ACME.exe --msvc -DCPU_65C02=1 $(InputName).a
 
 # End Custom Build
 
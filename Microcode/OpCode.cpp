@@ -4,6 +4,26 @@
 #include <assert.h>
 #include "OpCode.h"
 
+// Indexed by the kD2Const*ToDB values, these are the same for every opcode except kD2ConstContinuationToDB.
+// Index 0 is not used so a decoder 2 of kD2Unused with kD5ConstToDB does not look like a constant.
+const unsigned char kConstantGeneratorValues[16] =
+{
+	0xff , 0x04 , 0x40 , 0x80 , 0xfc , 0xfe , 0xfb , 0x7f ,
+	0x08 , 0xf7 , 0x9b , 0xbb , 0xfa , 0x01 , 0xff , 0xff
+};
+
+const TimingProfile kTimingProfiles[] =
+{
+	{ "3MHz-1tick" , 3.0 , 1 },
+	{ "4MHz-2tick" , 4.0 , 2 }
+};
+const int kNumTimingProfiles = sizeof(kTimingProfiles) / sizeof(kTimingProfiles[0]);
+
+static const TimingProfile *sTimingProfile = &kTimingProfiles[0];
+
+// The most hold states that can be added before one state
+static const int kMaxHoldStates = 4;
+
 State::State() : mState(0)
 {
 }
@@ -36,25 +56,106 @@ OpCode::~OpCode()
 {
 }
 
+void OpCode::SetTimingProfile(const TimingProfile &profile)
+{
+	sTimingProfile = &profile;
+}
+
 void OpCode::AddState(State &decoder1,State &decoder2,State &decoder3,State &decoder4,State &decoder5)
 {
-	mDecoders[0].push_back(decoder1.GetState());
-	mDecoders[1].push_back(decoder2.GetState());
-	mDecoders[2].push_back(decoder3.GetState());
-	mDecoders[3].push_back(decoder4.GetState());
-	mDecoders[4].push_back(decoder5.GetState());
+	assert(!mGotResetCycle && "This opcode has already got a kD1CycleReset, no more states allowed.");
 
-	mRealSize++;
+	const unsigned char states[kNumDecoders] = { decoder1.GetState() , decoder2.GetState() , decoder3.GetState() , decoder4.GetState() , decoder5.GetState() };
+	PushState(states);
+
+	// Always check the design rules the microcode is written for so that stretching does not hide a bug
+	const TimingProfile *profile = sTimingProfile;
+	sTimingProfile = &kTimingProfiles[0];
+	const bool valid = ValidateStates();
+	sTimingProfile = profile;
+	assert(valid && "Adding state fails design rules");
+
+	// Profiles with more stable ticks stretch the microcode by presenting the new state, or keeping the previous state, for
+	// longer with hold states until the new state passes their design rules.
+	// The PC counters load on the kD1PCInc clock after kD1PCLoad, so a hold state cannot go between the two.
+	const bool pcLoadPair = (mRealSize > 1) && ((mDecoders[0][mRealSize-2] & (kD1PCLoad | kD1PCInc)) == kD1PCLoad) &&
+		((states[0] & (kD1PCLoad | kD1PCInc)) == (kD1PCLoad | kD1PCInc));
+	int holds = 0;
+	while (!ValidateStates())
+	{
+		if (pcLoadPair)
+		{
+			StretchFailed(states,"a hold state cannot go between kD1PCLoad and kD1PCLoad | kD1PCInc");
+		}
+		if (holds >= kMaxHoldStates)
+		{
+			StretchFailed(states,"the state still fails the design rules after the most hold states");
+		}
+		holds++;
 
-	assert(!mGotResetCycle && "This opcode has already got a kD1CycleReset, no more states allowed.");
-	if ( (decoder1.GetState() & kD1CycleReset) == kD1CycleReset)
+		PopState();
+		PushHoldState(states);
+		if (!ValidateStates())
+		{
+			PopState();
+			assert(mDecoders[0].size() > 0);
+			unsigned char previous[kNumDecoders];
+			int i;
+			for (i=0;i<kNumDecoders;i++)
+			{
+				previous[i] = mDecoders[i].back();
+			}
+			PushHoldState(previous);
+			if (!ValidateStates())
+			{
+				StretchFailed(states,"the hold state for the previous state fails the design rules");
+			}
+		}
+		PushState(states);
+	}
+
+	if ( (states[0] & kD1CycleReset) == kD1CycleReset)
 	{
 		mGotResetCycle = true;
 	}
+}
+
+void OpCode::StretchFailed(const unsigned char *states,const char *reason)
+{
+	printf("Error: Cannot stretch the state at tick %d for timing profile %s, %s. Decoders $%02x $%02x $%02x $%02x $%02x\n",(int) mRealSize,
+		sTimingProfile->mName,reason,states[0],states[1],states[2],states[3],states[4]);
+	exit(-1);
+}
+
+void OpCode::PushState(const unsigned char *states)
+{
+	int i;
+	for (i=0;i<kNumDecoders;i++)
+	{
+		mDecoders[i].push_back(states[i]);
+	}
+	mRealSize++;
+}
 
-	assert(ValidateStates() && "Adding state fails design rules");
+void OpCode::PopState(void)
+{
+	int i;
+	for (i=0;i<kNumDecoders;i++)
+	{
+		mDecoders[i].pop_back();
+	}
+	mRealSize--;
+}
 
-	assert(mDecoders[0].size() <= 63 && "Too many states!");
+void OpCode::PushHoldState(const unsigned char *states)
+{
+	unsigned char hold[kNumDecoders];
+	hold[0] = states[0] & kD1PCToAddress;
+	hold[1] = states[1] & ~kD2DoBranchLoad;
+	hold[2] = states[2] & (15<<3);
+	hold[3] = 0;
+	hold[4] = states[4] & (kD5ConstToDB | kD5MulToDB | kD5ALUBank);
+	PushState(hold);
 }
 
 void OpCode::Append(const OpCode &fragment)
@@ -68,6 +169,8 @@ void OpCode::Append(const OpCode &fragment)
 
 void OpCode::Write(size_t index,FILE *fp)
 {
+	assert(mRealSize <= kMaxStates && "Too many states! Use SplitContinuation()");
+
 	// Make sure all the decoder is of a correct length and zeroed if needs be
 	mDecoders[index].resize(64,0);
 	size_t i;
@@ -77,6 +180,103 @@ void OpCode::Write(size_t index,FILE *fp)
 	}
 }
 
+void OpCode::Truncate(const size_t length)
+{
+	int i;
+	for (i=0;i<kNumDecoders;i++)
+	{
+		mDecoders[i].resize(length,0);
+	}
+	mRealSize = length;
+	mGotResetCycle = false;
+}
+
+bool OpCode::ValidatesFrom(const size_t pos)
+{
+	OpCode temp;
+	size_t i;
+	for (i=pos;i<mDecoders[0].size();i++)
+	{
+		int decoder;
+		for (decoder=0;decoder<kNumDecoders;decoder++)
+		{
+			temp.mDecoders[decoder].push_back(mDecoders[decoder][i]);
+		}
+		if (!temp.ValidateStates())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool OpCode::CanSplitAt(const size_t pos)
+{
+	if ( (pos == 0) || (pos >= mDecoders[0].size()) )
+	{
+		return false;
+	}
+
+	// The continuation is loaded into the opcode latch so a fetched opcode must not be waiting in the temporary opcode latch
+	size_t i;
+	for (i=0;i<pos;i++)
+	{
+		if (mDecoders[0][i] & kD1OpCodeLoad)
+		{
+			return false;
+		}
+	}
+
+	// Both halves of the continuation opcode are the same unless it is split from a do branch opcode, so kD2DoBranchLoad must happen before the split
+	for (i=pos;i<mDecoders[0].size();i++)
+	{
+		if (mDecoders[1][i] & kD2DoBranchLoad)
+		{
+			return false;
+		}
+	}
+
+	// The continuation states do not use the bus or the PC so do not split any bus access or PC load
+	if ( (mDecoders[1][pos-1] | mDecoders[1][pos]) & (kD2CPUWantBus | kD2CPUHasBus | kD2BUSDDR) )
+	{
+		return false;
+	}
+	if ( IsMemoryToDB(pos-1) || IsMemoryToDB(pos) || ((mDecoders[0][pos-1] | mDecoders[0][pos]) & (kD1RAMWrite | kD1PCLoad)) )
+	{
+		return false;
+	}
+
+	return ValidatesFrom(pos);
+}
+
+unsigned char OpCode::GetDataBusSource(const size_t pos)
+{
+	if ( (mDecoders[4][pos] & kD5ConstToDB) == kD5ConstToDB )
+	{
+		return (mDecoders[1][pos] & 15) | 16;
+	}
+	if ( (mDecoders[4][pos] & kD5MulToDB) == kD5MulToDB )
+	{
+		return (mDecoders[1][pos] & 15) | 32;
+	}
+	return mDecoders[1][pos] & 15;
+}
+
+bool OpCode::IsMemoryToDB(const size_t pos)
+{
+	if ( mDecoders[4][pos] & (kD5ConstToDB | kD5MulToDB) )
+	{
+		return false;
+	}
+	// kD2FFToDB also has the kD2MemoryToDB bits set so compare the whole data bus source
+	return (mDecoders[1][pos] & 15) == kD2MemoryToDB;
+}
+
+unsigned char OpCode::GetALUOp(const size_t pos)
+{
+	return (mDecoders[2][pos] & (15<<3)) | (mDecoders[4][pos] & kD5ALUBank);
+}
+
 // Validates the states currently in the opcode using the design rules for the hardware
 bool OpCode::ValidateStates(void)
 {
@@ -113,7 +313,7 @@ bool OpCode::ValidateStates(void)
 			return false;
 		}
 		// The data bus must be stable one cycle before
-		if ((mDecoders[1][pos] & 15) != (mDecoders[1][pos-1] & 15))
+		if (GetDataBusSource(pos) != GetDataBusSource(pos-1))
 		{
 			return false;
 		}
@@ -133,7 +333,7 @@ bool OpCode::ValidateStates(void)
 			return false;
 		}
 		// The data bus must be stable one cycle before
-		if ((mDecoders[1][pos] & 15) != (mDecoders[1][pos-1] & 15))
+		if (GetDataBusSource(pos) != GetDataBusSource(pos-1))
 		{
 			return false;
 		}
@@ -152,7 +352,7 @@ bool OpCode::ValidateStates(void)
 			return false;
 		}
 		// The data bus must be stable one cycle before
-		if ((mDecoders[1][pos] & 15) != (mDecoders[1][pos-1] & 15))
+		if (GetDataBusSource(pos) != GetDataBusSource(pos-1))
 		{
 			return false;
 		}
@@ -180,7 +380,7 @@ bool OpCode::ValidateStates(void)
 		// If kD2DoBranchLoad check the kD3ALUOp_ is stable before
 		if ( mDecoders[1][pos] & kD2DoBranchLoad )
 		{
-			if ((mDecoders[2][pos] & (15<<3)) != (mDecoders[2][pos-1] & (15<<3)))
+			if (GetALUOp(pos) != GetALUOp(pos-1))
 			{
 				return false;
 			}
@@ -199,7 +399,7 @@ bool OpCode::ValidateStates(void)
 				return false;
 			}
 			// The ALU op must be stable before
-			if ((mDecoders[2][pos] & (15<<3)) != (mDecoders[2][pos-1] & (15<<3)))
+			if (GetALUOp(pos) != GetALUOp(pos-1))
 			{
 				return false;
 			}
@@ -221,6 +421,27 @@ bool OpCode::ValidateStates(void)
 		}
 	}
 
+	// With more stable ticks the ALU op and inputs must also be stable for the extra ticks before kD2DoBranchLoad or kD3ALUResLoad
+	int tick;
+	if ( (mDecoders[1][pos] & kD2DoBranchLoad) || (mDecoders[2][pos] & kD3ALUResLoad) )
+	{
+		for (tick=2;tick<=sTimingProfile->mStableTicks;tick++)
+		{
+			if (pos < (size_t) tick)
+			{
+				return false;
+			}
+			if (GetALUOp(pos-tick+1) != GetALUOp(pos-tick))
+			{
+				return false;
+			}
+			if (mDecoders[2][pos-tick+1] & (kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load))
+			{
+				return false;
+			}
+		}
+	}
+
 	// One cycle after kD1OpCodeLoad the data bus must be stable.
 	if ( mDecoders[0][pos-1] & kD1OpCodeLoad)
 	{
@@ -230,14 +451,14 @@ bool OpCode::ValidateStates(void)
 			return false;
 		}
 		// The data bus must be stable one cycle after
-		if ((mDecoders[1][pos] & 15) != (mDecoders[1][pos-1] & 15))
+		if (GetDataBusSource(pos) != GetDataBusSource(pos-1))
 		{
 			return false;
 		}
 	}
 
 	// Must not swap between memory read and write memory, or vice versa, in next tick.
-	if ( ((mDecoders[1][pos] & kD2MemoryToDB) == kD2MemoryToDB) )
+	if ( IsMemoryToDB(pos) )
 	{
 		if ( ((mDecoders[0][pos-1] & kD1RAMWrite) == kD1RAMWrite) )
 		{
@@ -247,14 +468,14 @@ bool OpCode::ValidateStates(void)
 
 	if ( ((mDecoders[0][pos] & kD1RAMWrite) == kD1RAMWrite) )
 	{
-		if ( ((mDecoders[1][pos-1] & kD2MemoryToDB) == kD2MemoryToDB) )
+		if ( IsMemoryToDB(pos-1) )
 		{
 			return false;
 		}
 	}
 
 	// The address bus *must* be stable one tick before the memory is read from or written to.
-	if ( ((mDecoders[1][pos] & kD2MemoryToDB) == kD2MemoryToDB) || ((mDecoders[0][pos] & kD1RAMWrite) == kD1RAMWrite) )
+	if ( IsMemoryToDB(pos) || ((mDecoders[0][pos] & kD1RAMWrite) == kD1RAMWrite) )
 	{
 		// Check for stable address bus
 		if ( (mDecoders[0][pos] & kD1PCToAddress) != (mDecoders[0][pos-1] & kD1PCToAddress) )
@@ -273,6 +494,29 @@ bool OpCode::ValidateStates(void)
 		}
 	}
 
+	// With more stable ticks the address bus must also be stable for the extra ticks before and after the memory access
+	for (tick=2;tick<=sTimingProfile->mStableTicks;tick++)
+	{
+		if ( IsMemoryToDB(pos) || ((mDecoders[0][pos] & kD1RAMWrite) == kD1RAMWrite) )
+		{
+			if (pos < (size_t) tick)
+			{
+				return false;
+			}
+			if ( (mDecoders[0][pos-tick+1] & kD1PCToAddress) != (mDecoders[0][pos-tick] & kD1PCToAddress) )
+			{
+				return false;
+			}
+		}
+		if ( (pos >= (size_t) tick) && ((mDecoders[0][pos-tick] & kD1RAMWrite) == kD1RAMWrite) )
+		{
+			if ( (mDecoders[0][pos] & kD1PCToAddress) != (mDecoders[0][pos-1] & kD1PCToAddress) )
+			{
+				return false;
+			}
+		}
+	}
+
 	// Check that kD1PCLoad does not immediately happen before kD1PCToAddress to avoid timing problems.
 	if ( ((mDecoders[0][pos] & kD1PCToAddress) == kD1PCToAddress) )
 	{
@@ -283,15 +527,53 @@ bool OpCode::ValidateStates(void)
 	}
 
 
-	// Check that kD5IRQStateLE also has kD2STToDB and that kD2STToDB is stable one tick before.
+	// The SP counter must not count while R3 is being loaded or is on the data bus. After counting the data bus R3 output is not stable until the next tick.
+	if ( mDecoders[4][pos] & (kD5SPInc | kD5SPDec) )
+	{
+		if ( (mDecoders[4][pos] & (kD5SPInc | kD5SPDec)) == (kD5SPInc | kD5SPDec) )
+		{
+			return false;
+		}
+		if ( (mDecoders[3][pos] & kD4DBToR3) || (GetDataBusSource(pos) == kD2R3ToDB) )
+		{
+			return false;
+		}
+	}
+	if ( (GetDataBusSource(pos) == kD2R3ToDB) && (mDecoders[4][pos-1] & (kD5SPInc | kD5SPDec)) )
+	{
+		return false;
+	}
+
+	// kD5IRQStateLE tests the I flag mirror so it must not happen while the mirror is being loaded with kD4DBToST.
 	if ( (mDecoders[4][pos] & kD5IRQStateLE) == kD5IRQStateLE )
 	{
-		// Check for stable kD2STToDB
-		if ( (mDecoders[1][pos] & kD2STToDB) != kD2STToDB )
+		if ( (mDecoders[3][pos] & kD4DBToST) == kD4DBToST )
+		{
+			return false;
+		}
+	}
+
+	// The PC counters only load on the kD1PCInc clock when kD1PCLoad was already set in the tick before
+	if ( ((mDecoders[0][pos] & (kD1PCLoad | kD1PCInc)) == (kD1PCLoad | kD1PCInc)) && ((pos == 0) || !(mDecoders[0][pos-1] & kD1PCLoad)) )
+	{
+		return false;
+	}
+
+	// The constant generator has no constant for kD2Unused, so using it is a mistake
+	if ( ((mDecoders[4][pos] & kD5ConstToDB) == kD5ConstToDB) && ((mDecoders[1][pos] & 15) == kD2Unused) )
+	{
+		return false;
+	}
+
+	// The nybble multiply ROM is addressed by ALU in1 and in2 so they must not be loaded while it is on the data bus.
+	// It cannot be used at the same time as the constant generator.
+	if ( (mDecoders[4][pos] & kD5MulToDB) == kD5MulToDB )
+	{
+		if ( (mDecoders[4][pos] & kD5ConstToDB) == kD5ConstToDB )
 		{
 			return false;
 		}
-		if ( (mDecoders[1][pos-1] & kD2STToDB) != kD2STToDB )
+		if ( mDecoders[2][pos] & (kD3ALUIn1Load | kD3ALUIn2Load) )
 		{
 			return false;
 		}
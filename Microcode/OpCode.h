@@ -3,6 +3,11 @@
 
 #include <vector>
 
+const int kNumDecoders = 5;
+
+// The tick counter has 64 states but an opcode must use kD1CycleReset by the last one
+const size_t kMaxStates = 63;
+
 // Decoder 1
 const unsigned char kD1PCInc = (1<<0);			// It is possible to do a kD1PCInc and a kD2CycleReset and still have the PC increment
 const unsigned char kD1OpCodeLoad = (1<<1);		// Must not be executed directly after a kD1CycleReset
@@ -67,7 +72,7 @@ const unsigned char kD3ALUOp_Flags = 15 << 3;	// Both inputs set to be the same.
 
 const unsigned char kD3ALUResLoad = (1<<7);
 
-const unsigned char kALUInFlg_D = (1<<0);		// Not in terms of the real ALU input but in terms of the flags input variable
+const unsigned char kALUInFlg_D = (1<<0);		// Not in terms of the real ALU input but in terms of the flags input variable. Selects BCD for kD3ALUOp_Add and kD3ALUOp_Sub.
 const unsigned char kALUInFlg_C = (1<<1);		// Not in terms of the real ALU input but in terms of the flags input variable
 const unsigned char kALUInFlg_V = (1<<2);		// Not in terms of the real ALU input but in terms of the flags input variable
 	// kALUInFlg_Special comes from either bit 4 (lowest bit of the high nybble) of the second ALU input or the output of ALU 1 for those instructions that need to know what is coming from the high nybble.
@@ -90,9 +95,120 @@ const unsigned char kD4DBToR6 = (1<<6);
 const unsigned char kD4DBToST = (1<<7);
 
 // Decoder 5
-const unsigned char kD5IRQStateLE = (1<<0);
+const unsigned char kD5IRQStateLE = (1<<0);		// Latches EXTWANTIRQ gated with the I flag mirror into the IRQ state that selects the IRQ decoder bank, and the NMI edge latch into the NMI state that selects the NMI decoder banks. It must not be used with kD4DBToST.
 const unsigned char kD5IllegalOp = (1<<1);
 const unsigned char kD5IRQLineRST = (1<<2);
+const unsigned char kD5ConstToDB = (1<<3);		// Disables the decoder 2 data bus source selection and instead uses the lower nybble of decoder 2 to select a kD2Const* value from the constant generator onto the data bus.
+const unsigned char kD5SPInc = (1<<4);			// R3 (SP lo) is an up/down counter. It counts on the clock edge at the end of the tick so it must not be on the data bus or loaded in this tick or the next.
+const unsigned char kD5SPDec = (1<<5);			// See kD5SPInc
+const unsigned char kD5MulToDB = (1<<6);		// Like kD5ConstToDB but the nybble multiply ROM (MulROM.bin) is output onto the data bus. The lower nybble of decoder 2 is kD2Mul* to select the nybbles and the shift.
+const unsigned char kD5ALUBank = (1<<7);		// Address line A16 of both ALU ROMs, selects the kD3ALUOpX_* extended functions instead of kD3ALUOp_*. It is part of the ALU op so the same stable rules apply.
+
+// Decoder 3 ALU op values when used with kD5ALUBank
+const unsigned char kD3ALUOpX_SignExtend = 0 << 3;	// Both inputs set to be the same. Each nybble is filled with its top bit, ALU1 uses the special flag (bit 4 of ALU in2) as the top bit.
+		// ALU1 cannot see bit 7 so two passes are needed to sign extend a byte, the second pass uses the result of the first.
+const unsigned char kD3ALUOpX_ZToCarry = 1 << 3;	// Both inputs set to be status. Outputs the Z flag of the input as the carry for kD2DoBranchLoad.
+const unsigned char kD3ALUOpX_VToCarry = 2 << 3;	// Both inputs set to be status. Outputs the V flag of the input as the carry for kD2DoBranchLoad.
+const unsigned char kD3ALUOpX_BIT = 3 << 3;			// In1 is the accumulator, in2 is the memory and in3 is the status. Outputs in1 AND in2 with the 6502 BIT flags, the carry is preserved.
+
+// Calculates one ALU pass from the ALU ROM contents the same way the hardware combines both ALU ROMs, for the generator checks and the Simulator.
+// ALU1 gets the lo nybbles and the D/C/V flags from ALU in3 and the special flag from bit 4 of ALU in2. ALU2 gets the hi nybbles, D/V from ALU in3
+// but the carry and special flag come from the ALU1 output. d3 is the decoder 3 ALU op and d5 selects the extended bank with kD5ALUBank.
+// The resulting ST uses the 6502 layout, N V - B D I Z C
+inline void CalculateALU(const unsigned char *alu1ROM,const unsigned char *alu2ROM,const unsigned char d3,const unsigned char d5,const unsigned char in1,const unsigned char in2,const unsigned char in3,unsigned char &result,unsigned char &resultST)
+{
+	const int bank = (d5 & kD5ALUBank) ? (1<<16) : 0;
+	const int aluOp = (d3 >> 3) & 15;
+	unsigned char inFlags = 0;
+	if (in3 & (1<<3))
+	{
+		inFlags |= kALUInFlg_D;
+	}
+	if (in3 & (1<<0))
+	{
+		inFlags |= kALUInFlg_C;
+	}
+	if (in3 & (1<<6))
+	{
+		inFlags |= kALUInFlg_V;
+	}
+	unsigned char inFlags1 = inFlags;
+	if (in2 & (1<<4))
+	{
+		inFlags1 |= kALUInFlg_Special;
+	}
+	const unsigned char alu1 = alu1ROM[bank | (inFlags1 << 12) | ((in2 & 15) << 8) | ((in1 & 15) << 4) | aluOp];
+
+	unsigned char inFlags2 = inFlags & (kALUInFlg_D | kALUInFlg_V);
+	if (alu1 & kALUOutFlg_C)
+	{
+		inFlags2 |= kALUInFlg_C;
+	}
+	if (alu1 & kALU1OutFlg_Special)
+	{
+		inFlags2 |= kALUInFlg_Special;
+	}
+	const unsigned char alu2 = alu2ROM[bank | (inFlags2 << 12) | ((in2 >> 4) << 8) | ((in1 >> 4) << 4) | aluOp];
+
+	result = (alu1 & 15) | ((alu2 & 15) << 4);
+	resultST = in3 & ~((1<<7) | (1<<6) | (1<<1) | (1<<0));
+	if (alu2 & kALUOutFlg_C)
+	{
+		resultST |= (1<<0);
+	}
+	if ((alu1 & kALUOutFlg_Z) && (alu2 & kALUOutFlg_Z))
+	{
+		resultST |= (1<<1);
+	}
+	if (alu2 & kALUOutFlg_V)
+	{
+		resultST |= (1<<6);
+	}
+	if (alu2 & kALUOutFlg_N)
+	{
+		resultST |= (1<<7);
+	}
+}
+
+// Decoder 2 lower nybble values when used with kD5ConstToDB
+// The constant generator is a small ROM (ConstantROM.bin) with its output buffered onto the data bus.
+// It is addressed by the opcode latch and the lower nybble of decoder 2 so each opcode can have its own constants.
+const unsigned char kD2Const04ToDB = 1;			// ST I flag
+const unsigned char kD2Const40ToDB = 2;			// ST V flag
+const unsigned char kD2Const80ToDB = 3;			// ST N flag
+const unsigned char kD2ConstFCToDB = 4;			// The opcode for opStartIRQ
+const unsigned char kD2ConstFEToDB = 5;			// ST mask to clear the C flag, also the IRQ vector lo
+const unsigned char kD2ConstFBToDB = 6;			// ST mask to clear the I flag
+const unsigned char kD2Const7FToDB = 7;			// ST mask to clear the N flag
+const unsigned char kD2Const08ToDB = 8;			// ST D flag
+const unsigned char kD2ConstF7ToDB = 9;			// ST mask to clear the D flag
+const unsigned char kD2ConstMoveBlockLoopToDB = 10;	// The opcode for opMoveBlockLoop
+const unsigned char kD2ConstFillBlockLoopToDB = 11;	// The opcode for opFillBlockLoop
+const unsigned char kD2ConstFAToDB = 12;			// The NMI vector lo
+const unsigned char kD2Const01ToDB = 13;			// ST C flag, not 0 so it is not the same value as kD2Unused
+const unsigned char kD2ConstContinuationToDB = 15;	// The opcode that continues the current opcode, see Extensions::SplitContinuation()
+
+// Decoder 2 lower nybble bits when used with kD5MulToDB
+// Two 74HC157 select one nybble from each of ALU in1 and in2 for the nybble multiply ROM, the shift bits also address the ROM.
+const unsigned char kD2MulIn1Hi = (1<<0);		// Otherwise the lo nybble of ALU in1
+const unsigned char kD2MulIn2Hi = (1<<1);		// Otherwise the lo nybble of ALU in2
+const unsigned char kD2MulShl4 = (1<<2);		// Outputs the lo nybble of the product in the hi nybble
+const unsigned char kD2MulShr4 = (1<<3);		// Outputs the hi nybble of the product in the lo nybble. With kD2MulShl4 the product nybbles are swapped.
+
+extern const unsigned char kConstantGeneratorValues[16];
+
+// Timing rule profiles for ValidateStates(). mStableTicks is the number of ticks the ALU op and inputs must be stable
+// before kD3ALUResLoad/kD2DoBranchLoad and the number of ticks the address bus must be stable around memory accesses.
+// The first profile is the one the microcode is written for, see OpCode::AddState() for how the other profiles stretch it.
+struct TimingProfile
+{
+	const char *mName;
+	double mClockMHz;
+	int mStableTicks;
+};
+
+extern const TimingProfile kTimingProfiles[];
+extern const int kNumTimingProfiles;
 
 class State
 {
@@ -118,16 +234,45 @@ public:
 
 	void Write(size_t index,FILE *fp);
 
+	// Selects the design rules used by ValidateStates() for all opcodes built after this call
+	static void SetTimingProfile(const TimingProfile &profile);
+
 	// Validates the states currently in the opcode using the design rules for the hardware
 	bool ValidateStates(void);
 
+	// Returns true if the opcode can be split before the state at pos, with the states from pos onwards executed by a continuation opcode
+	bool CanSplitAt(const size_t pos);
+
 	size_t GetLength(void)
 	{
 		return mRealSize;
 	}
 
 protected:
-	std::vector<unsigned char> mDecoders[5];
+	// Returns the data bus source for the state, kD2*ToDB or kD2Const*ToDB | 16 if the constant generator is used or kD2Mul* | 32 for the nybble multiply ROM
+	unsigned char GetDataBusSource(const size_t pos);
+
+	bool IsMemoryToDB(const size_t pos);
+
+	// Returns the ALU op including kD5ALUBank for the state
+	unsigned char GetALUOp(const size_t pos);
+
+	// Removes the states from length onwards
+	void Truncate(const size_t length);
+
+	void PushState(const unsigned char *states);
+	void PopState(void);
+
+	// Prints why the state cannot be stretched for the timing profile and exits, the ROMs would not work so there is no point going on
+	void StretchFailed(const unsigned char *states,const char *reason);
+
+	// Pushes a copy of the state without its loads and strobes, so the data bus, address bus and ALU op are presented for one more tick
+	void PushHoldState(const unsigned char *states);
+
+	// Returns true if the states from pos onwards pass the design rules as an opcode starting from tick 0
+	bool ValidatesFrom(const size_t pos);
+
+	std::vector<unsigned char> mDecoders[kNumDecoders];
 	bool mGotResetCycle;
 	size_t mRealSize;
 };
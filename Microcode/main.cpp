@@ -1,7 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
+#include <algorithm>
 #include <assert.h>
+#include <direct.h>
 #include "OpCode.h"
 
 // General overview of the schematic and design
@@ -16,11 +19,27 @@
 // The special "boot" instruction 0xff goes through a sequence of loading the contents of 0xfffc/0xfffd into the program counter and executing code from there.
 
 // When EXTWANTIRQ goes lo it causes the next instruction to start the IRQ when U34:B is used to branch the end of the opcode between fetching the next instruction or starting the IRQ.
-// U4:C is used to test the loaded to data bus ST disable IRQ flag with EXTWANTIRQ.
+// U4:C is used to test the I flag mirror with EXTWANTIRQ. The mirror is a 74HC74 flip-flop that loads data bus bit 2 with
+// the same kD4DBToST strobe as the ST register, so the IRQ test does not need the ST on the data bus.
 // The CIA1 Emulation layer will use IRQTIMERCLOCK or the output of U204/U205 timers (if the counters are enabled in the simulation) which latch low to EXTWANTIRQ.
 // The CIA1 Emulation layer for the LCD example board will ACK the IRQ request (return EXTWANTIRQ to high) when the memory location CIA1InterruptControl is read. This is the same as the C64.
 // See the code around FindIRQLEAndReplace() and kD5IRQStateLE.
 
+// When EXTWANTNMI goes lo the falling edge sets the NMI edge latch. The same kD5IRQStateLE strobe loads the NMI edge latch,
+// without any I flag test, into the NMI state flip-flop which is the other half of the IRQ state 74HC74. The NMI state is
+// decoder ROM address line A16, so the decoder ROMs are 128K and the NMI banks are the upper half. When the NMI state
+// is set it asynchronously clears the NMI edge latch, so the next kD5IRQStateLE leaves the NMI bank.
+// The NMI banks ignore the IRQ state line, which gives NMI priority over IRQ, and they contain the IRQ enabled states
+// except opStartIRQ is replaced with opStartNMI to use the NMI vector at $fffa. So NMI needs no extra ticks in the fetch.
+
+// The opcodes that are loaded from the constant generator, with kD5ConstToDB in the kD1OpCodeLoad tick, run from the continuation banks.
+// The continuation flip-flop, a 74HC74 next to the opcode latch, loads kD5ConstToDB with kD1OpCodeLoad and its second half copies it
+// with kD1CycleReset, the same way the opcode moves from the temporary opcode latch. Its output is decoder ROM address line A17, so the
+// decoder ROMs are 256K and the continuation banks are the upper half, and constant generator ROM address line A12.
+// The continuation banks have opStartIRQ (opStartNMI in the NMI banks) at $fc, the block move and fill loops and the continuation
+// opcodes added by SplitContinuations(), everything else there is opIllegal. So the continuation opcodes do not use any opcode that
+// code can execute and the NMOS halt opcodes still trap.
+
 // RAM is located $0000-$9fff and $c000-$dfff
 // ROM is located $a000-$bfff and $e000-$ffff
 
@@ -43,6 +62,21 @@
 // DCDR4DLY Delays the register loads from the data bus (caused by decoder 4) so that register
 // loads can be completed in one cycle as the data bus is initialised by the decoder 2 at the
 // start of that cycle.
+// When kD5ConstToDB is set the decoder 2 data bus source select is disabled and the lower nybble of
+// decoder 2 instead addresses the constant generator ROM, ConstantROM.bin, which is buffered onto the
+// data bus. This provides the ST flag masks and the IRQ pseudo-opcodes in one tick instead of building
+// them with several ALU passes. See kD2Const*ToDB.
+// The constant generator ROM is also addressed by the opcode latch and the continuation flip-flop so kD2ConstContinuationToDB gives
+// each opcode its own continuation opcode, see SplitContinuation().
+// When kD5MulToDB is set the decoder 2 data bus source select is disabled in the same way and the nybble multiply ROM,
+// MulROM.bin, is buffered onto the data bus. Its address is one nybble from each of ALU in1 and in2, selected by two
+// 74HC157 using the lower nybble of decoder 2, and the kD2MulShl4/kD2MulShr4 bits. The 16 ALU ops are all used so this
+// gives the four nybble products of an 8x8 multiply without any ALU passes, see opMUL.
+
+// The microcode and the Simulator already use hardware that is described here but is not drawn in Processor8BitData16BitAddress.DSN yet:
+// The I flag mirror, the NMI edge latch and NMI state, the continuation flip-flop, the constant generator ROM, the nybble multiply ROM
+// with its 74HC157 selectors, the 74HC193 up/down counter for R3 and the ALU ROM A16 bank line. Each is described with the decoder
+// bits that drive it and the schematic needs all of them before these ROM images can run on the board.
 
 // Useful CPU references:
 // http://www.6502.org/tutorials/6502opcodes.html
@@ -142,21 +176,31 @@
 
 // To get this design running at 4MHz the ALU operations need slowing down.
 // Specifically kD3ALUResLoad and kD2DoBranchLoad need to have kD3ALUOp_* and kD3ALUIn*Load stable two cycles before.
-// However opCmp_IndZPAddr_Y runs out of opcode space.
+// This is the "4MHz-2tick" timing profile, see kTimingProfiles. The microcode is written for the "3MHz-1tick" profile and
+// OpCode::AddState() stretches it with hold states for the other profiles. The first profile's ROM set and OpCodeLengths.txt
+// are written to ../ for the schematic and each of the other profiles gets a complete set in ../Profiles/<name>/.
+// However opCmp_IndZPAddr_Y runs out of opcode space. Opcodes that are too long are now split into continuation
+// opcodes in the continuation banks by SplitContinuation().
 // * But since the whole design uses ROMs for the decoders then this isn't going to have any
 // helpful improvement.
 
-// If extra interrupts (like NMI not just IRQ) are supported at a later date then do what IRQ does, (NMI or IRQ), can be read from one of the other external lines perhaps.
-
 // Check kD2ALUResToDB and does not conflict with any ALU in load.
 
 // Check kD1PCInc does not happen for more than one consecutive state
 
-// Instead of using an ALU dec for the lo SP, maybe try hooking up the PC counter registers so that they can count backwards.
-// Can do this now because there is an extra decoder5 with free outputs.
+// R3 (SP lo) is an up/down counter (74HC193) that can still be loaded from the data bus with kD4DBToR3.
+// The decoder 5 outputs kD5SPInc/kD5SPDec count it on the clock edge at the end of the tick, so the stack opcodes
+// update the SP while the memory access uses the old value already latched in the addr lo.
+
+// Decimal mode is done by the ALU ROMs. When the D flag is in ALU in3 kD3ALUOp_Add and kD3ALUOp_Sub BCD correct each nybble.
+// For add ALU1 sends the BCD half carry to ALU2 with kALU1OutFlg_Special while its carry output is still the binary carry,
+// so ALU2 can calculate Z from the binary sum and N/V from the sum before the BCD correction like the NMOS 6502.
+// For subtract the NMOS 6502 flags are all from the binary result so only the nybbles are corrected after a borrow.
+// The ALU ops that calculate addresses load ALU in3 with zero or ALUTempST from zero, so they are never BCD.
 
-// Opcodes to be properly implemented at a later date but emulated with NOP for now
-// d8 f8	CLD/SED Don't make much sense since decimal mode is not yet supported by the ALU.
+// kD5ALUBank drives address line A16 of both ALU ROMs to select a second bank of 16 functions, the kD3ALUOpX_* values.
+// These replace multi-pass idioms: the branch offset sign extension in TakeBranch() is two kD3ALUOpX_SignExtend passes,
+// opExtractZFlag/opExtractVFlag use one kD3ALUOpX_ZToCarry/kD3ALUOpX_VToCarry pass and CommonBITOpcode() is one kD3ALUOpX_BIT pass.
 
 
 // At the moment the ALU shifts around the ST into kD2DoBranchLoad which gets its logic level from the ALU carry result ALUCARRY before it gets loaded by ALUTEMPST.
@@ -174,9 +218,38 @@
 // TODO - Will need an edge connector for the cartridge port.
 // Also some kind of latch/buffer with power separation in mind because the C64 power probably won't be enough to power all the ICs.
 
+// The addressing modes and operations of the undocumented NMOS 6502 opcodes, kUndocumentedOpcodes lists the opcodes built from them
+enum UndocumentedMode
+{
+	kUndocumentedIndZPAddr_X = 0,
+	kUndocumentedZPAddr,
+	kUndocumentedAddr,
+	kUndocumentedIndZPAddr_Y,
+	kUndocumentedZPAddr_X,
+	kUndocumentedZPAddr_Y,
+	kUndocumentedAddr_Y,
+	kUndocumentedAddr_X
+};
+
+enum UndocumentedOperation
+{
+	kUndocumentedSLO = 0,	// ASL then ORA
+	kUndocumentedRLA,		// ROL then AND
+	kUndocumentedSRE,		// LSR then EOR
+	kUndocumentedRRA,		// ROR then ADC
+	kUndocumentedSAX,		// Store A AND X
+	kUndocumentedLAX,		// LDA and LDX
+	kUndocumentedDCP,		// DEC then CMP
+	kUndocumentedISC		// INC then SBC
+};
+
 class Extensions : public OpCode
 {
 public:
+	Extensions() : mContinuation(-1)
+	{
+	}
+
 	void FindIRQLEAndReplace(void)
 	{
 		size_t i;
@@ -184,50 +257,61 @@ public:
 		{
 			if ( (mDecoders[4][i] & kD5IRQStateLE) == kD5IRQStateLE )
 			{
-				// We are replacing the actual state at the position plus one
-				i++;
-				mRealSize = i;
-				mGotResetCycle = false;
-
-				// MPi: TODO: Tidy this so that it uses kNumDecoders
-				mDecoders[0].resize(i,0);
-				mDecoders[1].resize(i,0);
-				mDecoders[2].resize(i,0);
-				mDecoders[3].resize(i,0);
-				mDecoders[4].resize(i,0);
-
-				// Calculate $fc ($ff << 2) using temp R5
-				AddState(State(),				State(kD2FFToDB));
-				AddState(State(),				State(kD2FFToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-				AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)		,State(kD4DBToR5));
-
-				AddState(State(),				State(kD2R5ToDB));
-				AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-
-				// Load into the opcode
-				AddState(State(kD1OpCodeLoad),	State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad));
-				AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl));
-				AddState(State(kD1CycleReset));
+				// The IRQ state is latched in the bus request tick of the fetch, so the bus read still completes as a dummy opcode fetch
+				// without kD1OpCodeLoad. We are replacing the state after the bus read onwards.
+				size_t end = i+1;
+				while ( (end < mDecoders[1].size()) && (mDecoders[1][end] & kD2CPUHasBus) )
+				{
+					mDecoders[0][end] &= ~kD1OpCodeLoad;
+					end++;
+				}
+				Truncate(end);
+
+				// Load $fc from the constant generator into the opcode
+				LoadOpCodeFromConstant(kD2ConstFCToDB);
 				return;
 			}
 		}
 	}
-	void FetchExec(const bool doIRQCheck = true)
+	// True if the opcode latches the IRQ state with kD5IRQStateLE, so it can be followed by opStartIRQ or opStartNMI
+	bool HasIRQCheck(void)
 	{
-		// If the opcode is quite short then we can do extra IRQ logic processing
-		if (doIRQCheck && (GetLength() < 50))
+		size_t i;
+		for (i=0;i<mDecoders[4].size();i++)
 		{
-			// This does an automatic comparison in hardware on latch load with the wantIRQ and the ST interrupt disable flag state
-			AddState(State(),			State(kD2STToDB),	State(),	State());
-			AddState(State(),			State(kD2STToDB),	State(),	State(),	State(kD5IRQStateLE));
-			AddState();	// Blank state to allow sync
-			// To get the interrupt to work at this point the IRQ version of the opcode needs to:
-			// Latch the IRQ request state with kD5IRQStateLE which is processed by the FindIRQLEAndReplace
-			// and if true and the IRQ disable bit from the ST is false (tested by the NOR from U4:C) it executes the extra pseudo-instruction 0xfc into the next opcode to do.
+			if ( (mDecoders[4][i] & kD5IRQStateLE) == kD5IRQStateLE )
+			{
+				return true;
+			}
 		}
+		return false;
+	}
+	// The length of the opcode in the IRQ and NMI banks, where FindIRQLEAndReplace() replaces the end of the fetch
+	size_t GetInterruptBankLength(void)
+	{
+		Extensions interruptBank(*this);
+		interruptBank.FindIRQLEAndReplace();
+		return interruptBank.GetLength();
+	}
+
+	// Writes the opcode for the IRQ and NMI banks without changing it, so the same opcode can also be written to other banks afterwards
+	void WriteInterruptBank(const size_t index,FILE *fp)
+	{
+		Extensions interruptBank(*this);
+		interruptBank.FindIRQLEAndReplace();
+		interruptBank.Write(index,fp);
+	}
+
+	void FetchExec(const bool doIRQCheck = true)
+	{
+		// The IRQ check is folded into the bus request tick of the fetch so it does not add any ticks.
+		// This does an automatic comparison in hardware on latch load with the wantIRQ and the I flag mirror.
+		// To get the interrupt to work at this point the IRQ version of the opcode needs to:
+		// Latch the IRQ request state with kD5IRQStateLE which is processed by the FindIRQLEAndReplace
+		// and if true and the I flag mirror is false (tested by the NOR from U4:C) it executes the extra pseudo-instruction 0xfc into the next opcode to do.
 
 		// Must always be this end for every opcode
-		LoadRegisterFromMemory(0,kD1OpCodeLoad | kD1PCToAddress);
+		LoadRegisterFromMemory(0,kD1OpCodeLoad | kD1PCToAddress,false,doIRQCheck ? kD5IRQStateLE : 0);
 
 		AddState(State(kD1CycleReset));
 	}
@@ -259,6 +343,118 @@ public:
 		AddState(State(),			State(kD2ALUTempSTToDB),	State(kD3ALUOp_Flags | kD3ALUResLoad)	,	State(kD4DBToST));
 	}
 
+	// ST = ST op constant, for example kD3ALUOp_Or with kD2Const04ToDB sets the I flag
+	void STALUOpWithConstant(const unsigned char constant,const unsigned char aluOp)
+	{
+		AddState(State(),			State(kD2STToDB));
+		AddState(State(),			State(kD2STToDB),		State(kD3ALUIn1Load));
+		AddState(State(),			State(constant),		State(),							State(),			State(kD5ConstToDB));
+		AddState(State(),			State(constant),		State(aluOp | kD3ALUIn2Load),		State(),			State(kD5ConstToDB));
+		AddState(State(),			State(kD2ALUResToDB),	State(aluOp | kD3ALUResLoad),		State(kD4DBToST));
+	}
+
+	// Loads the opcode from the constant generator and executes it from the next tick, the continuation flip-flop selects the continuation banks
+	void LoadOpCodeFromConstant(const unsigned char constant)
+	{
+		AddState(State(),				State(constant),	State(),	State(),	State(kD5ConstToDB));
+		AddState(State(kD1OpCodeLoad),	State(constant),	State(),	State(),	State(kD5ConstToDB));
+		AddState(State(kD1CycleReset),	State(constant),	State(),	State(),	State(kD5ConstToDB));
+	}
+
+	// Enters the IRQ or NMI operating level then loads the PC from the interrupt vector at $ff00 plus the vectorLo constant and starts executing from there.
+	// Stack PC (actual address, so that RTI does a FetchExec without pre-inc) then ST, the ST is loaded into ALU in1 while it is written
+	// and the I flag is set with the vector address PC loads. Each kD2CPUWantBus shares the tick with the stack address lo load.
+	void StartInterrupt(const unsigned char vectorLo)
+	{
+		// Get PC hi and lo to temp R6 and R5
+		AddState(State(kD1PCToAddress),	State(kD2ADDRWHToDB),	State(),	State(kD4DBToR6));
+		AddState(State(kD1PCToAddress),	State(kD2ADDRWLToDB),	State(),	State(kD4DBToR5));
+
+		// Prepare the address bus with the stack pointer, first SP hi
+		AddState(State(),				State(kD2R4ToDB));
+		AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
+
+		// Push PC hi, PC lo then ST, the SP lo counts down while the addr lo holds the old value
+		PushRegisterForInterrupt(kD2R6ToDB);
+		PushRegisterForInterrupt(kD2R5ToDB);
+		PushRegisterForInterrupt(kD2STToDB,kD3ALUIn1Load);
+
+		// 0xff to AddrH 
+		AddState(State(),				State(kD2FFToDB));
+		AddState(State(kD1AddrHLoad),	State(kD2FFToDB));
+
+		// The vector lo from the constant generator into AddrL
+		AddState(State(),				State(vectorLo),		State(),	State(),	State(kD5ConstToDB));
+		AddState(State(kD1AddrLLoad),	State(vectorLo),		State(),	State(),	State(kD5ConstToDB));
+
+		// Load into PC, remembering the load is actually done on the positive edge
+		// The data bus is not used by the PC load so the I flag for ST OR 4 goes to ALU in2 at the same time
+		AddState(State(kD1PCLoad),				State(kD2Const04ToDB),	State(),							State(),	State(kD5ConstToDB));
+		AddState(State(kD1PCLoad | kD1PCInc),	State(kD2Const04ToDB),	State(kD3ALUOp_Or | kD3ALUIn2Load),	State(),	State(kD5ConstToDB));
+
+		// The vector address is now in the PC
+		// Proceed to load the memory into the address lo and hi
+		LoadRegisterFromMemory(0,kD1AddrLLoad | kD1PCToAddress);
+		AddState(State(kD1PCInc));
+		LoadRegisterFromMemory(0,kD1AddrHLoad | kD1PCToAddress);
+
+		// Load PC from address fetched from memory and held in the memory input latches
+		// The ALU op is set with the PC load so no hold states are needed to separate the two PC load ticks
+		AddState(State(kD1PCLoad),				State(),				State(kD3ALUOp_Or));
+		AddState(State(kD1PCLoad | kD1PCInc),	State(),				State(kD3ALUOp_Or));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+		AddState(State(),						State(kD2ALUResToDB),	State(kD3ALUOp_Or | kD3ALUResLoad),	State(kD4DBToST));
+		// ST Now has I bit set, interrupts disabled.
+
+		FetchExec(false);	// No need for the IRQ check
+	}
+
+	// Writes the register to the stack at SP hi and SP lo, then decrements SP lo. The d3Write is used with the write, for example to load the ALU.
+	void PushRegisterForInterrupt(const unsigned char d2Register,const unsigned char d3Write = 0)
+	{
+		AddState(State(),				State(kD2R3ToDB));
+		AddState(State(kD1AddrLLoad),	State(kD2R3ToDB | kD2CPUWantBus));
+		AddState(State(),				State(kD2CPUHasBus | d2Register),	State(),	State(),	State(kD5SPDec));
+		AddState(State(kD1RAMWrite),	State(kD2CPUHasBus | d2Register),	State(d3Write));
+		AddState(State(),				State(kD2CPUHasBus | d2Register));
+	}
+
+	// Moves the states that do not fit into kMaxStates into the continuation opcode and replaces them with states that
+	// load the continuation opcode using kD2ConstContinuationToDB. The split happens as late as the design rules allow.
+	// The opcode is the slot of the continuation opcode in the continuation banks.
+	void SplitContinuation(Extensions &continuation,const int opcode)
+	{
+		const size_t pos = FindSplitPosition();
+		assert(pos > 0 && "Cannot find a position to split the opcode");
+
+		size_t i;
+		for (i=pos;i<GetLength();i++)
+		{
+			continuation.AddState(State(mDecoders[0][i]),State(mDecoders[1][i]),State(mDecoders[2][i]),State(mDecoders[3][i]),State(mDecoders[4][i]));
+		}
+
+		Truncate(pos);
+		LoadOpCodeFromConstant(kD2ConstContinuationToDB);
+		mContinuation = opcode;
+	}
+
+	// The position SplitContinuation() splits at, or 0 if the opcode cannot be split
+	size_t FindSplitPosition(void)
+	{
+		// Leave room for LoadOpCodeFromConstant()
+		size_t pos = kMaxStates - 3;
+		while ( (pos > 0) && !CanSplitAt(pos) )
+		{
+			pos--;
+		}
+		return pos;
+	}
+
+	// The slot of the continuation opcode in the continuation banks, or -1 if the opcode is not split
+	int GetContinuation(void)
+	{
+		return mContinuation;
+	}
+
 	// Also primes the ALU
 	void LoadImmediatePrimeALUPreInc(unsigned char d4Registers)
 	{
@@ -318,11 +514,26 @@ public:
 		AddState(State(kD1AddrHLoad),		State(kD2R6ToDB));
 	}
 
-	void LoadRegisterFromMemory(unsigned char d4Register,unsigned char d1Source = kD1AddrToAddress,const bool primeALU = false)
+	// The 65C02 does not have the wrap bug, so load the PC with the address latches and read the address lo and hi through the PC
+	// since it increments across pages. The PC is then ready to be loaded with the address latches.
+	void LoadIndAddrThroughPC(void)
+	{
+		AddState(State(kD1PCLoad));
+		AddState(State(kD1PCLoad | kD1PCInc));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+		AddState();
+		LoadRegisterFromMemory(0,kD1PCToAddress | kD1AddrLLoad);
+		AddState(State(kD1PCInc));
+		LoadRegisterFromMemory(0,kD1PCToAddress | kD1AddrHLoad);
+	}
+
+	// With flagsALUOp the read also runs d3ALUOp with the ST as ALU in3, for opcodes that calculate flags from memory.
+	// The ST must be on the data bus the tick before, it is loaded into in3 in the bus request tick, the memory is loaded into in2
+	// and the ALU result is loaded in the last tick. d5 is used for every tick of the read instead of only the bus request.
+	void LoadRegisterFromMemory(unsigned char d4Register,unsigned char d1Source = kD1AddrToAddress,const bool primeALU = false,unsigned char d5 = 0,const bool flagsALUOp = false,const unsigned char d3ALUOp = 0)
 	{
 		if (d1Source & kD1OpCodeLoad)
 		{
-			AddState(State(),State(kD2CPUWantBus));
+			AddState(State(),State(kD2CPUWantBus),State(),State(),State(d5));
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus));
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus | kD2MemoryToDB));
 			if (primeALU)
@@ -336,9 +547,17 @@ public:
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus | kD2MemoryToDB));
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus));
 		}
+		else if (flagsALUOp)
+		{
+			AddState(State(),State(kD2STToDB | kD2CPUWantBus),State(d3ALUOp | kD3ALUIn3Load),State(),State(d5));
+			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus),	State(d3ALUOp),	State(),	State(d5));
+			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus | kD2MemoryToDB),	State(d3ALUOp),	State(),	State(d5));
+			AddState(State(d1Source),		State(kD2BUSDDR | kD2CPUHasBus | kD2MemoryToDB),	State(d3ALUOp | kD3ALUIn2Load),	State(d4Register),	State(d5));
+			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus),	State(d3ALUOp | kD3ALUResLoad),	State(),	State(d5));
+		}
 		else
 		{
-			AddState(State(),State(kD2CPUWantBus));
+			AddState(State(),State(kD2CPUWantBus),State(),State(),State(d5));
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus));
 			AddState(State(d1Source & kD1PCToAddress),		State(kD2BUSDDR | kD2CPUHasBus | kD2MemoryToDB));
 			if (primeALU)
@@ -353,9 +572,9 @@ public:
 		}
 	}
 
-	void WriteRegisterToMemory(unsigned char d2Register,unsigned char d3ALUOp = 0,unsigned char d1Source = kD1AddrToAddress)
+	void WriteRegisterToMemory(unsigned char d2Register,unsigned char d3ALUOp = 0,unsigned char d1Source = kD1AddrToAddress,unsigned char d5 = 0)
 	{
-		AddState(State(),State(kD2CPUWantBus));
+		AddState(State(),State(kD2CPUWantBus),State(),State(),State(d5));
 		AddState(State(d1Source),						State(kD2CPUHasBus | d2Register),	State(d3ALUOp));
 		AddState(State(d1Source | kD1RAMWrite),			State(kD2CPUHasBus | d2Register),	State(d3ALUOp));
 		AddState(State(d1Source),						State(kD2CPUHasBus | d2Register),	State(d3ALUOp));
@@ -469,29 +688,11 @@ public:
 		// Get the next byte (branch offset) into ALU in1/2 and also int temp R5
 		LoadImmediatePrimeALUPreInc(kD4DBToR5);
 
-		// Get the upper bit into carry and sign extend it into temp R6
-		// Shift b7 to carry
-		AddState(State(),	State(kD2ALUTempSTToDB),	State(kD3ALUOp_Lsl));
-//		AddState(State(),	State(kD2ALUTempSTToDB),	State(kD3ALUOp_Lsl));	// Remove this?
-		AddState(State(),	State(kD2ALUTempSTToDB),	State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR6));
-		// Get carry into bit by shifting it into the bottom of 0
-		AddState(State(),	State(kD2R6ToDB));
-		AddState(State(),	State(kD2R6ToDB),	State(kD3ALUIn3Load));
-		AddState(State(),	State(kD2ZeroToDB));
-		AddState(State(),	State(kD2ZeroToDB),	State(kD3ALUOp_Rol | kD3ALUIn1Load | kD3ALUIn2Load));
-//		AddState(State(),	State(),	State(kD3ALUOp_Rol));	// Remove this?
-		AddState(State(),	State(),	State(kD3ALUOp_Rol | kD3ALUResLoad));
-		// Get 0 or 1 and xor with 0xff
-		AddState(State(),	State(kD2ALUResToDB));
-		AddState(State(),	State(kD2ALUResToDB),	State(kD3ALUIn1Load));
-		AddState(State(),	State(kD2FFToDB));
-		AddState(State(),	State(kD2FFToDB),	State(kD3ALUOp_Xor | kD3ALUIn2Load));
-//		AddState(State(),	State(),	State(kD3ALUOp_Xor));	// Remove this?
-		AddState(State(),	State(),	State(kD3ALUOp_Xor | kD3ALUResLoad));
-		// Now inc
-		AddState(State(),	State(kD2ALUResToDB));
-		AddState(State(),	State(kD2ALUResToDB),	State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load));
-		AddState(State(),	State(kD2ALUResToDB),	State(kD3ALUOp_Inc | kD3ALUResLoad)	,	State(kD4DBToR6));
+		// Sign extend it into temp R6, the first pass gets the hi nybble right and the second pass the lo nybble
+		AddState(State(),	State(),					State(kD3ALUOpX_SignExtend),									State(),	State(kD5ALUBank));
+		AddState(State(),	State(kD2ALUResToDB),		State(kD3ALUOpX_SignExtend | kD3ALUResLoad),					State(),	State(kD5ALUBank));
+		AddState(State(),	State(kD2ALUResToDB),		State(kD3ALUOpX_SignExtend | kD3ALUIn1Load | kD3ALUIn2Load),	State(),	State(kD5ALUBank));
+		AddState(State(),	State(kD2ALUResToDB),		State(kD3ALUOpX_SignExtend | kD3ALUResLoad),	State(kD4DBToR6),	State(kD5ALUBank));
 		// Get the lo byte of the PC to ALU in1
 		AddState(State(kD1PCToAddress),	State(kD2ADDRWLToDB),		State());
 		AddState(State(kD1PCToAddress),	State(kD2ADDRWLToDB),		State(kD3ALUIn1Load));
@@ -534,54 +735,658 @@ public:
 		FetchExecPreInc();
 	}
 
+	// For the undocumented opcodes that shift memory and then use the result with A, for example SLO is ASL then ORA.
+	// The shift sets the carry used by the second ALU operation, which RRA needs for the ADC.
+	void ShiftMemoryThenRegisterALUOp(unsigned char d3ShiftOp,unsigned char d3ALUOp)
+	{
+		LoadRegisterFromMemory(kD4DBToR5);
+		RegisterSimpleALUOp(kD2R5ToDB,d3ShiftOp,kD4DBToR5);
+		WriteRegisterToMemory(kD2R5ToDB);
+		AddState(State(),		State(kD2R5ToDB));
+		AddState(State(),		State(kD2R5ToDB),	State(kD3ALUIn2Load));
+		RegisterALUOp(kD2R0ToDB,d3ALUOp,kD4DBToR0);
+	}
+
+	// For the undocumented opcodes that inc or dec memory and then use the result with A, for example DCP is DEC then CMP.
+	// The flags are not updated since the following ALU operation sets them. The result is left in ALU in2.
+	void IncDecMemoryToALU(unsigned char d3ALUOp)
+	{
+		STToALU();
+		LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+		AddState(State(kD1AddrToAddress),	State(kD2ALUResToDB),		State(d3ALUOp));
+		AddState(State(kD1AddrToAddress),	State(kD2ALUResToDB),		State(d3ALUOp | kD3ALUResLoad));
+		WriteRegisterToMemory(kD2ALUResToDB,d3ALUOp);
+		AddState(State(),					State(kD2ALUResToDB),		State(d3ALUOp | kD3ALUIn2Load));
+	}
+
+	// For the undocumented SAX, writes A AND X to memory without changing the flags
+	void WriteAAndXToMemory(void)
+	{
+		AddState(State(),		State(kD2R0ToDB));
+		AddState(State(),		State(kD2R0ToDB),		State(kD3ALUIn1Load));
+		AddState(State(),		State(kD2R1ToDB));
+		AddState(State(),		State(kD2R1ToDB),		State(kD3ALUOp_And | kD3ALUIn2Load));
+		AddState(State(),		State(kD2ALUResToDB),	State(kD3ALUOp_And | kD3ALUResLoad));
+		WriteRegisterToMemory(kD2ALUResToDB);
+	}
+
+	// Loads the address latches for an undocumented opcode the same way as the documented opcodes with that addressing mode
+	void LoadUndocumentedAddress(const UndocumentedMode mode)
+	{
+		switch(mode)
+		{
+		case kUndocumentedIndZPAddr_X:
+			LoadZeroPageAddressFromPCMemoryWithPreInc();
+			AddRegisterToZeroPageAddress(kD2R1ToDB);
+			LoadIndAddrWith6502WrapBug();
+			break;
+		case kUndocumentedZPAddr:
+			LoadZeroPageAddressFromPCMemoryWithPreInc();
+			break;
+		case kUndocumentedAddr:
+			LoadAbsoluteAddressFromPCMemoryWithPreInc();
+			break;
+		case kUndocumentedIndZPAddr_Y:
+			LoadZeroPageAddressFromPCMemoryWithPreInc();
+			LoadIndAddrWith6502WrapBug();
+			AddRegisterToAddress(kD2R2ToDB);
+			break;
+		case kUndocumentedZPAddr_X:
+			LoadZeroPageAddressFromPCMemoryWithPreInc();
+			AddRegisterToZeroPageAddress(kD2R1ToDB);
+			break;
+		case kUndocumentedZPAddr_Y:
+			LoadZeroPageAddressFromPCMemoryWithPreInc();
+			AddRegisterToZeroPageAddress(kD2R2ToDB);
+			break;
+		case kUndocumentedAddr_Y:
+			LoadAbsoluteAddressFromPCMemoryWithPreInc();
+			AddRegisterToAddress(kD2R2ToDB);
+			break;
+		case kUndocumentedAddr_X:
+			LoadAbsoluteAddressFromPCMemoryWithPreInc();
+			AddRegisterToAddress(kD2R1ToDB);
+			break;
+		}
+	}
+
+	// The memory and register part of an undocumented opcode, after LoadUndocumentedAddress()
+	void DoUndocumentedOperation(const UndocumentedOperation operation)
+	{
+		switch(operation)
+		{
+		case kUndocumentedSLO:
+			ShiftMemoryThenRegisterALUOp(kD3ALUOp_Lsl,kD3ALUOp_Or);
+			break;
+		case kUndocumentedRLA:
+			ShiftMemoryThenRegisterALUOp(kD3ALUOp_Rol,kD3ALUOp_And);
+			break;
+		case kUndocumentedSRE:
+			ShiftMemoryThenRegisterALUOp(kD3ALUOp_Lsr,kD3ALUOp_Xor);
+			break;
+		case kUndocumentedRRA:
+			ShiftMemoryThenRegisterALUOp(kD3ALUOp_Ror,kD3ALUOp_Add);
+			break;
+		case kUndocumentedSAX:
+			WriteAAndXToMemory();
+			break;
+		case kUndocumentedLAX:
+			LoadRegisterFromMemory(kD4DBToR0 | kD4DBToR1,kD1AddrToAddress,true);
+			LoadFlagsDoFlags();
+			break;
+		case kUndocumentedDCP:
+			IncDecMemoryToALU(kD3ALUOp_Dec);
+			CompareCommon(kD2R0ToDB);
+			break;
+		case kUndocumentedISC:
+			IncDecMemoryToALU(kD3ALUOp_Inc);
+			RegisterALUOp(kD2R0ToDB,kD3ALUOp_Sub,kD4DBToR0);
+			break;
+		}
+	}
+
+	// For the 65C02 TSB and TRB. Z is set from A AND memory and the other flags are preserved.
+	// Then the memory is written with A OR memory for TSB, or NOT A AND memory for TRB.
+	void TestAndSetOrResetBits(const bool set)
+	{
+		LoadRegisterFromMemory(kD4DBToR5);
+		// A AND memory, the flags go into temp r6
+		STToALU();
+		AddState(State(),		State(kD2R0ToDB));
+		AddState(State(),		State(kD2R0ToDB),			State(kD3ALUIn1Load));
+		AddState(State(),		State(kD2R5ToDB));
+		AddState(State(),		State(kD2R5ToDB),			State(kD3ALUOp_And | kD3ALUIn2Load));
+		AddState(State(),		State(kD2ALUTempSTToDB),	State(kD3ALUOp_And | kD3ALUResLoad),	State(kD4DBToR6));
+		// The AND also set N, so keep everything except N from temp r6
+		AddState(State(),		State(kD2R6ToDB));
+		AddState(State(),		State(kD2R6ToDB),			State(kD3ALUIn1Load));
+		AddState(State(),		State(kD2Const7FToDB),		State(),								State(),				State(kD5ConstToDB));
+		AddState(State(),		State(kD2Const7FToDB),		State(kD3ALUOp_And | kD3ALUIn2Load),	State(),				State(kD5ConstToDB));
+		AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_And | kD3ALUResLoad),	State(kD4DBToR6));
+		// Then OR in the N from the real ST
+		AddState(State(),		State(kD2STToDB));
+		AddState(State(),		State(kD2STToDB),			State(kD3ALUIn1Load));
+		AddState(State(),		State(kD2Const80ToDB),		State(),								State(),				State(kD5ConstToDB));
+		AddState(State(),		State(kD2Const80ToDB),		State(kD3ALUOp_And | kD3ALUIn2Load),	State(),				State(kD5ConstToDB));
+		AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_And | kD3ALUResLoad));
+		AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUIn1Load));
+		AddState(State(),		State(kD2R6ToDB));
+		AddState(State(),		State(kD2R6ToDB),			State(kD3ALUOp_Or | kD3ALUIn2Load));
+		AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Or | kD3ALUResLoad),		State(kD4DBToST));
+		// Now the memory result
+		if (set)
+		{
+			AddState(State(),		State(kD2R0ToDB));
+			AddState(State(),		State(kD2R0ToDB),			State(kD3ALUIn1Load));
+			AddState(State(),		State(kD2R5ToDB));
+			AddState(State(),		State(kD2R5ToDB),			State(kD3ALUOp_Or | kD3ALUIn2Load));
+			AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Or | kD3ALUResLoad));
+			WriteRegisterToMemory(kD2ALUResToDB,kD3ALUOp_Or);
+		}
+		else
+		{
+			AddState(State(),		State(kD2R0ToDB));
+			AddState(State(),		State(kD2R0ToDB),			State(kD3ALUIn1Load));
+			AddState(State(),		State(kD2FFToDB));
+			AddState(State(),		State(kD2FFToDB),			State(kD3ALUOp_Xor | kD3ALUIn2Load));
+			AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Xor | kD3ALUResLoad));
+			AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUIn1Load));
+			AddState(State(),		State(kD2R5ToDB));
+			AddState(State(),		State(kD2R5ToDB),			State(kD3ALUOp_And | kD3ALUIn2Load));
+			AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_And | kD3ALUResLoad));
+			WriteRegisterToMemory(kD2ALUResToDB,kD3ALUOp_And);
+		}
+	}
+
+	// For the block move and fill opcodes. The zero page operand points to the destination pointer, then for a move the source pointer.
+	// The PC is saved in temp r5/r6 and then used as the destination pointer since kD1PCInc is free, the source pointer is loaded
+	// into the address latches. Since the PC walks through the pointers they must not wrap around zero page.
+	void LoadBlockPointers(const bool withSource)
+	{
+		LoadZeroPageAddressFromPCMemoryWithPreInc();
+		// Save the PC, see EndBlock()
+		AddState(State(kD1PCToAddress),		State(kD2ADDRWLToDB),	State(),	State(kD4DBToR5));
+		AddState(State(kD1PCToAddress),		State(kD2ADDRWHToDB),	State(),	State(kD4DBToR6));
+		LoadIndAddrThroughPC();
+		if (withSource)
+		{
+			// The address latches hold the destination pointer so the source pointer lo is held in the ALU result and the hi in the ALU inputs
+			AddState(State(kD1PCInc));
+			LoadRegisterFromMemory(0,kD1PCToAddress,true);
+			AddState(State(),				State(),				State(kD3ALUOp_Or));
+			AddState(State(),				State(),				State(kD3ALUOp_Or | kD3ALUResLoad));
+			AddState(State(kD1PCInc));
+			LoadRegisterFromMemory(0,kD1PCToAddress,true);
+		}
+		AddState(State(kD1PCLoad));
+		AddState(State(kD1PCLoad | kD1PCInc));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+		AddState();
+		if (withSource)
+		{
+			AddState(State(),				State(kD2ALUResToDB));
+			AddState(State(kD1AddrLLoad),	State(kD2ALUResToDB));
+			AddState(State(),				State(),				State(kD3ALUOp_Or));
+			AddState(State(),				State(kD2ALUResToDB),	State(kD3ALUOp_Or | kD3ALUResLoad));
+			AddState(State(kD1AddrHLoad),	State(kD2ALUResToDB));
+		}
+	}
+
+	// X is the number of bytes left minus one, like the 65816 MVN. X = X - 1 and the carry (no borrow) for kD2DoBranchLoad is set
+	// when there are more bytes. This leaves ALU in2 as zero for IncrementSourcePointer().
+	void DecrementBlockCount(void)
+	{
+		// In3 is zero so the subtract is never BCD
+		AddState(State(),			State(kD2ZeroToDB));
+		AddState(State(),			State(kD2ZeroToDB),		State(kD3ALUIn2Load | kD3ALUIn3Load));
+		AddState(State(),			State(kD2R1ToDB));
+		AddState(State(),			State(kD2R1ToDB),		State(kD3ALUOp_Sub | kD3ALUIn1Load));
+		AddState(State(),			State(kD2ALUResToDB),	State(kD3ALUOp_Sub | kD3ALUResLoad),	State(kD4DBToR1));
+		AddState(State(),			State(kD2DoBranchLoad),	State(kD3ALUOp_Sub));
+		AddState();	// Blank state to allow sync
+	}
+
+	// Increments the source pointer in the address latches, also increments the destination pointer in the PC. Expects ALU in2 to be zero.
+	void IncrementBlockPointers(void)
+	{
+		AddState(State(kD1AddrToAddress | kD1PCInc),	State(kD2ADDRWLToDB));
+		AddState(State(kD1AddrToAddress),				State(kD2ADDRWLToDB),		State(kD3ALUIn1Load));
+		AddState(State(),					State(kD2Const01ToDB),		State(),								State(),	State(kD5ConstToDB));
+		AddState(State(),					State(kD2Const01ToDB),		State(kD3ALUOp_Add | kD3ALUIn3Load),	State(),	State(kD5ConstToDB));
+		AddState(State(),					State(kD2ALUResToDB),		State(kD3ALUOp_Add | kD3ALUResLoad));
+		AddState(State(kD1AddrLLoad),		State(kD2ALUResToDB),		State(kD3ALUOp_Add));
+		// Use the carry
+		AddState(State(),					State(kD2ALUTempSTToDB));
+		AddState(State(),					State(kD2ALUTempSTToDB),	State(kD3ALUIn3Load));
+		AddState(State(kD1AddrToAddress),	State(kD2ADDRWHToDB));
+		AddState(State(kD1AddrToAddress),	State(kD2ADDRWHToDB),		State(kD3ALUOp_Add | kD3ALUIn1Load));
+		AddState(State(),					State(kD2ALUResToDB),		State(kD3ALUOp_Add | kD3ALUResLoad));
+		AddState(State(kD1AddrHLoad),		State(kD2ALUResToDB),		State(kD3ALUOp_Add));
+	}
+
+	// Restores the PC saved by LoadBlockPointers() and fetches the next opcode
+	void EndBlock(void)
+	{
+		AddState(State(),					State(kD2R5ToDB));
+		AddState(State(kD1AddrLLoad),		State(kD2R5ToDB));
+		AddState(State(),					State(kD2R6ToDB));
+		AddState(State(kD1AddrHLoad),		State(kD2R6ToDB));
+		AddState(State(kD1PCLoad));
+		AddState(State(kD1PCLoad | kD1PCInc));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+		AddState();
+		FetchExecPreInc();
+	}
+
+	// Loads the register, or the address latches using d1Load, with a product from the nybble multiply ROM
+	void NybbleProductToRegister(const unsigned char d2Mul,const unsigned char d1Load,const unsigned char d4Register)
+	{
+		AddState(State(),				State(d2Mul),	State(),	State(),			State(kD5MulToDB));
+		AddState(State(d1Load),			State(d2Mul),	State(),	State(d4Register),	State(kD5MulToDB));
+	}
+
+	// ALU in1 = d2In1, ALU in2 = d2In2, with the ALU in3 flags already loaded, then stores the add result into the register
+	void AddRegistersToRegister(const unsigned char d2In1,const unsigned char d2In2,const unsigned char d4Register)
+	{
+		AddState(State(),		State(d2In1));
+		AddState(State(),		State(d2In1),			State(kD3ALUIn1Load));
+		AddState(State(),		State(d2In2));
+		AddState(State(),		State(d2In2),			State(kD3ALUOp_Add | kD3ALUIn2Load));
+		AddState(State(),		State(kD2ALUResToDB),	State(kD3ALUOp_Add | kD3ALUResLoad),	State(d4Register));
+	}
+
 	// BIT sets the Z flag as though the value in the address tested were ANDed with the accumulator.
 	// The N and V flags are set to match bits 7 and 6 respectively in the value stored at the tested address. 
-	// Load mem into ALU
+	// The accumulator goes to ALU in1 before the read so the memory only needs to be read once into ALU in2.
+	// The read runs the extended BIT function with the ST, which calculates N, V and Z and preserves the other flags in one ALU pass,
+	// and the PC increment for the next opcode is done with the ST load.
 	void CommonBITOpcode(void)
 	{
-		LoadRegisterFromMemory(0,kD1AddrToAddress,true);
-		// Blank ST for this temp calc AND
 		AddState(State(),			State(kD2R0ToDB));
 		AddState(State(),			State(kD2R0ToDB),			State(kD3ALUIn1Load));
-		AddState(State(),			State(kD2ZeroToDB));
-		AddState(State(),			State(kD2ZeroToDB),			State(kD3ALUOp_And | kD3ALUIn3Load));
-		AddState(State(),			State(),		State(kD3ALUOp_And | kD3ALUResLoad));
-		// Setup the extended operation flag once here
-		AddState(State(),			State(kD2FFToDB));
-		AddState(State(),			State(kD2FFToDB),			State(kD3ALUIn3Load));
-		// Now extract just the Z flag using the pattern generator
-		AddState(State(),			State(kD2ALUTempSTToDB));
-		AddState(State(),			State(kD2ALUTempSTToDB),	State(kD3ALUOp_Sec | kD3ALUIn1Load | kD3ALUIn2Load));
-		AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Sec | kD3ALUResLoad)	,	State(kD4DBToR5));
-		// Get the real status and AND out the bits we want into temp r6
 		AddState(State(),			State(kD2STToDB));
-		AddState(State(),			State(kD2STToDB),	State(kD3ALUOp_Clc | kD3ALUIn1Load | kD3ALUIn2Load));
-		AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Clc | kD3ALUResLoad)	,	State(kD4DBToR6));
-		// Now extract the NV flags from the memory
-		LoadRegisterFromMemory(0,kD1AddrToAddress,true);
-		AddState(State(),			State(),	State(kD3ALUOp_Clv));
-		AddState(State(),			State(),	State(kD3ALUOp_Clv | kD3ALUResLoad));
-		// Or both results together and then or into the ANDed ST in temp r6
-		AddState(State(),			State(kD2ALUResToDB));
-		AddState(State(),			State(kD2ALUResToDB),	State(kD3ALUIn1Load));
-		AddState(State(),			State(kD2R5ToDB));
-		AddState(State(),			State(kD2R5ToDB),		State(kD3ALUIn2Load));
-		AddState(State(),			State(kD2ZeroToDB));
-		AddState(State(),			State(kD2ZeroToDB),		State(kD3ALUOp_Or | kD3ALUIn3Load));
-		AddState(State(),			State(),		State(kD3ALUOp_Or | kD3ALUResLoad));
-		AddState(State(),			State(kD2ALUResToDB));
-		AddState(State(),			State(kD2ALUResToDB),	State(kD3ALUIn1Load));
-		AddState(State(),			State(kD2R6ToDB));
-		AddState(State(),			State(kD2R6ToDB),		State(kD3ALUOp_Or | kD3ALUIn2Load));
-		AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Or | kD3ALUResLoad)	,	State(kD4DBToST));
-		FetchExecPreInc();
+		LoadRegisterFromMemory(0,kD1AddrToAddress,false,kD5ALUBank,true,kD3ALUOpX_BIT);
+		AddState(State(kD1PCInc),	State(kD2ALUTempSTToDB),	State(),	State(kD4DBToST));
+		FetchExec();
 	}
+
+protected:
+	int mContinuation;
 };
 
+// The undocumented NMOS 6502 opcodes, with the documented instruction pair each one replaces for the tick comparison or -1 when there is none.
+// $ff (ISC abs,X) is not here since it is used by opBoot.
+struct UndocumentedOpcode
+{
+	int mOpcode;
+	const char *mName;
+	UndocumentedOperation mOperation;
+	UndocumentedMode mMode;
+	int mPair[2];
+};
+static const UndocumentedOpcode kUndocumentedOpcodes[] =
+{
+	{ 0x03 , "SLO (zp,X)" , kUndocumentedSLO , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0x07 , "SLO zp" , kUndocumentedSLO , kUndocumentedZPAddr , 0x06 , 0x05 },
+	{ 0x0f , "SLO abs" , kUndocumentedSLO , kUndocumentedAddr , 0x0e , 0x0d },
+	{ 0x13 , "SLO (zp),Y" , kUndocumentedSLO , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0x17 , "SLO zp,X" , kUndocumentedSLO , kUndocumentedZPAddr_X , 0x16 , 0x15 },
+	{ 0x1b , "SLO abs,Y" , kUndocumentedSLO , kUndocumentedAddr_Y , -1 , -1 },
+	{ 0x1f , "SLO abs,X" , kUndocumentedSLO , kUndocumentedAddr_X , 0x1e , 0x1d },
+	{ 0x23 , "RLA (zp,X)" , kUndocumentedRLA , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0x27 , "RLA zp" , kUndocumentedRLA , kUndocumentedZPAddr , 0x26 , 0x25 },
+	{ 0x2f , "RLA abs" , kUndocumentedRLA , kUndocumentedAddr , 0x2e , 0x2d },
+	{ 0x33 , "RLA (zp),Y" , kUndocumentedRLA , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0x37 , "RLA zp,X" , kUndocumentedRLA , kUndocumentedZPAddr_X , 0x36 , 0x35 },
+	{ 0x3b , "RLA abs,Y" , kUndocumentedRLA , kUndocumentedAddr_Y , -1 , -1 },
+	{ 0x3f , "RLA abs,X" , kUndocumentedRLA , kUndocumentedAddr_X , 0x3e , 0x3d },
+	{ 0x43 , "SRE (zp,X)" , kUndocumentedSRE , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0x47 , "SRE zp" , kUndocumentedSRE , kUndocumentedZPAddr , 0x46 , 0x45 },
+	{ 0x4f , "SRE abs" , kUndocumentedSRE , kUndocumentedAddr , 0x4e , 0x4d },
+	{ 0x53 , "SRE (zp),Y" , kUndocumentedSRE , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0x57 , "SRE zp,X" , kUndocumentedSRE , kUndocumentedZPAddr_X , 0x56 , 0x55 },
+	{ 0x5b , "SRE abs,Y" , kUndocumentedSRE , kUndocumentedAddr_Y , -1 , -1 },
+	{ 0x5f , "SRE abs,X" , kUndocumentedSRE , kUndocumentedAddr_X , 0x5e , 0x5d },
+	{ 0x63 , "RRA (zp,X)" , kUndocumentedRRA , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0x67 , "RRA zp" , kUndocumentedRRA , kUndocumentedZPAddr , 0x66 , 0x65 },
+	{ 0x6f , "RRA abs" , kUndocumentedRRA , kUndocumentedAddr , 0x6e , 0x6d },
+	{ 0x73 , "RRA (zp),Y" , kUndocumentedRRA , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0x77 , "RRA zp,X" , kUndocumentedRRA , kUndocumentedZPAddr_X , 0x76 , 0x75 },
+	{ 0x7b , "RRA abs,Y" , kUndocumentedRRA , kUndocumentedAddr_Y , -1 , -1 },
+	{ 0x7f , "RRA abs,X" , kUndocumentedRRA , kUndocumentedAddr_X , 0x7e , 0x7d },
+	{ 0x83 , "SAX (zp,X)" , kUndocumentedSAX , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0x87 , "SAX zp" , kUndocumentedSAX , kUndocumentedZPAddr , -1 , -1 },
+	{ 0x8f , "SAX abs" , kUndocumentedSAX , kUndocumentedAddr , -1 , -1 },
+	{ 0x97 , "SAX zp,Y" , kUndocumentedSAX , kUndocumentedZPAddr_Y , -1 , -1 },
+	{ 0xa3 , "LAX (zp,X)" , kUndocumentedLAX , kUndocumentedIndZPAddr_X , 0xa1 , 0xaa },
+	{ 0xa7 , "LAX zp" , kUndocumentedLAX , kUndocumentedZPAddr , 0xa6 , 0x8a },
+	{ 0xaf , "LAX abs" , kUndocumentedLAX , kUndocumentedAddr , 0xae , 0x8a },
+	{ 0xb3 , "LAX (zp),Y" , kUndocumentedLAX , kUndocumentedIndZPAddr_Y , 0xb1 , 0xaa },
+	{ 0xb7 , "LAX zp,Y" , kUndocumentedLAX , kUndocumentedZPAddr_Y , 0xb6 , 0x8a },
+	{ 0xbf , "LAX abs,Y" , kUndocumentedLAX , kUndocumentedAddr_Y , 0xbe , 0x8a },
+	{ 0xc3 , "DCP (zp,X)" , kUndocumentedDCP , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0xc7 , "DCP zp" , kUndocumentedDCP , kUndocumentedZPAddr , 0xc6 , 0xc5 },
+	{ 0xcf , "DCP abs" , kUndocumentedDCP , kUndocumentedAddr , 0xce , 0xcd },
+	{ 0xd3 , "DCP (zp),Y" , kUndocumentedDCP , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0xd7 , "DCP zp,X" , kUndocumentedDCP , kUndocumentedZPAddr_X , 0xd6 , 0xd5 },
+	{ 0xdb , "DCP abs,Y" , kUndocumentedDCP , kUndocumentedAddr_Y , -1 , -1 },
+	{ 0xdf , "DCP abs,X" , kUndocumentedDCP , kUndocumentedAddr_X , 0xde , 0xdd },
+	{ 0xe3 , "ISC (zp,X)" , kUndocumentedISC , kUndocumentedIndZPAddr_X , -1 , -1 },
+	{ 0xe7 , "ISC zp" , kUndocumentedISC , kUndocumentedZPAddr , 0xe6 , 0xe5 },
+	{ 0xef , "ISC abs" , kUndocumentedISC , kUndocumentedAddr , 0xee , 0xed },
+	{ 0xf3 , "ISC (zp),Y" , kUndocumentedISC , kUndocumentedIndZPAddr_Y , -1 , -1 },
+	{ 0xf7 , "ISC zp,X" , kUndocumentedISC , kUndocumentedZPAddr_X , 0xf6 , 0xf5 },
+	{ 0xfb , "ISC abs,Y" , kUndocumentedISC , kUndocumentedAddr_Y , -1 , -1 },
+};
+const int kNumUndocumentedOpcodes = sizeof(kUndocumentedOpcodes) / sizeof(kUndocumentedOpcodes[0]);
 
 
-int main(int argc,char **argv)
+
+// The first free slot in the continuation banks, the opcode being split is only used for the error when there are no free slots left
+static int FindUnusedOpcode(Extensions **continuations,Extensions **continuationsDoBranch,const int continuationBank,const int splitOp)
+{
+	int op;
+	for (op=0;op<256;op++)
+	{
+		if ( !continuations[op] && !continuationsDoBranch[op] )
+		{
+			return op;
+		}
+	}
+	printf("Error: Cannot split opcode %s%02x, there are no unused opcodes left in the continuation banks\n",continuationBank ? "continuation " : "",splitOp);
+	exit(-1);
+	return 0;
+}
+
+// Splits the opcode, and any continuation that is still too long, into continuation opcodes in the continuation banks.
+// The opcode is in the normal banks, or in the continuation banks when continuationBank is set.
+static void SplitContinuations(Extensions **opcodes,Extensions **opcodesDoBranch,Extensions **continuations,Extensions **continuationsDoBranch,unsigned char constantROM[2][256][16],const int continuationBank,const int op,Extensions &opIllegal)
+{
+	Extensions *opcode = opcodes[op];
+	Extensions *opcodeDoBranch = opcodesDoBranch[op];
+
+	// An opcode can be in more than one slot, for example opStartIRQ, so it is only split once and each slot loads the same continuation
+	int continuation = -1;
+	if (opcode && (opcode->GetContinuation() >= 0))
+	{
+		continuation = opcode->GetContinuation();
+	}
+	if (opcodeDoBranch && (opcodeDoBranch->GetContinuation() >= 0))
+	{
+		assert( ((continuation < 0) || (continuation == opcodeDoBranch->GetContinuation())) && "The banks of the opcode continue with different opcodes");
+		continuation = opcodeDoBranch->GetContinuation();
+	}
+
+	const bool split = opcode && (opcode->GetContinuation() < 0) && (opcode->GetInterruptBankLength() > kMaxStates);
+	const bool splitDoBranch = opcodeDoBranch && (opcodeDoBranch->GetContinuation() < 0) && (opcodeDoBranch->GetInterruptBankLength() > kMaxStates);
+	if (split || splitDoBranch)
+	{
+		assert((continuation < 0) && "The opcode is already split in the other bank");
+
+		// Both banks of the opcode use the same continuation opcode since the constant generator does not know the bank
+		continuation = FindUnusedOpcode(continuations,continuationsDoBranch,continuationBank,op);
+		if (split)
+		{
+			continuations[continuation] = new Extensions;
+			opcode->SplitContinuation(*continuations[continuation],continuation);
+		}
+		if (splitDoBranch)
+		{
+			continuationsDoBranch[continuation] = new Extensions;
+			opcodeDoBranch->SplitContinuation(*continuationsDoBranch[continuation],continuation);
+		}
+		// When the opcode has a do branch version only one of them may be split, the other bank cannot reach the continuation so it halts.
+		// Without a do branch version the opcode is in both banks and so is the continuation.
+		if (opcode && opcodeDoBranch)
+		{
+			if (!split)
+			{
+				continuations[continuation] = &opIllegal;
+			}
+			if (!splitDoBranch)
+			{
+				continuationsDoBranch[continuation] = &opIllegal;
+			}
+		}
+		printf("Opcode %s%2x continues with opcode %2x\n",continuationBank ? "continuation " : "",op,continuation);
+
+		SplitContinuations(continuations,continuationsDoBranch,continuations,continuationsDoBranch,constantROM,1,continuation,opIllegal);
+	}
+
+	if (continuation >= 0)
+	{
+		constantROM[continuationBank][op][kD2ConstContinuationToDB] = (unsigned char) continuation;
+	}
+}
+
+// Enough to split every opcode apart from the block loops into at least one continuation without running out of continuation slots
+static const int kContinuationTestPadTicks = 56;
+
+// Pads each opcode in the table, that is not already padded, with ticks that do nothing before it starts. Used by the continuation test.
+// The block loops load kD2DoBranchLoad at the end so they cannot be split once they are padded, those are left as they are.
+static void PadOpcodes(Extensions **opcodes,const int ticks,Extensions &opIllegal,std::vector<Extensions *> &padded)
+{
+	int op;
+	for (op=0;op<256;op++)
+	{
+		Extensions *opcode = opcodes[op];
+		if (!opcode || (opcode == &opIllegal) || (std::find(padded.begin(),padded.end(),opcode) != padded.end()))
+		{
+			continue;
+		}
+		Extensions padding;
+		int i;
+		for (i=0;i<ticks;i++)
+		{
+			padding.AddState();
+		}
+		padding.Append(*opcode);
+		if ((padding.GetLength() > kMaxStates) && !padding.FindSplitPosition())
+		{
+			continue;
+		}
+		*opcode = padding;
+		padded.push_back(opcode);
+	}
+}
+
+// Checks the one pass kD3ALUOpX_BIT against the original BIT sequence, which built the ST from And, Sec, Clc, Clv and two Or passes,
+// for every accumulator, memory and ST value using the ALU ROMs that were just written to the path.
+static bool VerifyBIT(const char *path)
 {
+	std::vector<unsigned char> alu1ROM(1<<17),alu2ROM(1<<17);
+	char buffer[256];
+	sprintf(buffer,"%sALU1.bin",path);
+	FILE *fp = fopen(buffer,"rb");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",buffer);
+		return false;
+	}
+	fread(&alu1ROM[0],1,alu1ROM.size(),fp);
+	fclose(fp);
+	sprintf(buffer,"%sALU2.bin",path);
+	fp = fopen(buffer,"rb");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",buffer);
+		return false;
+	}
+	fread(&alu2ROM[0],1,alu2ROM.size(),fp);
+	fclose(fp);
+
+	int a,m,st;
+	int failures = 0;
+	for (a=0;a<256;a++)
+	{
+		for (m=0;m<256;m++)
+		{
+			unsigned char andRes,andST,zFlag,unused,oldFlags,nvFlags,orRes,oldST;
+			CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_And,0,(unsigned char) a,(unsigned char) m,0,andRes,andST);
+			CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_Sec,0,andST,andST,0xff,zFlag,unused);
+			CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_Clv,0,(unsigned char) m,(unsigned char) m,0xff,nvFlags,unused);
+			CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_Or,0,nvFlags,zFlag,0,orRes,unused);
+			for (st=0;st<256;st++)
+			{
+				CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_Clc,0,(unsigned char) st,(unsigned char) st,0xff,oldFlags,unused);
+				CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOp_Or,0,orRes,oldFlags,0,oldST,unused);
+
+				unsigned char newST;
+				CalculateALU(&alu1ROM[0],&alu2ROM[0],kD3ALUOpX_BIT,kD5ALUBank,(unsigned char) a,(unsigned char) m,(unsigned char) st,unused,newST);
+				if (newST != oldST)
+				{
+					if (failures < 8)
+					{
+						printf("BIT mismatch A=$%02x M=$%02x ST=$%02x : $%02x should be $%02x\n",a,m,st,newST,oldST);
+					}
+					failures++;
+				}
+			}
+		}
+	}
+	if (failures)
+	{
+		printf("BIT verification failed for %d of 16777216 inputs\n",failures);
+		return false;
+	}
+	return true;
+}
+
+// The ticks of the opcode including the continuation opcodes it loads, which run with the same branch and interrupt state
+static size_t GetChainLength(Extensions *opcode,Extensions **continuations,Extensions **continuationsDoBranch,const bool doBranch,const bool interruptBank)
+{
+	size_t length = 0;
+	int chain = 0;
+	while (opcode)
+	{
+		length += interruptBank ? opcode->GetInterruptBankLength() : opcode->GetLength();
+		const int continuation = opcode->GetContinuation();
+		if (continuation < 0)
+		{
+			break;
+		}
+		opcode = (doBranch && continuationsDoBranch[continuation]) ? continuationsDoBranch[continuation] : continuations[continuation];
+		chain++;
+		assert(chain < 256 && "The continuation opcodes loop");
+	}
+	return length;
+}
+
+// The decoder banks in the tick report, the NMI banks are the same for both IRQ states
+enum ReportBank
+{
+	kReportBankNormal = 0,
+	kReportBankDoBranch,
+	kReportBankIRQ,
+	kReportBankIRQDoBranch,
+	kReportBankNMI,
+	kReportBankNMIDoBranch,
+	kNumReportBanks
+};
+static const char *kReportBankNames[kNumReportBanks] = { "normal" , "doBranch" , "irq" , "irqDoBranch" , "nmi" , "nmiDoBranch" };
+
+// The design aims for roughly four ticks per NMOS 6502 cycle
+const int kTicksPer6502Cycle = 4;
+
+// The number of opcode banks that got longer than the committed tick report when -compare is used
+static int sTickRegressions = 0;
+
+// Writes OpCodeReport.json and OpCodeReport.csv with the per bank opcode lengths, zero for opcodes that are not implemented
+static void WriteTickReport(const TimingProfile &profile,const char *path,size_t bankLengths[kNumReportBanks][256],const bool *irqCheck)
+{
+	char buffer[256];
+	sprintf(buffer,"%sOpCodeReport.csv",path);
+	FILE *fp = fopen(buffer,"w");
+	sprintf(buffer,"%sOpCodeReport.json",path);
+	FILE *fp2 = fopen(buffer,"w");
+	assert(fp && fp2);
+
+	fprintf(fp,"opcode");
+	int bank;
+	for (bank=0;bank<kNumReportBanks;bank++)
+	{
+		fprintf(fp,",%s",kReportBankNames[bank]);
+	}
+	fprintf(fp,",irqCheck,cycles,cyclesDoBranch\n");
+
+	fprintf(fp2,"{\n\t\"profile\" : \"%s\",\n\t\"clockMHz\" : %.1f,\n\t\"stableTicks\" : %d,\n\t\"ticksPerCycle\" : %d,\n\t\"opcodes\" :\n\t[\n",profile.mName,profile.mClockMHz,profile.mStableTicks,kTicksPer6502Cycle);
+	bool first = true;
+	int op;
+	for (op=0;op<256;op++)
+	{
+		if (!bankLengths[kReportBankNormal][op] && !bankLengths[kReportBankDoBranch][op])
+		{
+			continue;
+		}
+		const double cycles = (double) bankLengths[kReportBankNormal][op] / (double) kTicksPer6502Cycle;
+		const double cyclesDoBranch = (double) bankLengths[kReportBankDoBranch][op] / (double) kTicksPer6502Cycle;
+
+		fprintf(fp,"$%02x",op);
+		fprintf(fp2,"%s\t\t{ \"opcode\" : %d",first ? "" : ",\n",op);
+		first = false;
+		for (bank=0;bank<kNumReportBanks;bank++)
+		{
+			fprintf(fp,",%d",(int) bankLengths[bank][op]);
+			fprintf(fp2,", \"%s\" : %d",kReportBankNames[bank],(int) bankLengths[bank][op]);
+		}
+		fprintf(fp,",%d,%.2f,%.2f\n",irqCheck[op] ? 1 : 0,cycles,cyclesDoBranch);
+		fprintf(fp2,", \"irqCheck\" : %s, \"cycles\" : %.2f, \"cyclesDoBranch\" : %.2f }",irqCheck[op] ? "true" : "false",cycles,cyclesDoBranch);
+	}
+	fprintf(fp2,"\n\t]\n}\n");
+	fclose(fp);
+	fclose(fp2);
+}
+
+// Compares the lengths with the OpCodeReport.csv already in the path and returns the number of opcode banks that got longer
+static int CompareTickReport(const char *path,size_t bankLengths[kNumReportBanks][256])
+{
+	char buffer[256];
+	sprintf(buffer,"%sOpCodeReport.csv",path);
+	FILE *fp = fopen(buffer,"r");
+	if (!fp)
+	{
+		printf("No baseline '%s' to compare with\n",buffer);
+		return 0;
+	}
+	int regressions = 0,improvements = 0;
+	char line[1024];
+	// Skip the header
+	fgets(line,sizeof(line),fp);
+	while (fgets(line,sizeof(line),fp))
+	{
+		int op;
+		int baseline[kNumReportBanks];
+		if (sscanf(line,"$%x,%d,%d,%d,%d,%d,%d",&op,&baseline[0],&baseline[1],&baseline[2],&baseline[3],&baseline[4],&baseline[5]) != 1 + kNumReportBanks)
+		{
+			continue;
+		}
+		int bank;
+		for (bank=0;bank<kNumReportBanks;bank++)
+		{
+			// Zero in the baseline is not implemented so a new opcode is not a regression
+			const int length = (int) bankLengths[bank][op & 255];
+			if (baseline[bank] && (length > baseline[bank]))
+			{
+				printf("%sOpCodeReport.csv opcode $%02x %s bank got longer, %d ticks to %d ticks\n",path,op,kReportBankNames[bank],baseline[bank],length);
+				regressions++;
+			}
+			else if (length < baseline[bank])
+			{
+				improvements++;
+			}
+		}
+	}
+	fclose(fp);
+	printf("%sOpCodeReport.csv compared with the baseline: %d opcode banks longer, %d shorter\n",path,regressions,improvements);
+	return regressions;
+}
+
+// Generates the complete ROM set for the timing profile into the path and returns the average opcode length
+// When is65C02 is set the 65C02 opcodes are used instead of the NMOS opcodes in the same slots
+// When compareOnly is set the opcode lengths are only compared with the tick report in the path, see CompareTickReport(), and nothing is written
+// When padTicks is set every opcode is padded with that many ticks that do nothing so they are split into continuation opcodes
+static double GenerateROMs(const TimingProfile &profile,const char *path,const bool is65C02 = false,const bool compareOnly = false,const int padTicks = 0)
+{
+	OpCode::SetTimingProfile(profile);
+
 	// Add an opcode that deliberately causes a hardware breakpoint to allow me to trap unimplemented opcodes.
 	Extensions opIllegal;
 	opIllegal.AddState(State(),State(),State(),State(),State(kD5IllegalOp));
@@ -678,23 +1483,18 @@ int main(int argc,char **argv)
 	// First SP hi
 	opJSR_Addr.AddState(State(),					State(kD2R4ToDB));
 	opJSR_Addr.AddState(State(kD1AddrHLoad),		State(kD2R4ToDB));
-	// Loading the SP lo also prepare the ALU to dec the lo SP value
 	opJSR_Addr.AddState(State(),					State(kD2R3ToDB));
-	opJSR_Addr.AddState(State(kD1AddrLLoad),		State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
+	opJSR_Addr.AddState(State(kD1AddrLLoad),		State(kD2R3ToDB));
 
-	// Get PC hi to temp R6 and push onto stack
-	opJSR_Addr.AddState(State(kD1PCToAddress),		State(kD2ADDRWHToDB),	State(),	State(kD4DBToR6));
+	// Get PC hi to temp R6 and push onto stack, the SP lo counts down while the addr lo holds the old value
+	opJSR_Addr.AddState(State(kD1PCToAddress),		State(kD2ADDRWHToDB),	State(),	State(kD4DBToR6),	State(kD5SPDec));
 	opJSR_Addr.WriteRegisterToMemory(kD2R6ToDB);
-	// Dec lo SP and load into addr lo
-	opJSR_Addr.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)		,	State(kD4DBToR3));
 
 	opJSR_Addr.AddState(State(),					State(kD2R3ToDB));
-	opJSR_Addr.AddState(State(kD1AddrLLoad),		State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
+	opJSR_Addr.AddState(State(kD1AddrLLoad),		State(kD2R3ToDB));
 	// Get PC lo to temp R6 and push onto stack
-	opJSR_Addr.AddState(State(kD1PCToAddress),		State(kD2ADDRWLToDB),	State(),	State(kD4DBToR6));
+	opJSR_Addr.AddState(State(kD1PCToAddress),		State(kD2ADDRWLToDB),	State(),	State(kD4DBToR6),	State(kD5SPDec));
 	opJSR_Addr.WriteRegisterToMemory(kD2R6ToDB);
-	// Dec lo SP
-	opJSR_Addr.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
 
 
 	// Load PC from address fetched from temp R5 and current memory
@@ -727,27 +1527,21 @@ int main(int argc,char **argv)
 
 
 	Extensions opPHA;
-	// Load SP into addr and also ALU
+	// Load SP into addr
 	opPHA.AddState(State(),				State(kD2R3ToDB));
-	opPHA.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
+	opPHA.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
 	opPHA.AddState(State(),				State(kD2R4ToDB));
 	opPHA.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
-	opPHA.WriteRegisterToMemory(kD2R0ToDB);
-	// Dec lo SP
-	opPHA.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
+	// Dec lo SP while writing
+	opPHA.WriteRegisterToMemory(kD2R0ToDB,0,kD1AddrToAddress,kD5SPDec);
 	opPHA.FetchExecPreInc();
 
 	Extensions opPLA;
-	// Load lo SP into ALU
-	opPLA.AddState(State(),		State(kD2R3ToDB));
-	opPLA.AddState(State(),		State(kD2R3ToDB),	State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load));
-	// Inc lo SP
-	opPLA.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Inc | kD3ALUResLoad),	State(kD4DBToR3));
-	// Load SP into addr and also ALU
+	// Inc lo SP while loading the SP hi into addr, then load the SP lo into addr
+	opPLA.AddState(State(),				State(kD2R4ToDB),	State(),	State(),	State(kD5SPInc));
+	opPLA.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
 	opPLA.AddState(State(),				State(kD2R3ToDB));
 	opPLA.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
-	opPLA.AddState(State(),				State(kD2R4ToDB));
-	opPLA.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
 	opPLA.LoadRegisterFromMemory(kD4DBToR0,kD1AddrToAddress,true);
 	opPLA.LoadFlagsDoFlags();
 	opPLA.FetchExecPreInc();
@@ -755,27 +1549,21 @@ int main(int argc,char **argv)
 
 
 	Extensions opPHP;
-	// Load SP into addr and also ALU
+	// Load SP into addr
 	opPHP.AddState(State(),				State(kD2R3ToDB));
-	opPHP.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
+	opPHP.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
 	opPHP.AddState(State(),				State(kD2R4ToDB));
 	opPHP.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
-	opPHP.WriteRegisterToMemory(kD2STToDB);
-	// Dec lo SP
-	opPHP.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
+	// Dec lo SP while writing
+	opPHP.WriteRegisterToMemory(kD2STToDB,0,kD1AddrToAddress,kD5SPDec);
 	opPHP.FetchExecPreInc();
 
 	Extensions opPLP;
-	// Load lo SP into ALU
-	opPLP.AddState(State(),		State(kD2R3ToDB));
-	opPLP.AddState(State(),		State(kD2R3ToDB),	State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load));
-	// Inc lo SP
-	opPLP.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Inc | kD3ALUResLoad)	,	State(kD4DBToR3));
-	// Load SP into addr and also ALU
+	// Inc lo SP while loading the SP hi into addr, then load the SP lo into addr
+	opPLP.AddState(State(),				State(kD2R4ToDB),	State(),	State(),	State(kD5SPInc));
+	opPLP.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
 	opPLP.AddState(State(),				State(kD2R3ToDB));
 	opPLP.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
-	opPLP.AddState(State(),				State(kD2R4ToDB));
-	opPLP.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
 	opPLP.LoadRegisterFromMemory(kD4DBToST,kD1AddrToAddress);
 	opPLP.FetchExecPreInc();
 
@@ -1305,14 +2093,10 @@ int main(int argc,char **argv)
 	Extensions opExtractZFlag;
 	// Read ST into ALU
 	opExtractZFlag.AddState(State(),			State(kD2STToDB));
-	opExtractZFlag.AddState(State(),			State(kD2STToDB),		State(kD3ALUOp_Lsr | kD3ALUIn1Load | kD3ALUIn2Load));
-	// Shift Z flag into carry by doing two LSR
-	// First LSR
-	opExtractZFlag.AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Lsr | kD3ALUResLoad));
-	opExtractZFlag.AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Lsr | kD3ALUIn1Load | kD3ALUIn2Load));
-	// Second LSR copy ALU carry to kD2DoBranchLoad
-	opExtractZFlag.AddState(State(),			State(),					State(kD3ALUOp_Lsr));
-	opExtractZFlag.AddState(State(),			State(kD2DoBranchLoad),		State(kD3ALUOp_Lsr));
+	opExtractZFlag.AddState(State(),			State(kD2STToDB),		State(kD3ALUOpX_ZToCarry | kD3ALUIn1Load | kD3ALUIn2Load),	State(),	State(kD5ALUBank));
+	// The extended ALU function outputs the Z flag as the carry, copy ALU carry to kD2DoBranchLoad
+	opExtractZFlag.AddState(State(),			State(),					State(kD3ALUOpX_ZToCarry),	State(),	State(kD5ALUBank));
+	opExtractZFlag.AddState(State(),			State(kD2DoBranchLoad),		State(kD3ALUOpX_ZToCarry),	State(),	State(kD5ALUBank));
 	opExtractZFlag.AddState();	// Blank state to allow sync
 	// At this point the instruction will split due to the kD2DoBranchLoad flag being set or clear
 
@@ -1341,15 +2125,10 @@ int main(int argc,char **argv)
 	Extensions opExtractVFlag;
 	// Read ST into ALU
 	opExtractVFlag.AddState(State(),			State(kD2STToDB));
-	opExtractVFlag.AddState(State(),			State(kD2STToDB),		State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	// Shift Z flag into carry by doing two LSL
-	// First LSR
-	opExtractVFlag.AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUOp_Lsl | kD3ALUResLoad));
-	opExtractVFlag.AddState(State(),			State(kD2ALUResToDB));
-	opExtractVFlag.AddState(State(),			State(kD2ALUResToDB),		State(kD3ALUIn1Load | kD3ALUIn2Load));
-	// Second LSR copy ALU carry to kD2DoBranchLoad
-	opExtractVFlag.AddState(State(),			State(),					State(kD3ALUOp_Lsl));
-	opExtractVFlag.AddState(State(),			State(kD2DoBranchLoad),		State(kD3ALUOp_Lsl));
+	opExtractVFlag.AddState(State(),			State(kD2STToDB),		State(kD3ALUOpX_VToCarry | kD3ALUIn1Load | kD3ALUIn2Load),	State(),	State(kD5ALUBank));
+	// The extended ALU function outputs the V flag as the carry, copy ALU carry to kD2DoBranchLoad
+	opExtractVFlag.AddState(State(),			State(),					State(kD3ALUOpX_VToCarry),	State(),	State(kD5ALUBank));
+	opExtractVFlag.AddState(State(),			State(kD2DoBranchLoad),		State(kD3ALUOpX_VToCarry),	State(),	State(kD5ALUBank));
 	opExtractVFlag.AddState();	// Blank state to allow sync
 	// At this point the instruction will split due to the kD2DoBranchLoad flag being set or clear
 
@@ -1714,19 +2493,11 @@ int main(int argc,char **argv)
 
 
 	Extensions opSec;
-	opSec.AddState(State(),		State(kD2STToDB));
-	opSec.AddState(State(),		State(kD2STToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
-	opSec.AddState(State(),		State(kD2ZeroToDB));
-	opSec.AddState(State(),		State(kD2ZeroToDB),	State(kD3ALUOp_Sec | kD3ALUIn3Load));
-	opSec.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Sec | kD3ALUResLoad)	,	State(kD4DBToST));
+	opSec.STALUOpWithConstant(kD2Const01ToDB,kD3ALUOp_Or);
 	opSec.FetchExecPreInc();
 
 	Extensions opClc;
-	opClc.AddState(State(),		State(kD2STToDB));
-	opClc.AddState(State(),		State(kD2STToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
-	opClc.AddState(State(),		State(kD2ZeroToDB));
-	opClc.AddState(State(),		State(kD2ZeroToDB),	State(kD3ALUOp_Clc | kD3ALUIn3Load));
-	opClc.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Clc | kD3ALUResLoad)	,	State(kD4DBToST));
+	opClc.STALUOpWithConstant(kD2ConstFEToDB,kD3ALUOp_And);
 	opClc.FetchExecPreInc();
 
 
@@ -1739,59 +2510,26 @@ int main(int argc,char **argv)
 	opClv.FetchExecPreInc();
 
 
+	Extensions opSed;
+	// ST OR 8 back into ST
+	opSed.STALUOpWithConstant(kD2Const08ToDB,kD3ALUOp_Or);
+	opSed.FetchExecPreInc();
+
+	Extensions opCld;
+	// ST AND $f7 back into ST
+	opCld.STALUOpWithConstant(kD2ConstF7ToDB,kD3ALUOp_And);
+	opCld.FetchExecPreInc();
+
 	Extensions opCli;
-	// Get 1 (ALU inc #0) to temp R5
-	opCli.AddState(State(),				State(kD2ZeroToDB),					State());
-	opCli.AddState(State(),				State(kD2ZeroToDB),					State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load));
-	opCli.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Inc | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Calculate 1 << 2 using the ALU into temp R5
-	opCli.AddState(State(),				State(kD2R5ToDB),					State());
-	opCli.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opCli.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	opCli.AddState(State(),				State(kD2R5ToDB),					State());
-	opCli.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opCli.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Now 4 XOR with 0xff
-	opCli.AddState(State(),				State(kD2R5ToDB),					State());
-	opCli.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUIn1Load));
-	opCli.AddState(State(),				State(kD2FFToDB),					State());
-	opCli.AddState(State(),				State(kD2FFToDB),					State(kD3ALUOp_Xor | kD3ALUIn2Load));
-	opCli.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Xor | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Now ST AND 0xfb back into ST
-	opCli.AddState(State(),				State(kD2STToDB),					State());
-	opCli.AddState(State(),				State(kD2STToDB),					State(kD3ALUIn1Load));
-	opCli.AddState(State(),				State(kD2R5ToDB),					State());
-	opCli.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_And | kD3ALUIn2Load));
-	opCli.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_And | kD3ALUResLoad)	,	State(kD4DBToST));
+	// ST AND $fb back into ST
+	opCli.STALUOpWithConstant(kD2ConstFBToDB,kD3ALUOp_And);
 	opCli.FetchExecPreInc();
 
 
 
 	Extensions opSei;
-	// Get 1 (ALU inc #0) to temp R5
-	opSei.AddState(State(),				State(kD2ZeroToDB),					State());
-	opSei.AddState(State(),				State(kD2ZeroToDB),					State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load));
-	opSei.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Inc | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Calculate 1 << 2 using the ALU into temp R5
-	opSei.AddState(State(),				State(kD2R5ToDB),					State());
-	opSei.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opSei.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	opSei.AddState(State(),				State(kD2R5ToDB),					State());
-	opSei.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opSei.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Now ST OR 4 back into ST
-	opSei.AddState(State(),				State(kD2STToDB),					State());
-	opSei.AddState(State(),				State(kD2STToDB),					State(kD3ALUIn1Load));
-	opSei.AddState(State(),				State(kD2R5ToDB),					State());
-	opSei.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Or | kD3ALUIn2Load));
-	opSei.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Or | kD3ALUResLoad)	,	State(kD4DBToST));
+	// ST OR 4 back into ST
+	opSei.STALUOpWithConstant(kD2Const04ToDB,kD3ALUOp_Or);
 	opSei.FetchExecPreInc(false);	// No need for the IRQ check
 
 
@@ -1824,98 +2562,268 @@ int main(int argc,char **argv)
 	// A special case instruction that enters the IRQ operating level of the processor
 	// Then set the ID flag in ST
 	Extensions opStartIRQ;
-	// Stack PC (actual address, so that RTI does a FetchExec without pre-inc) then ST
-	// Prepare the address bus with the stack pointer
-	// First SP hi
-	opStartIRQ.AddState(State(),					State(kD2R4ToDB));
-	opStartIRQ.AddState(State(kD1AddrHLoad),		State(kD2R4ToDB));
-	// Loading the SP lo also prepare the ALU to dec the lo SP value
-	opStartIRQ.AddState(State(),					State(kD2R3ToDB));
-	opStartIRQ.AddState(State(kD1AddrLLoad),		State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
-
-	// Get PC hi to temp R6 and push onto stack
-	opStartIRQ.AddState(State(kD1PCToAddress),		State(kD2ADDRWHToDB),	State(),	State(kD4DBToR6));
-	opStartIRQ.WriteRegisterToMemory(kD2R6ToDB);
-	// Dec lo SP and load into addr lo
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec));
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
-	opStartIRQ.AddState(State(),				State(kD2R3ToDB));
-	opStartIRQ.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB),	State(kD3ALUIn1Load | kD3ALUIn2Load));
-	// Get PC lo to temp R6 and push onto stack
-	opStartIRQ.AddState(State(kD1PCToAddress),		State(kD2ADDRWLToDB),	State(),	State(kD4DBToR6));
-	opStartIRQ.WriteRegisterToMemory(kD2R6ToDB);
-	// Dec lo SP
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec));
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
-
-	// Now push the ST
-	opStartIRQ.AddState(State(),				State(kD2R3ToDB));
-	opStartIRQ.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB),	State(kD3ALUOp_Dec | kD3ALUIn1Load | kD3ALUIn2Load));
-	opStartIRQ.WriteRegisterToMemory(kD2STToDB);
-	// Dec lo SP
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec));
-	opStartIRQ.AddState(State(),		State(kD2ALUResToDB),		State(kD3ALUOp_Dec | kD3ALUResLoad)	,	State(kD4DBToR3));
-
-	// Now start updating ST
-	// Get 1 (ALU inc #0) to temp R5
-	opStartIRQ.AddState(State(),				State(kD2ZeroToDB));
-	opStartIRQ.AddState(State(),				State(kD2ZeroToDB),					State(kD3ALUOp_Inc | kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Inc | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Calculate 1 << 2 using the ALU into temp R5
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State());
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State());
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Lsl | kD3ALUIn1Load | kD3ALUIn2Load));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsl | kD3ALUResLoad)	,	State(kD4DBToR5));
-
-	// Now ST OR 4 back into ST
-	opStartIRQ.AddState(State(),				State(kD2STToDB),					State());
-	opStartIRQ.AddState(State(),				State(kD2STToDB),					State(kD3ALUIn1Load));
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State());
-	opStartIRQ.AddState(State(),				State(kD2R5ToDB),					State(kD3ALUOp_Or | kD3ALUIn2Load));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Or | kD3ALUResLoad)	,	State(kD4DBToST));
-	// ST Now has I bit set, interrupts disabled.
-
-	// Get the state code for opcode $7f to execute into opStartIRQ2.
-	opStartIRQ.AddState(State(),				State(kD2FFToDB));
-	opStartIRQ.AddState(State(),				State(kD2FFToDB),					State(kD3ALUIn1Load | kD3ALUIn2Load));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsr));
-	opStartIRQ.AddState(State(kD1OpCodeLoad),	State(kD2ALUResToDB),				State(kD3ALUOp_Lsr | kD3ALUResLoad));
-	opStartIRQ.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Lsr));
-	opStartIRQ.AddState(State(kD1CycleReset));
-
-	// Extension of the IRQ start code. Entering the IRQ operating level has a lot of states. :)
-	Extensions opStartIRQ2;
-	// Now load the IRQ vector and start executing from there
-	// 0xff to AddrH 
-	opStartIRQ2.AddState(State(),				State(kD2FFToDB),					State());
-	opStartIRQ2.AddState(State(kD1AddrHLoad),	State(kD2FFToDB),					State(kD3ALUOp_Dec | kD3ALUIn1Load | kD3ALUIn2Load));
-
-	// Calc 0xfe and put into AddrL
-	opStartIRQ2.AddState(State(),				State(kD2ALUResToDB),				State(kD3ALUOp_Dec | kD3ALUResLoad));
-	opStartIRQ2.AddState(State(kD1AddrLLoad),	State(kD2ALUResToDB),				State(kD3ALUOp_Dec));
+	opStartIRQ.StartInterrupt(kD2ConstFEToDB);
 
-	// Load into PC, remembering the load is actually done on the positive edge
-	opStartIRQ2.AddState(State(kD1PCLoad),				State(),				State());
-	opStartIRQ2.AddState(State(kD1PCLoad | kD1PCInc),	State(),				State());
+	// The NMI banks have this instead of opStartIRQ to use the NMI vector at $fffa
+	Extensions opStartNMI;
+	opStartNMI.StartInterrupt(kD2ConstFAToDB);
 
-	// $fffe is now in the PC
-	// Proceed to load the memory into the address lo and hi
-	opStartIRQ2.LoadRegisterFromMemory(0,kD1AddrLLoad | kD1PCToAddress);
-	opStartIRQ2.AddState(State(kD1PCInc));
-	opStartIRQ2.AddState();
-	opStartIRQ2.LoadRegisterFromMemory(0,kD1AddrHLoad | kD1PCToAddress);
 
-	// Load PC from address fetched from memory and held in the memory input latches
-	opStartIRQ2.AddState(State(kD1PCLoad));
-	opStartIRQ2.AddState(State(kD1PCLoad | kD1PCInc));
-	opStartIRQ2.AddState();
 
-	opStartIRQ2.FetchExec(false);	// No need for the IRQ check
+	// Undocumented NMOS 6502 opcodes, each is the addressing mode then the operation from kUndocumentedOpcodes
+	Extensions opUndocumented[kNumUndocumentedOpcodes];
+	int undocumentedIndex;
+	for (undocumentedIndex=0;undocumentedIndex<kNumUndocumentedOpcodes;undocumentedIndex++)
+	{
+		opUndocumented[undocumentedIndex].LoadUndocumentedAddress(kUndocumentedOpcodes[undocumentedIndex].mMode);
+		opUndocumented[undocumentedIndex].DoUndocumentedOperation(kUndocumentedOpcodes[undocumentedIndex].mOperation);
+		opUndocumented[undocumentedIndex].FetchExecPreInc();
+	}
+
 
+	// 65C02 opcodes, only used when generating the 65C02 variant. They replace NMOS halt and NOP slots.
+	Extensions opBRA;
+	opBRA.TakeBranch();
+
+	Extensions opPHX;
+	// Load SP into addr
+	opPHX.AddState(State(),				State(kD2R3ToDB));
+	opPHX.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
+	opPHX.AddState(State(),				State(kD2R4ToDB));
+	opPHX.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
+	// Dec lo SP while writing
+	opPHX.WriteRegisterToMemory(kD2R1ToDB,0,kD1AddrToAddress,kD5SPDec);
+	opPHX.FetchExecPreInc();
+
+	Extensions opPHY;
+	// Load SP into addr
+	opPHY.AddState(State(),				State(kD2R3ToDB));
+	opPHY.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
+	opPHY.AddState(State(),				State(kD2R4ToDB));
+	opPHY.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
+	// Dec lo SP while writing
+	opPHY.WriteRegisterToMemory(kD2R2ToDB,0,kD1AddrToAddress,kD5SPDec);
+	opPHY.FetchExecPreInc();
+
+	Extensions opPLX;
+	// Inc lo SP while loading the SP hi into addr, then load the SP lo into addr
+	opPLX.AddState(State(),				State(kD2R4ToDB),	State(),	State(),	State(kD5SPInc));
+	opPLX.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
+	opPLX.AddState(State(),				State(kD2R3ToDB));
+	opPLX.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
+	opPLX.LoadRegisterFromMemory(kD4DBToR1,kD1AddrToAddress,true);
+	opPLX.LoadFlagsDoFlags();
+	opPLX.FetchExecPreInc();
+
+	Extensions opPLY;
+	// Inc lo SP while loading the SP hi into addr, then load the SP lo into addr
+	opPLY.AddState(State(),				State(kD2R4ToDB),	State(),	State(),	State(kD5SPInc));
+	opPLY.AddState(State(kD1AddrHLoad),	State(kD2R4ToDB));
+	opPLY.AddState(State(),				State(kD2R3ToDB));
+	opPLY.AddState(State(kD1AddrLLoad),	State(kD2R3ToDB));
+	opPLY.LoadRegisterFromMemory(kD4DBToR2,kD1AddrToAddress,true);
+	opPLY.LoadFlagsDoFlags();
+	opPLY.FetchExecPreInc();
+
+	Extensions opSTZ_ZPAddr;
+	opSTZ_ZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opSTZ_ZPAddr.WriteRegisterToMemory(kD2ZeroToDB);
+	opSTZ_ZPAddr.FetchExecPreInc();
+
+	Extensions opSTZ_ZPAddr_X;
+	opSTZ_ZPAddr_X.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opSTZ_ZPAddr_X.AddRegisterToZeroPageAddress(kD2R1ToDB);
+	opSTZ_ZPAddr_X.WriteRegisterToMemory(kD2ZeroToDB);
+	opSTZ_ZPAddr_X.FetchExecPreInc();
+
+	Extensions opSTZ_Addr;
+	opSTZ_Addr.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opSTZ_Addr.WriteRegisterToMemory(kD2ZeroToDB);
+	opSTZ_Addr.FetchExecPreInc();
+
+	Extensions opSTZ_Addr_X;
+	opSTZ_Addr_X.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opSTZ_Addr_X.AddRegisterToAddress(kD2R1ToDB);
+	opSTZ_Addr_X.WriteRegisterToMemory(kD2ZeroToDB);
+	opSTZ_Addr_X.FetchExecPreInc();
+
+	Extensions opINA;
+	opINA.RegisterSimpleALUOp(kD2R0ToDB,kD3ALUOp_Inc,kD4DBToR0);
+	opINA.FetchExecPreInc();
+
+	Extensions opDEA;
+	opDEA.RegisterSimpleALUOp(kD2R0ToDB,kD3ALUOp_Dec,kD4DBToR0);
+	opDEA.FetchExecPreInc();
+
+	Extensions opOra_IndZPAddr;
+	opOra_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opOra_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opOra_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opOra_IndZPAddr.RegisterALUOp(kD2R0ToDB,kD3ALUOp_Or,kD4DBToR0);
+	opOra_IndZPAddr.FetchExecPreInc();
+
+	Extensions opAnd_IndZPAddr;
+	opAnd_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opAnd_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opAnd_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opAnd_IndZPAddr.RegisterALUOp(kD2R0ToDB,kD3ALUOp_And,kD4DBToR0);
+	opAnd_IndZPAddr.FetchExecPreInc();
+
+	Extensions opEor_IndZPAddr;
+	opEor_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opEor_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opEor_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opEor_IndZPAddr.RegisterALUOp(kD2R0ToDB,kD3ALUOp_Xor,kD4DBToR0);
+	opEor_IndZPAddr.FetchExecPreInc();
+
+	Extensions opAdc_IndZPAddr;
+	opAdc_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opAdc_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opAdc_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opAdc_IndZPAddr.RegisterALUOp(kD2R0ToDB,kD3ALUOp_Add,kD4DBToR0);
+	opAdc_IndZPAddr.FetchExecPreInc();
+
+	Extensions opSTA_IndZPAddr;
+	opSTA_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opSTA_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opSTA_IndZPAddr.WriteRegisterToMemory(kD2R0ToDB);
+	opSTA_IndZPAddr.FetchExecPreInc();
+
+	Extensions opLDA_IndZPAddr;
+	opLDA_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opLDA_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opLDA_IndZPAddr.LoadRegisterFromMemory(kD4DBToR0,kD1AddrToAddress,true);
+	opLDA_IndZPAddr.LoadFlagsDoFlags();
+	opLDA_IndZPAddr.FetchExecPreInc();
+
+	Extensions opCmp_IndZPAddr;
+	opCmp_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opCmp_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opCmp_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opCmp_IndZPAddr.CompareCommon(kD2R0ToDB);
+	opCmp_IndZPAddr.FetchExecPreInc();
+
+	Extensions opSbc_IndZPAddr;
+	opSbc_IndZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opSbc_IndZPAddr.LoadIndAddrWith6502WrapBug();
+	opSbc_IndZPAddr.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opSbc_IndZPAddr.RegisterALUOp(kD2R0ToDB,kD3ALUOp_Sub,kD4DBToR0);
+	opSbc_IndZPAddr.FetchExecPreInc();
+
+	Extensions opTSB_ZPAddr;
+	opTSB_ZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opTSB_ZPAddr.TestAndSetOrResetBits(true);
+	opTSB_ZPAddr.FetchExecPreInc();
+
+	Extensions opTSB_Addr;
+	opTSB_Addr.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opTSB_Addr.TestAndSetOrResetBits(true);
+	opTSB_Addr.FetchExecPreInc();
+
+	Extensions opTRB_ZPAddr;
+	opTRB_ZPAddr.LoadZeroPageAddressFromPCMemoryWithPreInc();
+	opTRB_ZPAddr.TestAndSetOrResetBits(false);
+	opTRB_ZPAddr.FetchExecPreInc();
+
+	Extensions opTRB_Addr;
+	opTRB_Addr.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opTRB_Addr.TestAndSetOrResetBits(false);
+	opTRB_Addr.FetchExecPreInc();
+
+	// Block move and fill. The setup opcode loads the pointers and then the loop opcode executes once per byte, loading itself
+	// from the constant generator until X wraps. The DoBranch bank has the version that continues the loop.
+	// The loop opcodes are only in the continuation banks, the same slots in the normal banks halt so a stray $9b or $bb cannot
+	// run the loop with the PC built from the block pointers.
+	// There is no IRQ check until the last byte is done, so the IRQ latency is up to 256 bytes.
+	// MVB zp : Moves X+1 bytes from the pointer at zp+2 to the pointer at zp, X = $ff afterwards
+	Extensions opMoveBlock_ZPAddr;
+	opMoveBlock_ZPAddr.LoadBlockPointers(true);
+	opMoveBlock_ZPAddr.LoadOpCodeFromConstant(kD2ConstMoveBlockLoopToDB);
+
+	Extensions opMoveBlockLoop;
+	// Read the byte into the ALU result and write it using the PC
+	opMoveBlockLoop.LoadRegisterFromMemory(0,kD1AddrToAddress,true);
+	opMoveBlockLoop.AddState(State(),	State(),	State(kD3ALUOp_Or));
+	opMoveBlockLoop.AddState(State(),	State(),	State(kD3ALUOp_Or | kD3ALUResLoad));
+	opMoveBlockLoop.WriteRegisterToMemory(kD2ALUResToDB,kD3ALUOp_Or,kD1PCToAddress);
+	opMoveBlockLoop.DecrementBlockCount();
+
+	Extensions opMoveBlockLoop0;
+	opMoveBlockLoop0.Append(opMoveBlockLoop);
+	opMoveBlockLoop0.EndBlock();
+
+	Extensions opMoveBlockLoop1;
+	opMoveBlockLoop1.Append(opMoveBlockLoop);
+	opMoveBlockLoop1.IncrementBlockPointers();
+	opMoveBlockLoop1.LoadOpCodeFromConstant(kD2ConstMoveBlockLoopToDB);
+
+	// FLB zp : Fills X+1 bytes at the pointer at zp with A, X = $ff afterwards
+	Extensions opFillBlock_ZPAddr;
+	opFillBlock_ZPAddr.LoadBlockPointers(false);
+	opFillBlock_ZPAddr.LoadOpCodeFromConstant(kD2ConstFillBlockLoopToDB);
+
+	Extensions opFillBlockLoop;
+	opFillBlockLoop.WriteRegisterToMemory(kD2R0ToDB,0,kD1PCToAddress);
+	opFillBlockLoop.DecrementBlockCount();
+
+	Extensions opFillBlockLoop0;
+	opFillBlockLoop0.Append(opFillBlockLoop);
+	opFillBlockLoop0.EndBlock();
+
+	Extensions opFillBlockLoop1;
+	opFillBlockLoop1.Append(opFillBlockLoop);
+	opFillBlockLoop1.AddState(State(kD1PCInc));
+	opFillBlockLoop1.LoadOpCodeFromConstant(kD2ConstFillBlockLoopToDB);
+
+	// MUL : A * X, the product lo is stored in A and the hi in X. The flags are not changed.
+	// With a = ah:al and x = xh:xl the product is al*xl + (al*xh + ah*xl) << 4 + ah*xh << 8. The nybble multiply ROM gives
+	// the nybble shifted products directly so only four adds are needed.
+	Extensions opMUL;
+	opMUL.AddState(State(),		State(kD2R0ToDB));
+	opMUL.AddState(State(),		State(kD2R0ToDB),		State(kD3ALUIn1Load));
+	opMUL.AddState(State(),		State(kD2R1ToDB));
+	opMUL.AddState(State(),		State(kD2R1ToDB),		State(kD3ALUIn2Load));
+	// A and X are free now, the address latches are also used as temporary storage
+	opMUL.NybbleProductToRegister(0,0,kD4DBToR5);
+	opMUL.NybbleProductToRegister(kD2MulIn1Hi | kD2MulIn2Hi,0,kD4DBToR6);
+	opMUL.NybbleProductToRegister(kD2MulIn2Hi | kD2MulShl4,kD1AddrLLoad,0);
+	opMUL.NybbleProductToRegister(kD2MulIn2Hi | kD2MulShr4,kD1AddrHLoad,0);
+	opMUL.NybbleProductToRegister(kD2MulIn1Hi | kD2MulShl4,0,kD4DBToR0);
+	opMUL.NybbleProductToRegister(kD2MulIn1Hi | kD2MulShr4,0,kD4DBToR1);
+	// In3 is zero so the adds are never BCD, the hi bytes use the carry from the lo bytes
+	opMUL.AddState(State(),		State(kD2ZeroToDB));
+	opMUL.AddState(State(),		State(kD2ZeroToDB),			State(kD3ALUIn3Load));
+	opMUL.AddRegistersToRegister(kD2R5ToDB,kD2ADDRWLToDB,kD4DBToR5);
+	opMUL.AddState(State(),		State(kD2ALUTempSTToDB));
+	opMUL.AddState(State(),		State(kD2ALUTempSTToDB),	State(kD3ALUIn3Load));
+	opMUL.AddRegistersToRegister(kD2R6ToDB,kD2ADDRWHToDB,kD4DBToR6);
+	opMUL.AddState(State(),		State(kD2ZeroToDB));
+	opMUL.AddState(State(),		State(kD2ZeroToDB),			State(kD3ALUIn3Load));
+	opMUL.AddRegistersToRegister(kD2R5ToDB,kD2R0ToDB,kD4DBToR0);
+	opMUL.AddState(State(),		State(kD2ALUTempSTToDB));
+	opMUL.AddState(State(),		State(kD2ALUTempSTToDB),	State(kD3ALUIn3Load));
+	opMUL.AddRegistersToRegister(kD2R6ToDB,kD2R1ToDB,kD4DBToR1);
+	opMUL.FetchExecPreInc();
+
+	// The 65C02 fixed the jmp (addr) bug
+	Extensions opJMP_IndAddr65C02;
+	opJMP_IndAddr65C02.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opJMP_IndAddr65C02.LoadIndAddrThroughPC();
+	// Load PC from address fetched from memory and held in the memory input latches
+	opJMP_IndAddr65C02.AddState(State(kD1PCLoad));
+	opJMP_IndAddr65C02.AddState(State(kD1PCLoad | kD1PCInc));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+	opJMP_IndAddr65C02.AddState();
+	opJMP_IndAddr65C02.FetchExec();
+
+	Extensions opJMP_IndAddr_X;
+	opJMP_IndAddr_X.LoadAbsoluteAddressFromPCMemoryWithPreInc();
+	opJMP_IndAddr_X.AddRegisterToAddress(kD2R1ToDB);
+	opJMP_IndAddr_X.LoadIndAddrThroughPC();
+	// Load PC from address fetched from memory and held in the memory input latches
+	opJMP_IndAddr_X.AddState(State(kD1PCLoad));
+	opJMP_IndAddr_X.AddState(State(kD1PCLoad | kD1PCInc));	// The kD1PCInc doesn't inc, it loads due to the kD1PCLoad
+	opJMP_IndAddr_X.AddState();
+	opJMP_IndAddr_X.FetchExec();
 
 
 	// A rather special case opcode that bootstraps the whole processor
@@ -1995,15 +2903,16 @@ int main(int argc,char **argv)
 
 
 
+	// The undocumented opcodes are filled in from opUndocumented after the table
 	Extensions *opcodes[256] = {
 		0,		// 00    BRK$
 		&opOra_IndZPAddr_X,		// 01    ORA (zp,X)$
 		&opIllegal,		// 02  * HALT$
-		0,		// 03  * ASL-ORA (zp,X)$
+		0,		// 03  * SLO (zp,X)$
 		0,		// 04  * NOP zp$
 		&opOra_ZPAddr,		// 05    ORA zp$
 		&opASL_ZPAddr,		// 06    ASL zp$
-		0,		// 07  * ASL-ORA zp$
+		0,		// 07  * SLO zp$
 		&opPHP,		// 08    PHP$
 		&opOra_Immediate,		// 09    ORA #n$
 		&opASL,		// 0A    ASL A$
@@ -2011,33 +2920,33 @@ int main(int argc,char **argv)
 		0,		// 0C  * NOP abs$
 		&opOra_Addr,		// 0D    ORA abs$
 		&opASL_Addr,		// 0E    ASL abs$
-		0,		// 0F  * ASL-ORA abs$
+		0,		// 0F  * SLO abs$
 
 		&opBPL0,		// 10    BPL rel$
 		&opOra_IndZPAddr_Y,		// 11    ORA (zp),Y$
 		0,		// 12  * HALT$
-		0,		// 13  * ASL-ORA (zp),Y$
+		0,		// 13  * SLO (zp),Y$
 		0,		// 14  * NOP zp$
 		&opOra_ZPAddr_X,		// 15    ORA zp,X$
 		&opASL_ZPAddr_X,		// 16    ASL zp,X$
-		0,		// 17  * ASL-ORA abs,X$
+		0,		// 17  * SLO zp,X$
 		&opClc,		// 18    CLC$
 		&opOra_Addr_Y,		// 19    ORA abs,Y$
 		0,		// 1A  * NOP$
-		0,		// 1B  * ASL-ORA abs,Y$
+		0,		// 1B  * SLO abs,Y$
 		0,		// 1C  * NOP abs$
 		&opOra_Addr_X,		// 1D    ORA abs,X$
 		&opASL_Addr_X,		// 1E    ASL abs,X$
-		0,		// 1F  * ASL-ORA abs,X$
+		0,		// 1F  * SLO abs,X$
 
 		&opJSR_Addr,		// 20    JSR abs$
 		&opAnd_IndZPAddr_X,		// 21    AND (zp,X)$
 		0,		// 22  * HALT$
-		0,		// 23  * ROL-AND (zp,X)$
+		0,		// 23  * RLA (zp,X)$
 		&opBIT_ZPAddr,		// 24    BIT zp$
 		&opAnd_ZPAddr,		// 25    AND zp$
 		&opROL_ZPAddr,		// 26    ROL zp$
-		0,		// 27  * ROL-AND zp$
+		0,		// 27  * RLA zp$
 		&opPLP,		// 28    PLP$
 		&opAnd_Immediate,		// 29    AND #n$
 		&opROL,		// 2A    ROL A$
@@ -2045,33 +2954,33 @@ int main(int argc,char **argv)
 		&opBIT_Addr,		// 2C    BIT abs$
 		&opAnd_Addr,		// 2D    AND abs$
 		&opROL_Addr,		// 2E    ROL abs$
-		0,		// 2F  * ROL-AND abs$
+		0,		// 2F  * RLA abs$
 
 		&opBMI0,		// 30    BMI rel$
 		&opAnd_IndZPAddr_Y,		// 31    AND (zp),Y$
 		0,		// 32  * HALT$
-		0,		// 33  * ROL-AND (zp),Y$
+		0,		// 33  * RLA (zp),Y$
 		0,		// 34  * NOP zp$
 		&opAnd_ZPAddr_X,		// 35    AND zp,X$
 		&opROL_ZPAddr_X,		// 36    ROL zp,X$
-		0,		// 37  * ROL-AND zp,X$
+		0,		// 37  * RLA zp,X$
 		&opSec,		// 38    SEC$
 		&opAnd_Addr_Y,		// 39    AND abs,Y$
 		0,		// 3A  * NOP$
-		0,		// 3B  * ROL-AND abs,Y$
+		0,		// 3B  * RLA abs,Y$
 		0,		// 3C  * NOP abs$
 		&opAnd_Addr_X,		// 3D    AND abs,X$
 		&opROL_Addr_X,		// 3E    ROL abs,X$
-		0,		// 3F  * ROL-AND abs,X$
+		0,		// 3F  * RLA abs,X$
 
 		&opRTI,		// 40    RTI$
 		&opEor_IndZPAddr_X,		// 41    EOR (zp,X)$
 		0,		// 42  * HALT$
-		0,		// 43  * LSR-EOR (zp,X)$
+		0,		// 43  * SRE (zp,X)$
 		0,		// 44  * NOP zp$
 		&opEor_ZPAddr,		// 45    EOR zp$
 		&opLSR_ZPAddr,		// 46    LSR zp$
-		0,		// 47  * LSR-EOR zp$
+		0,		// 47  * SRE zp$
 		&opPHA,		// 48    PHA$
 		&opEor_Immediate,		// 49    EOR #n$
 		&opLSR,		// 4A    LSR A$
@@ -2079,33 +2988,33 @@ int main(int argc,char **argv)
 		&opJMP_Addr,		// 4C    JMP abs$
 		&opEor_Addr,		// 4D    EOR abs$
 		&opLSR_Addr,		// 4E    LSR abs$
-		0,		// 4F  * LSR-EOR abs$
+		0,		// 4F  * SRE abs$
 
 		&opBVC0,		// 50    BVC rel$
 		&opEor_IndZPAddr_Y,		// 51    EOR (zp),Y$
 		0,		// 52  * HALT$
-		0,		// 53  * LSR-EOR (zp),Y$
+		0,		// 53  * SRE (zp),Y$
 		0,		// 54  * NOP zp$
 		&opEor_ZPAddr_X,		// 55    EOR zp,X$
 		&opLSR_ZPAddr_X,		// 56    LSR zp,X$
-		0,		// 57  * LSR-EOR abs,X$
+		0,		// 57  * SRE zp,X$
 		&opCli,		// 58    CLI$
 		&opEor_Addr_Y,		// 59    EOR abs,Y$
 		0,		// 5A  * NOP$
-		0,		// 5B  * LSR-EOR abs,Y$
+		0,		// 5B  * SRE abs,Y$
 		0,		// 5C  * NOP abs$
 		&opEor_Addr_X,		// 5D    EOR abs,X$
 		&opLSR_Addr_X,		// 5E    LSR abs,X$
-		0,		// 5F  * LSR-EOR abs,X$
+		0,		// 5F  * SRE abs,X$
 
 		&opRTS,		// 60    RTS$
 		&opAdc_IndZPAddr_X,		// 61    ADC (zp,X)$
 		0,		// 62  * HALT$
-		0,		// 63  * ROR-ADC (zp,X)$
+		0,		// 63  * RRA (zp,X)$
 		0,		// 64  * NOP zp$
 		&opAdc_ZPAddr,		// 65    ADC zp$
 		&opROR_ZPAddr,		// 66    ROR zp$
-		0,		// 67  * ROR-ADC zp$
+		0,		// 67  * RRA zp$
 		&opPLA,		// 68    PLA$
 		&opAdc_Immediate,		// 69    ADC #n$
 		&opROR,		// 6A    ROR A$
@@ -2113,41 +3022,41 @@ int main(int argc,char **argv)
 		&opJMP_IndAddr,		// 6C    JMP (abs)$
 		&opAdc_Addr,		// 6D    ADC abs$
 		&opROR_Addr,		// 6E    ROR abs$
-		0,		// 6F  * ROR-ADC abs$
+		0,		// 6F  * RRA abs$
 
 		&opBVS0,		// 70    BVS rel$
 		&opAdc_IndZPAddr_Y,		// 71    ADC (zp),Y$
 		0,		// 72  * HALT$
-		0,		// 73  * ROR-ADC (zp),Y$
+		0,		// 73  * RRA (zp),Y$
 		0,		// 74  * NOP zp$
 		&opAdc_ZPAddr_X,		// 75    ADC zp,X$
 		&opROR_ZPAddr_X,		// 76    ROR zp,X$
-		0,		// 77  * ROR-ADC abs,X$
+		0,		// 77  * RRA zp,X$
 		&opSei,		// 78    SEI$
 		&opAdc_Addr_Y,		// 79    ADC abs,Y$
 		0,		// 7A  * NOP$
-		0,		// 7B  * ROR-ADC abs,Y$
+		0,		// 7B  * RRA abs,Y$
 		0,		// 7C  * NOP abs$
 		&opAdc_Addr_X,		// 7D    ADC abs,X$
 		&opROR_Addr_X,		// 7E    ROR abs,X$
-		&opStartIRQ2,		// 7F  * ROR-ADC abs,X$
+		0,		// 7F  * RRA abs,X$
 
 		0,		// 80  * NOP zp$
 		&opSTA_IndZPAddr_X,		// 81    STA (zp,X)$
 		0,		// 82  * HALT$
-		0,		// 83  * STA-STX (zp,X)$
+		0,		// 83  * SAX (zp,X)$
 		&opSTY_ZPAddr,		// 84    STY zp$
 		&opSTA_ZPAddr,		// 85    STA zp$
 		&opSTX_ZPAddr,		// 86    STX zp$
-		0,		// 87  * STA-STX zp$
+		0,		// 87  * SAX zp$
 		&opDEY,		// 88    DEY$
 		0,		// 89  * NOP zp$
 		&opTXA,		// 8A    TXA A$
-		0,		// 8B  * TXA-AND #n$
+		&opMoveBlock_ZPAddr,		// 8B  * MVB zp (TXA-AND #n)$
 		&opSTY_Addr,		// 8C    STY abs$
 		&opSTA_Addr,		// 8D    STA abs$
 		&opSTX_Addr,		// 8E    STX abs$
-		0,		// 8F  * STA-STX abs$
+		0,		// 8F  * SAX abs$
 
 		&opBCC0,		// 90    BCC rel$
 		&opSTA_IndZPAddr_Y,		// 91    STA (zp),Y$
@@ -2156,11 +3065,11 @@ int main(int argc,char **argv)
 		&opSTY_ZPAddr_X,		// 94    STY zp$,x
 		&opSTA_ZPAddr_X,		// 95    STA zp,X$
 		&opSTX_ZPAddr_Y,		// 96    STX zp,Y$
-		0,		// 97  * STA-STX zp,Y$
+		0,		// 97  * SAX zp,Y$
 		&opTYA,		// 98    TYA$
 		&opSTA_Addr_Y,		// 99    STA abs,Y$
 		&opTXS,		// 9A    TXS$
-		0,		// 9B  * STA-STX abs,Y$
+		&opIllegal,		// 9B  * HALT, the MVB loop is only in the continuation banks$
 		0,		// 9C  * STA-STX abs,X$
 		&opSTA_Addr_X,		// 9D    STA abs,X$
 		0,		// 9E  * STA-STX abs,X$
@@ -2169,79 +3078,79 @@ int main(int argc,char **argv)
 		&opLDY_Immediate,		// A0    LDY #n$
 		&opLDA_IndZPAddr_X,		// A1    LDA (zp,X)$
 		&opLDX_Immediate,		// A2    LDX #n$
-		0,		// A3  * LDA-LDX (zp,X)$
+		0,		// A3  * LAX (zp,X)$
 		&opLDY_ZPAddr,		// A4    LDY zp$
 		&opLDA_ZPAddr,		// A5    LDA zp$
 		&opLDX_ZPAddr,		// A6    LDX zp$
-		0,		// A7  * LDA-LDX zp$
+		0,		// A7  * LAX zp$
 		&opTAY,		// A8    TAY$
 		&opLDA_Immediate,		// A9    LDA #n$
 		&opTAX,		// AA    TAX$
-		0,		// AB  * LDA-LDX$
+		&opFillBlock_ZPAddr,		// AB  * FLB zp (LDA-LDX)$
 		&opLDY_Addr,		// AC    LDY abs$
 		&opLDA_Addr,		// AD    LDA abs$
 		&opLDX_Addr,		// AE    LDX abs$
-		0,		// AF  * LDA-LDX abs$
+		0,		// AF  * LAX abs$
 
 		&opBCS0,		// B0    BCS rel$
 		&opLDA_IndZPAddr_Y,		// B1    LDA (zp),Y$
 		0,		// B2  * HALT$
-		0,		// B3  * LDA-LDX (zp),Y$
+		0,		// B3  * LAX (zp),Y$
 		&opLDY_ZPAddr_X,		// B4    LDY zp$
 		&opLDA_ZPAddr_X,		// B5    LDA zp,X$
 		&opLDX_ZPAddr_Y,		// B6    LDX zp,Y$
-		0,		// B7  * LDA-LDX zp,Y$
+		0,		// B7  * LAX zp,Y$
 		&opClv,		// B8    CLV$
 		&opLDA_Addr_Y,		// B9    LDA abs,Y$
 		&opTSX,		// BA    TSX$
-		0,		// BB  * LDA-LDX abs,Y$
+		&opIllegal,		// BB  * HALT, the FLB loop is only in the continuation banks$
 		&opLDY_Addr_X,		// BC    LDY abs,X$
 		&opLDA_Addr_X,		// BD    LDA abs,X$
 		&opLDX_Addr_Y,		// BE    LDX abs,Y$
-		0,		// BF  * LDA-LDX abs,Y$
+		0,		// BF  * LAX abs,Y$
 
 		&opCpy_Immediate,		// C0    CPY #n$
 		&opCmp_IndZPAddr_X,		// C1    CMP (zp,X)$
 		0,		// C2  * HALT$
-		0,		// C3  * DEC-CMP (zp,X)$
+		0,		// C3  * DCP (zp,X)$
 		&opCpy_ZPAddr,		// C4    CPY zp$
 		&opCmp_ZPAddr,		// C5    CMP zp$
 		&opDEC_ZPAddr,		// C6    DEC zp$
-		0,		// C7  * DEC-CMP zp$
+		0,		// C7  * DCP zp$
 		&opINY,		// C8    INY$
 		&opCmp_Immediate,		// C9    CMP #n$
 		&opDEX,		// CA    DEX$
-		0,		// CB  * SBX #n$
+		&opMUL,		// CB  * MUL (SBX #n)$
 		&opCpy_Addr,		// CC    CPY abs$
 		&opCmp_Addr,		// CD    CMP abs$
 		&opDEC_Addr,		// CE    DEC abs$
-		0,		// CF  * DEC-CMP abs$
+		0,		// CF  * DCP abs$
 
 		&opBNE0,		// D0    BNE rel$
 		&opCmp_IndZPAddr_Y,		// D1    CMP (zp),Y$
 		0,		// D2  * HALT$
-		0,		// D3  * DEC-CMP (zp),Y$
+		0,		// D3  * DCP (zp),Y$
 		0,		// D4  * NOP zp$
 		&opCmp_ZPAddr_X,		// D5    CMP zp,X$
-		&opINC_ZPAddr_X,		// D6    DEC zp,X$
-		0,		// D7  * DEC-CMP zp,X$
-		&opNOP,		// D8    CLD$
+		&opDEC_ZPAddr_X,		// D6    DEC zp,X$
+		0,		// D7  * DCP zp,X$
+		&opCld,		// D8    CLD$
 		&opCmp_Addr_Y,		// D9    CMP abs,Y$
 		0,		// DA  * NOP$
-		0,		// DB  * DEC-CMP abs,Y$
+		0,		// DB  * DCP abs,Y$
 		0,		// DC  * NOP abs$
 		&opCmp_Addr_X,		// DD    CMP abs,X$
 		&opDEC_Addr_X,		// DE    DEC abs,X$
-		0,		// DF  * DEC-CMP abs,X$
+		0,		// DF  * DCP abs,X$
 
 		&opCpx_Immediate,		// E0    CPX #n$
 		&opSbc_IndZPAddr_X,		// E1    SBC (zp,X)$
 		0,		// E2  * HALT$
-		0,		// E3  * INC-SBC (zp,X)$
+		0,		// E3  * ISC (zp,X)$
 		&opCpx_ZPAddr,		// E4    CPX zp$
 		&opSbc_ZPAddr,		// E5    SBC zp$
 		&opINC_ZPAddr,		// E6    INC zp$
-		0,		// E7  * INC-SBC zp$
+		0,		// E7  * ISC zp$
 		&opINX,		// E8    INX$
 		&opSbc_Immediate,		// E9    SBC #n$
 		&opNOP,		// EA    NOP$
@@ -2249,26 +3158,31 @@ int main(int argc,char **argv)
 		&opCpx_Addr,		// EC    CPX abs$
 		&opSbc_Addr,		// ED    SBC abs$
 		&opINC_Addr,		// EE    INC abs$
-		0,		// EF  * INC-SBC abs$
+		0,		// EF  * ISC abs$
 
 		&opBEQ0,		// F0    BEQ rel$
 		&opSbc_IndZPAddr_Y,		// F1    SBC (zp),Y$
 		0,		// F2  * HALT$
-		0,		// F3  * INC-SBC (zp),Y$
+		0,		// F3  * ISC (zp),Y$
 		0,		// F4  * NOP zp$
 		&opSbc_ZPAddr_X,		// F5    SBC zp,X$
 		&opINC_ZPAddr_X,		// F6    INC zp,X$
-		0,		// F7  * INC-SBC zp,X$
-		&opNOP,		// F8    SED$
+		0,		// F7  * ISC zp,X$
+		&opSed,		// F8    SED$
 		&opSbc_Addr_Y,		// F9    SBC abs,Y$
 		0,		// FA  * NOP$
-		0,		// FB  * INC-SBC abs,Y$
+		0,		// FB  * ISC abs,Y$
 		&opStartIRQ,		// FC  * NOP abs$
 		&opSbc_Addr_X,		// FD    SBC abs,X$
 		&opINC_Addr_X,		// FE    INC abs,X$
-		&opBoot,		// FF  * INC-SBC abs,X$
+		&opBoot,		// FF  * ISC abs,X, used by opBoot$
 	};
 
+	for (undocumentedIndex=0;undocumentedIndex<kNumUndocumentedOpcodes;undocumentedIndex++)
+	{
+		opcodes[kUndocumentedOpcodes[undocumentedIndex].mOpcode] = &opUndocumented[undocumentedIndex];
+	}
+
 	// Sparse array
 	Extensions *opcodesDoBranch[256];
 	memset(opcodesDoBranch,0,sizeof(opcodesDoBranch));
@@ -2281,118 +3195,340 @@ int main(int argc,char **argv)
 	opcodesDoBranch[0xd0] = &opBNE1;
 	opcodesDoBranch[0xf0] = &opBEQ1;
 
+	// The 65C02 variant. The NMOS undocumented opcodes do not use any of these slots so they are left in place.
+	if (is65C02)
+	{
+		opcodes[0x04] = &opTSB_ZPAddr;		// 04    TSB zp
+		opcodes[0x0c] = &opTSB_Addr;		// 0C    TSB abs
+		opcodes[0x12] = &opOra_IndZPAddr;	// 12    ORA (zp)
+		opcodes[0x14] = &opTRB_ZPAddr;		// 14    TRB zp
+		opcodes[0x1a] = &opINA;				// 1A    INC A
+		opcodes[0x1c] = &opTRB_Addr;		// 1C    TRB abs
+		opcodes[0x32] = &opAnd_IndZPAddr;	// 32    AND (zp)
+		opcodes[0x3a] = &opDEA;				// 3A    DEC A
+		opcodes[0x52] = &opEor_IndZPAddr;	// 52    EOR (zp)
+		opcodes[0x5a] = &opPHY;				// 5A    PHY
+		opcodes[0x64] = &opSTZ_ZPAddr;		// 64    STZ zp
+		opcodes[0x6c] = &opJMP_IndAddr65C02;	// 6C    JMP (abs)
+		opcodes[0x72] = &opAdc_IndZPAddr;	// 72    ADC (zp)
+		opcodes[0x74] = &opSTZ_ZPAddr_X;	// 74    STZ zp,X
+		opcodes[0x7a] = &opPLY;				// 7A    PLY
+		opcodes[0x7c] = &opJMP_IndAddr_X;	// 7C    JMP (abs,X)
+		opcodes[0x80] = &opBRA;				// 80    BRA rel
+		opcodes[0x92] = &opSTA_IndZPAddr;	// 92    STA (zp)
+		opcodes[0x9c] = &opSTZ_Addr;		// 9C    STZ abs
+		opcodes[0x9e] = &opSTZ_Addr_X;		// 9E    STZ abs,X
+		opcodes[0xb2] = &opLDA_IndZPAddr;	// B2    LDA (zp)
+		opcodes[0xd2] = &opCmp_IndZPAddr;	// D2    CMP (zp)
+		opcodes[0xda] = &opPHX;				// DA    PHX
+		opcodes[0xf2] = &opSbc_IndZPAddr;	// F2    SBC (zp)
+		opcodes[0xfa] = &opPLX;				// FA    PLX
+	}
+
+	// The continuation banks have the opcodes that are loaded from the constant generator, SplitContinuations() adds the continuation
+	// opcodes to the free slots. Sparse arrays, the empty slots are opIllegal.
+	Extensions *continuationOpcodes[256];
+	memset(continuationOpcodes,0,sizeof(continuationOpcodes));
+	Extensions *continuationOpcodesDoBranch[256];
+	memset(continuationOpcodesDoBranch,0,sizeof(continuationOpcodesDoBranch));
+	continuationOpcodes[kConstantGeneratorValues[kD2ConstFCToDB]] = &opStartIRQ;
+	continuationOpcodes[kConstantGeneratorValues[kD2ConstMoveBlockLoopToDB]] = &opMoveBlockLoop0;
+	continuationOpcodesDoBranch[kConstantGeneratorValues[kD2ConstMoveBlockLoopToDB]] = &opMoveBlockLoop1;
+	continuationOpcodes[kConstantGeneratorValues[kD2ConstFillBlockLoopToDB]] = &opFillBlockLoop0;
+	continuationOpcodesDoBranch[kConstantGeneratorValues[kD2ConstFillBlockLoopToDB]] = &opFillBlockLoop1;
+
+	if (padTicks)
+	{
+		std::vector<Extensions *> padded;
+		PadOpcodes(opcodes,padTicks,opIllegal,padded);
+		PadOpcodes(opcodesDoBranch,padTicks,opIllegal,padded);
+		PadOpcodes(continuationOpcodes,padTicks,opIllegal,padded);
+		PadOpcodes(continuationOpcodesDoBranch,padTicks,opIllegal,padded);
+	}
+
+
+	// The constant generator has the same constants for every opcode and continuation bank except for the continuation opcode
+	unsigned char constantROM[2][256][16];
+	int op;
+	for (op=0;op<256;op++)
+	{
+		memcpy(constantROM[0][op],kConstantGeneratorValues,sizeof(kConstantGeneratorValues));
+		memcpy(constantROM[1][op],kConstantGeneratorValues,sizeof(kConstantGeneratorValues));
+	}
+
+	// Compare the undocumented opcodes with the documented instruction pairs they replace
+	for (op=0;op<kNumUndocumentedOpcodes;op++)
+	{
+		const UndocumentedOpcode &undocumented = kUndocumentedOpcodes[op];
+		const int undocumentedLength = (int) opcodes[undocumented.mOpcode]->GetLength();
+		if (undocumented.mPair[0] < 0)
+		{
+			printf("Undocumented %02x %-12s : %2d ticks, no documented pair\n",undocumented.mOpcode,undocumented.mName,undocumentedLength);
+			continue;
+		}
+		const int pair0 = undocumented.mPair[0];
+		const int pair1 = undocumented.mPair[1];
+		printf("Undocumented %02x %-12s : %2d ticks, documented pair %02x %02x : %2d ticks\n",undocumented.mOpcode,undocumented.mName,undocumentedLength,pair0,pair1,(int) (opcodes[pair0]->GetLength() + opcodes[pair1]->GetLength()));
+	}
+
+	// The average opcode length does not include the continuation opcodes
+	bool implemented[256];
+	for (op=0;op<256;op++)
+	{
+		implemented[op] = opcodes[op] && (opcodes[op] != &opIllegal);
+	}
+	for (op=0;op<256;op++)
+	{
+		SplitContinuations(opcodes,opcodesDoBranch,continuationOpcodes,continuationOpcodesDoBranch,constantROM,0,op,opIllegal);
+	}
+	for (op=0;op<256;op++)
+	{
+		SplitContinuations(continuationOpcodes,continuationOpcodesDoBranch,continuationOpcodes,continuationOpcodesDoBranch,constantROM,1,op,opIllegal);
+	}
 
+	// The lengths per decoder bank for the tick report, zero is not implemented. Each opcode includes the continuation opcodes it loads
+	// and the continuation slots are not in the report. The opcode length table has the longest bank of each opcode.
 	size_t opCodeLengths[256];
 	memset(opCodeLengths,0,sizeof(opCodeLengths));
+	size_t bankLengths[kNumReportBanks][256];
+	memset(bankLengths,0,sizeof(bankLengths));
+	for (op=0;op<256;op++)
+	{
+		if (!opcodes[op] && !opcodesDoBranch[op])
+		{
+			continue;
+		}
+		Extensions *opcode = opcodes[op] ? opcodes[op] : &opIllegal;
+		Extensions *opcodeDoBranch = opcodesDoBranch[op] ? opcodesDoBranch[op] : opcode;
+		// The NMI banks are the IRQ banks except opStartNMI replaces opStartIRQ
+		Extensions *opcodeNMI = (op == kConstantGeneratorValues[kD2ConstFCToDB]) ? &opStartNMI : opcode;
+		Extensions *opcodeNMIDoBranch = (op == kConstantGeneratorValues[kD2ConstFCToDB]) ? &opStartNMI : opcodeDoBranch;
+		bankLengths[kReportBankNormal][op] = GetChainLength(opcode,continuationOpcodes,continuationOpcodesDoBranch,false,false);
+		bankLengths[kReportBankDoBranch][op] = GetChainLength(opcodeDoBranch,continuationOpcodes,continuationOpcodesDoBranch,true,false);
+		bankLengths[kReportBankIRQ][op] = GetChainLength(opcode,continuationOpcodes,continuationOpcodesDoBranch,false,true);
+		bankLengths[kReportBankIRQDoBranch][op] = GetChainLength(opcodeDoBranch,continuationOpcodes,continuationOpcodesDoBranch,true,true);
+		bankLengths[kReportBankNMI][op] = GetChainLength(opcodeNMI,continuationOpcodes,continuationOpcodesDoBranch,false,true);
+		bankLengths[kReportBankNMIDoBranch][op] = GetChainLength(opcodeNMIDoBranch,continuationOpcodes,continuationOpcodesDoBranch,true,true);
+		int bank;
+		for (bank=0;bank<kNumReportBanks;bank++)
+		{
+			opCodeLengths[op] = __max(bankLengths[bank][op],opCodeLengths[op]);
+		}
+	}
+	// Some halt opcodes are opIllegal in the table to trap them, they are not implemented so they are not in the report
+	for (op=0;op<256;op++)
+	{
+		if (opcodes[op] == &opIllegal)
+		{
+			int bank;
+			for (bank=0;bank<kNumReportBanks;bank++)
+			{
+				bankLengths[bank][op] = 0;
+			}
+		}
+	}
+
+	// The committed report is the baseline, so it is compared before anything is written and a compare run never replaces it
+	if (compareOnly)
+	{
+		sTickRegressions += CompareTickReport(path,bankLengths);
+		return 0.0;
+	}
+
+	// Opcodes that end with the IRQ check, these can be followed by opStartIRQ or opStartNMI
+	bool irqCheck[256];
+	for (op=0;op<256;op++)
+	{
+		irqCheck[op] = opcodes[op] && opcodes[op]->HasIRQCheck();
+	}
 
-	// Output opcodes
+	// Output opcodes, the normal banks then the continuation banks
 	FILE *fp,*fp2;
 	int i;
 	int decoder;
-	for (decoder = 1;decoder <= 5; decoder++)
+	int continuationBank;
+	for (continuationBank=0;continuationBank<2;continuationBank++)
 	{
-		char buffer[256];
-		sprintf(buffer,"../DecoderROM%d.bin",decoder);
-		fp = fopen(buffer,"wb");
+		Extensions **bankOpcodes = continuationBank ? continuationOpcodes : opcodes;
+		Extensions **bankOpcodesDoBranch = continuationBank ? continuationOpcodesDoBranch : opcodesDoBranch;
 
-		int op;
-		// Write base opcodes
-		for (op=0;op<256;op++)
+		for (decoder = 1;decoder <= 5; decoder++)
 		{
-			if (opcodes[op])
+			char buffer[256];
+			sprintf(buffer,"%sDecoderROM%d.bin",path,decoder);
+			fp = fopen(buffer,continuationBank ? "a+b" : "wb");
+
+			int op;
+			// Write base opcodes
+			for (op=0;op<256;op++)
 			{
-				opcodes[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodes[op]->GetLength(),opCodeLengths[op]);
+				if (bankOpcodes[op])
+				{
+					bankOpcodes[op]->Write(decoder-1,fp);
+				}
+				else
+				{
+					opIllegal.Write(decoder-1,fp);
+				}
 			}
-			else
+
+			// Write do branch opcodes
+			for (op=0;op<256;op++)
 			{
-				opIllegal.Write(decoder-1,fp);
+				if (bankOpcodesDoBranch[op])
+				{
+					bankOpcodesDoBranch[op]->Write(decoder-1,fp);
+				}
+				else if (bankOpcodes[op])
+				{
+					bankOpcodes[op]->Write(decoder-1,fp);
+				}
+				else
+				{
+					opIllegal.Write(decoder-1,fp);
+				}
 			}
+
+			fclose(fp);
 		}
 
-		// Write do branch opcodes
-		for (op=0;op<256;op++)
+
+
+		// Output opcodes for IRQ enabled states
+		for (decoder = 1;decoder <= 5; decoder++)
 		{
-			if (opcodesDoBranch[op])
+			char buffer[256];
+			sprintf(buffer,"%sDecoderROM%d.bin",path,decoder);
+			fp = fopen(buffer,"a+b");
+
+			int op;
+
+			for (op=0;op<256;op++)
 			{
-				opcodesDoBranch[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodesDoBranch[op]->GetLength(),opCodeLengths[op]);
+				if (bankOpcodes[op])
+				{
+					bankOpcodes[op]->WriteInterruptBank(decoder-1,fp);
+				}
+				else
+				{
+					opIllegal.WriteInterruptBank(decoder-1,fp);
+				}
 			}
-			else if (opcodes[op])
+			for (op=0;op<256;op++)
 			{
-				opcodes[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodes[op]->GetLength(),opCodeLengths[op]);
+				if (bankOpcodesDoBranch[op])
+				{
+					bankOpcodesDoBranch[op]->WriteInterruptBank(decoder-1,fp);
+				}
+				else if (bankOpcodes[op])
+				{
+					bankOpcodes[op]->WriteInterruptBank(decoder-1,fp);
+				}
+				else
+				{
+					opIllegal.WriteInterruptBank(decoder-1,fp);
+				}
 			}
-			else
+
+
+			fclose(fp);
+		}
+
+		// Output opcodes for the NMI states, written twice because the NMI banks ignore the IRQ state line.
+		// These are the IRQ enabled states from above except opStartNMI replaces opStartIRQ.
+		for (decoder = 1;decoder <= 5; decoder++)
+		{
+			char buffer[256];
+			sprintf(buffer,"%sDecoderROM%d.bin",path,decoder);
+			fp = fopen(buffer,"a+b");
+
+			int irqState;
+			for (irqState=0;irqState<2;irqState++)
 			{
-				opIllegal.Write(decoder-1,fp);
+				int doBranch;
+				for (doBranch=0;doBranch<2;doBranch++)
+				{
+					int op;
+					for (op=0;op<256;op++)
+					{
+						Extensions *opcode = &opIllegal;
+						if (op == kConstantGeneratorValues[kD2ConstFCToDB])
+						{
+							opcode = &opStartNMI;
+						}
+						else if (doBranch && bankOpcodesDoBranch[op])
+						{
+							opcode = bankOpcodesDoBranch[op];
+						}
+						else if (bankOpcodes[op])
+						{
+							opcode = bankOpcodes[op];
+						}
+						opcode->WriteInterruptBank(decoder-1,fp);
+					}
+				}
 			}
-		}
 
-		fclose(fp);
+			fclose(fp);
+		}
 	}
 
 
-
-	// Output opcodes for IRQ enabled states
-	for (decoder = 1;decoder <= 5; decoder++)
+	// Write the opcode length table
+	char buffer[256];
+	sprintf(buffer,"%sOpCodeLengths.txt",path);
+	fp = fopen(buffer,"w");
+	printf("Timing profile %s\n",profile.mName);
+	fprintf(fp,"Timing profile %s\n",profile.mName);
+	for (i=0;i<256;i+=8)
 	{
-		char buffer[256];
-		sprintf(buffer,"../DecoderROM%d.bin",decoder);
-		fp = fopen(buffer,"a+b");
+		printf("Opcode %2x : %2d %2d %2d %2d %2d %2d %2d %2d\n",i,opCodeLengths[i+0],opCodeLengths[i+1],opCodeLengths[i+2],opCodeLengths[i+3],opCodeLengths[i+4],opCodeLengths[i+5],opCodeLengths[i+6],opCodeLengths[i+7]);
+		fprintf(fp,"Opcode %2x : %2d %2d %2d %2d %2d %2d %2d %2d\n",i,opCodeLengths[i+0],opCodeLengths[i+1],opCodeLengths[i+2],opCodeLengths[i+3],opCodeLengths[i+4],opCodeLengths[i+5],opCodeLengths[i+6],opCodeLengths[i+7]);
+	}
+	fclose(fp);
 
-		int op;
+	WriteTickReport(profile,path,bankLengths,irqCheck);
 
+	// Write the constant generator
+	sprintf(buffer,"%sConstantROM.bin",path);
+	fp = fopen(buffer,"wb");
+	fwrite(constantROM,1,sizeof(constantROM),fp);
+	fclose(fp);
+
+	// Write the nybble multiply ROM, addressed by the in1 nybble, the in2 nybble then the kD2MulShl4/kD2MulShr4 bits
+	sprintf(buffer,"%sMulROM.bin",path);
+	fp = fopen(buffer,"wb");
+	int shift;
+	for (shift=0;shift<4;shift++)
+	{
 		for (op=0;op<256;op++)
 		{
-			if (opcodes[op])
-			{
-				opcodes[op]->FindIRQLEAndReplace();
-				opcodes[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodes[op]->GetLength(),opCodeLengths[op]);
-			}
-			else
-			{
-				opIllegal.FindIRQLEAndReplace();
-				opIllegal.Write(decoder-1,fp);
-			}
-		}
-		for (op=0;op<256;op++)
-		{
-			if (opcodesDoBranch[op])
+			const unsigned char product = (unsigned char) ((op & 15) * (op >> 4));
+			unsigned char work = product;
+			if (shift == (kD2MulShl4 >> 2))
 			{
-				opcodesDoBranch[op]->FindIRQLEAndReplace();
-				opcodesDoBranch[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodesDoBranch[op]->GetLength(),opCodeLengths[op]);
+				work = (unsigned char) (product << 4);
 			}
-			else if (opcodes[op])
+			else if (shift == (kD2MulShr4 >> 2))
 			{
-				opcodes[op]->FindIRQLEAndReplace();
-				opcodes[op]->Write(decoder-1,fp);
-				opCodeLengths[op] = __max(opcodes[op]->GetLength(),opCodeLengths[op]);
+				work = product >> 4;
 			}
-			else
+			else if (shift == ((kD2MulShl4 | kD2MulShr4) >> 2))
 			{
-				opIllegal.FindIRQLEAndReplace();
-				opIllegal.Write(decoder-1,fp);
+				work = (unsigned char) ((product << 4) | (product >> 4));
 			}
+			fputc(work,fp);
 		}
-
-
-		fclose(fp);
-	}
-
-
-	for (i=0;i<256;i+=8)
-	{
-		printf("Opcode %2x : %2d %2d %2d %2d %2d %2d %2d %2d\n",i,opCodeLengths[i+0],opCodeLengths[i+1],opCodeLengths[i+2],opCodeLengths[i+3],opCodeLengths[i+4],opCodeLengths[i+5],opCodeLengths[i+6],opCodeLengths[i+7]);
 	}
+	fclose(fp);
 
 	// Write ALU1
 	// ALU operations with 1 input use both inputs set the same
-	fp = fopen("../ALU1.bin","wb");
-	fp2 = fopen("../ALU2.bin","wb");
-	int j,op,inFlags;
+	sprintf(buffer,"%sALU1.bin",path);
+	fp = fopen(buffer,"wb");
+	sprintf(buffer,"%sALU2.bin",path);
+	fp2 = fopen(buffer,"wb");
+	int j,inFlags;
 	for (inFlags=0;inFlags<=15;inFlags++)
 	{
 		for (j=0;j<16;j++)
@@ -2483,8 +3619,40 @@ int main(int argc,char **argv)
 								}
 							}
 
-							fputc(((work) & 15) | flags,fp);
-							fputc(((work) & 15) | flags,fp2);
+							if (!(inFlags & kALUInFlg_D))
+							{
+								fputc(((work) & 15) | flags,fp);
+								fputc(((work) & 15) | flags,fp2);
+								break;
+							}
+
+							// ALU1 BCD, the carry is still the binary carry and the half carry goes to ALU2 as the special flag
+							flags = CalculateCZFlags(work);
+							unsigned char work1 = work;
+							if (work1 >= 10)
+							{
+								flags |= kALU1OutFlg_Special;
+								work1 += 6;
+							}
+							fputc((work1 & 15) | flags,fp);
+
+							// ALU2 BCD, Z is from the binary sum and N/V are from the sum with the half carry before the correction
+							unsigned char work2 = i + j;
+							if (inFlags & kALUInFlg_Special)
+							{
+								work2++;
+							}
+							flags = CalculateZeroFlag(work) | CalculateNegativeFlag(work2);
+							if ( (CalculateNegativeFlag(i) == CalculateNegativeFlag(j)) && (CalculateNegativeFlag(work2) != CalculateNegativeFlag(i)) )
+							{
+								flags |= kALUOutFlg_V;
+							}
+							if (work2 >= 10)
+							{
+								flags |= kALUOutFlg_C;
+								work2 += 6;
+							}
+							fputc((work2 & 15) | flags,fp2);
 							break;
 						}
 						case kD3ALUOp_Sub:
@@ -2504,7 +3672,7 @@ int main(int argc,char **argv)
 							// pos and neg sub
 							if (!CalculateNegativeFlag(i) && CalculateNegativeFlag(j))
 							{
-								if (!CalculateNegativeFlag(work))
+								if (CalculateNegativeFlag(work))
 								{
 									flags |= kALUOutFlg_V;
 								}
@@ -2519,6 +3687,12 @@ int main(int argc,char **argv)
 								}
 							}
 
+							// BCD only corrects the nybble after a borrow, the flags are from the binary result
+							if ( (inFlags & kALUInFlg_D) && (work & 16) )
+							{
+								work -= 6;
+							}
+
 							fputc(((work) & 15) | flags,fp);
 							fputc(((work) & 15) | flags,fp2);
 							break;
@@ -2527,7 +3701,7 @@ int main(int argc,char **argv)
 						{
 							unsigned char work = i,flags;
 							work |= j;
-							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work) | CalculateNegativeFlag(work);
 							flags |= PreserveOverflowFlag(inFlags);
 							fputc(((work) & 15) | flags,fp);
 							fputc(((work) & 15) | flags,fp2);
@@ -2537,7 +3711,7 @@ int main(int argc,char **argv)
 						{
 							unsigned char work = i,flags;
 							work &= j;
-							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work) | CalculateNegativeFlag(work);
 							flags |= PreserveOverflowFlag(inFlags);
 							fputc(((work) & 15) | flags,fp);
 							fputc(((work) & 15) | flags,fp2);
@@ -2547,7 +3721,7 @@ int main(int argc,char **argv)
 						{
 							unsigned char work = i,flags;
 							work ^= j;
-							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work) | CalculateNegativeFlag(work);
 							flags |= PreserveOverflowFlag(inFlags);
 							fputc(((work) & 15) | flags,fp);
 							fputc(((work) & 15) | flags,fp2);
@@ -2768,8 +3942,197 @@ int main(int argc,char **argv)
 			}
 		}
 	}
+
+	// The extended functions selected by kD5ALUBank are the upper half of both ALU ROMs
+	for (inFlags=0;inFlags<=15;inFlags++)
+	{
+		for (j=0;j<16;j++)
+		{
+			for (i=0;i<16;i++)
+			{
+				for (op=kD3ALUOpX_SignExtend;op<=(15<<3);op+=8)
+				{
+					switch(op)
+					{
+						case kD3ALUOpX_SignExtend:
+						{
+							// ALU1, the top bit of the lo nybble is not known so use bit 4 of ALU in2
+							unsigned char work = (inFlags & kALUInFlg_Special) ? 15 : 0,flags;
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							flags |= PreserveOverflowFlag(inFlags);
+							fputc(work | flags,fp);
+
+							// ALU2
+							work = (i & (1<<3)) ? 15 : 0;
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work) | CalculateNegativeFlag(work);
+							flags |= PreserveOverflowFlag(inFlags);
+							fputc(work | flags,fp2);
+							break;
+						}
+						case kD3ALUOpX_ZToCarry:
+						{
+							// ALU1 has the Z flag in bit 1 and passes it to ALU2 as the carry
+							unsigned char flags = 0;
+							if (i & (1<<1))
+							{
+								flags |= kALUOutFlg_C;
+							}
+							fputc(i | flags,fp);
+
+							// ALU2
+							flags = PreserveCarryFlag(inFlags) | PreserveOverflowFlag(inFlags);
+							fputc(i | flags,fp2);
+							break;
+						}
+						case kD3ALUOpX_VToCarry:
+						{
+							// ALU1
+							fputc(i,fp);
+
+							// ALU2 has the V flag in bit 6 - 4 = 2
+							unsigned char flags = PreserveOverflowFlag(inFlags);
+							if (i & (1<<2))
+							{
+								flags |= kALUOutFlg_C;
+							}
+							fputc(i | flags,fp2);
+							break;
+						}
+						case kD3ALUOpX_BIT:
+						{
+							// ALU1, the carry is passed through to ALU2
+							unsigned char work = i & j,flags;
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							fputc(work | flags,fp);
+
+							// ALU2, N and V are bits 7 and 6 of the memory
+							work = i & j;
+							flags = PreserveCarryFlag(inFlags) | CalculateZeroFlag(work);
+							if (j & (1<<3))
+							{
+								flags |= kALUOutFlg_N;
+							}
+							if (j & (1<<2))
+							{
+								flags |= kALUOutFlg_V;
+							}
+							fputc(work | flags,fp2);
+							break;
+						}
+						default:
+						{
+							fputc(0,fp);
+							fputc(0,fp2);
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
 	fclose(fp);
 	fclose(fp2);
 
+	if (!VerifyBIT(path))
+	{
+		printf("Error: kD3ALUOpX_BIT in %sALU1.bin and %sALU2.bin does not match the original BIT sequence\n",path,path);
+		exit(-1);
+	}
+
+	size_t total = 0;
+	int count = 0;
+	for (op=0;op<256;op++)
+	{
+		if (implemented[op])
+		{
+			total += opCodeLengths[op];
+			count++;
+		}
+	}
+	return (double) total / (double) count;
+}
+
+int main(int argc,char **argv)
+{
+	// -65c02 generates the 65C02 variant for the first profile into its own directory instead
+	// -compare fails with a non-zero exit code, before anything is written, if any opcode is longer than in the OpCodeReport.csv that is
+	// already in each ROM directory. Otherwise the ROMs are generated as usual.
+	bool is65C02 = false;
+	bool compareBaseline = false;
+	int i;
+	for (i=1;i<argc;i++)
+	{
+		if (!strcmp(argv[i],"-65c02"))
+		{
+			is65C02 = true;
+		}
+		else if (!strcmp(argv[i],"-compare"))
+		{
+			compareBaseline = true;
+		}
+		else
+		{
+			printf("Unknown option '%s'\n",argv[i]);
+			return -1;
+		}
+	}
+
+	if (compareBaseline)
+	{
+		if (is65C02)
+		{
+			GenerateROMs(kTimingProfiles[0],"../65C02/",true,true);
+		}
+		else
+		{
+			GenerateROMs(kTimingProfiles[0],"../",false,true);
+			for (i=1;i<kNumTimingProfiles;i++)
+			{
+				char path[256];
+				sprintf(path,"../Profiles/%s/",kTimingProfiles[i].mName);
+				GenerateROMs(kTimingProfiles[i],path,false,true);
+			}
+		}
+		if (sTickRegressions)
+		{
+			printf("%d opcode banks got longer, nothing was written\n",sTickRegressions);
+			return 1;
+		}
+	}
+
+	if (is65C02)
+	{
+		_mkdir("../65C02");
+		const double average = GenerateROMs(kTimingProfiles[0],"../65C02/",true);
+		printf("65C02 timing profile %s : %.2f ticks per opcode at %.1fMHz is %.3fus per opcode\n",kTimingProfiles[0].mName,average,kTimingProfiles[0].mClockMHz,average / kTimingProfiles[0].mClockMHz);
+		return 0;
+	}
+
+	// The first profile is written to the directory used by the schematic
+	std::vector<double> averages;
+	averages.push_back(GenerateROMs(kTimingProfiles[0],"../"));
+
+	// Each of the other profiles gets a complete ROM set in its own directory so the ticks per instruction can be traded against the clock speed
+	_mkdir("../Profiles");
+	for (i=1;i<kNumTimingProfiles;i++)
+	{
+		char path[256];
+		sprintf(path,"../Profiles/%s",kTimingProfiles[i].mName);
+		_mkdir(path);
+		strcat(path,"/");
+		averages.push_back(GenerateROMs(kTimingProfiles[i],path));
+	}
+
+	// The first profile with every opcode padded so most of them are split into continuation opcodes, some more than once.
+	// The KernalROM.a self test run with the Simulator -roms ../Profiles/ContinuationTest/ tests the continuations, it executes the
+	// same instructions as with the ../ ROMs only slower. This is not a timing profile so it is not compared or in the averages.
+	_mkdir("../Profiles/ContinuationTest");
+	GenerateROMs(kTimingProfiles[0],"../Profiles/ContinuationTest/",false,false,kContinuationTestPadTicks);
+
+	for (i=0;i<kNumTimingProfiles;i++)
+	{
+		printf("Timing profile %s : %.2f ticks per opcode at %.1fMHz is %.3fus per opcode\n",kTimingProfiles[i].mName,averages[i],kTimingProfiles[i].mClockMHz,averages[i] / kTimingProfiles[i].mClockMHz);
+	}
+
 	return 0;
 }
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "BusMonitor.h"
+
+static const char *kBusRuleNames[kNumBusRules] =
+{
+	"Memory read directly after a write",
+	"Memory write directly after a read",
+	"Address bus changed on the tick before a memory access",
+	"Address bus changed on the tick after a write",
+	"Data bus changed on the tick after a write",
+	"Memory access without CPUHASBUS",
+	"CPUHASBUS without CPUWANTBUS on the tick before",
+	"BUSDDR set without CPUHASBUS",
+	"BUSDDR changed while CPUHASBUS is held high, or low by an external master",
+	"Memory read without BUSDDR",
+	"Memory write with BUSDDR",
+	"CONSTTODB and MULTODB both drive the data bus",
+	"SPINC and SPDEC together",
+	"SP counting while R3 is on the data bus or loaded"
+};
+
+struct BusMonitorLocation
+{
+	int mAddress;
+	unsigned int mViolations;
+};
+
+static bool SortByViolations(const BusMonitorLocation &a,const BusMonitorLocation &b)
+{
+	return a.mViolations > b.mViolations;
+}
+
+BusMonitor::BusMonitor() : mMaxReports(20) , mViolations(0) , mROMAddress(0) , mPC(0) , mTotalTicks(0) , mHasPrevious(false) , mPreviousD1(0) , mPreviousD2(0) , mPreviousD5(0) ,
+	mPreviousRead(false) , mPreviousAddressBus(0) , mPreviousDataBus(0)
+{
+	memset(mRuleViolations,0,sizeof(mRuleViolations));
+}
+
+BusMonitor::~BusMonitor()
+{
+}
+
+bool BusMonitor::IsCompiledIn(void)
+{
+#ifdef SIMULATOR_BUS_MONITOR
+	return true;
+#else
+	return false;
+#endif
+}
+
+void BusMonitor::CheckTick(const Simulator &simulator)
+{
+	mROMAddress = simulator.GetLastDecoderROMAddress();
+	mPC = simulator.GetLastPC();
+	mTotalTicks = simulator.GetTotalTicks() - 1;
+	CheckState(simulator.GetDecoderROM(0,mROMAddress),simulator.GetDecoderROM(1,mROMAddress),simulator.GetDecoderROM(3,mROMAddress),
+		simulator.GetDecoderROM(4,mROMAddress),simulator.GetLastAddressBus(),simulator.GetLastDataBus());
+}
+
+void BusMonitor::CheckState(const unsigned char d1,const unsigned char d2,const unsigned char d4,const unsigned char d5,const unsigned short addressBus,const unsigned char dataBus)
+{
+	// The constant generator and the nybble multiply ROM disable the decoder 2 data bus source select, so the memory is not read
+	const bool read = !(d5 & (kD5ConstToDB | kD5MulToDB)) && ((d2 & 15) == kD2MemoryToDB);
+	const bool write = (d1 & kD1RAMWrite) ? true : false;
+
+	if (mHasPrevious)
+	{
+		const bool previousWrite = (mPreviousD1 & kD1RAMWrite) ? true : false;
+		if (read && previousWrite)
+		{
+			Report(kBusRuleReadAfterWrite);
+		}
+		if (write && mPreviousRead)
+		{
+			Report(kBusRuleWriteAfterRead);
+		}
+		if ((read || write) && (addressBus != mPreviousAddressBus))
+		{
+			Report(kBusRuleAddressBeforeAccess);
+		}
+		if (previousWrite && (addressBus != mPreviousAddressBus))
+		{
+			Report(kBusRuleAddressAfterWrite);
+		}
+		if (previousWrite && (dataBus != mPreviousDataBus))
+		{
+			Report(kBusRuleDataAfterWrite);
+		}
+		if ((d2 & kD2CPUHasBus) && !(mPreviousD2 & (kD2CPUWantBus | kD2CPUHasBus)))
+		{
+			Report(kBusRuleHasBusWithoutWant);
+		}
+		// BUSDDR sets the direction of the external data bus buffer, so it must only change as the CPU takes or releases the bus and not
+		// while the CPU holds it or while an external master, for example the VIC-II or a DMA cartridge, is driving the bus
+		if (!((d2 ^ mPreviousD2) & kD2CPUHasBus) && ((d2 ^ mPreviousD2) & kD2BUSDDR))
+		{
+			Report(kBusRuleDDRFlip);
+		}
+		// R3 counts on the clock edge at the end of the tick so it must not be used in the tick it counts or the next
+		if (((d5 | mPreviousD5) & (kD5SPInc | kD5SPDec)) && ((d4 & kD4DBToR3) || (!(d5 & (kD5ConstToDB | kD5MulToDB)) && ((d2 & 15) == kD2R3ToDB))))
+		{
+			Report(kBusRuleSPCount);
+		}
+	}
+
+	if ((read || write) && !(d2 & kD2CPUHasBus))
+	{
+		Report(kBusRuleAccessWithoutBus);
+	}
+	if ((d2 & kD2BUSDDR) && !(d2 & kD2CPUHasBus))
+	{
+		Report(kBusRuleDDRWithoutBus);
+	}
+	if (read && !(d2 & kD2BUSDDR))
+	{
+		Report(kBusRuleReadWithoutDDR);
+	}
+	if (write && (d2 & kD2BUSDDR))
+	{
+		Report(kBusRuleWriteWithDDR);
+	}
+	if ((d5 & (kD5ConstToDB | kD5MulToDB)) == (kD5ConstToDB | kD5MulToDB))
+	{
+		Report(kBusRuleTwoSources);
+	}
+	if ((d5 & (kD5SPInc | kD5SPDec)) == (kD5SPInc | kD5SPDec))
+	{
+		Report(kBusRuleSPIncDec);
+	}
+
+	mHasPrevious = true;
+	mPreviousD1 = d1;
+	mPreviousD2 = d2;
+	mPreviousD5 = d5;
+	mPreviousRead = read;
+	mPreviousAddressBus = addressBus;
+	mPreviousDataBus = dataBus;
+}
+
+void BusMonitor::Report(const BusRule rule)
+{
+	const int romAddress = mROMAddress;
+	if (mViolations < mMaxReports)
+	{
+		printf("Bus tick %llu PC $%04x bank %d opcode $%02x tick %d : %s\n",mTotalTicks,mPC,
+			romAddress >> 14,(romAddress >> 6) & 255,romAddress & 63,kBusRuleNames[rule]);
+	}
+	mViolations++;
+	mRuleViolations[rule]++;
+
+	if (mAddressViolations.empty())
+	{
+		mAddressViolations.resize(kDecoderROMSize,0);
+		mAddressRules.resize(kDecoderROMSize,0);
+	}
+	mAddressViolations[romAddress]++;
+	mAddressRules[romAddress] |= (unsigned short) (1 << rule);
+}
+
+unsigned long long BusMonitor::PrintSummary(const int count) const
+{
+	printf("Bus monitor violations %llu\n",mViolations);
+	if (!mViolations)
+	{
+		return 0;
+	}
+
+	int i;
+	for (i=0;i<kNumBusRules;i++)
+	{
+		if (mRuleViolations[i])
+		{
+			printf("%10llu %s\n",mRuleViolations[i],kBusRuleNames[i]);
+		}
+	}
+
+	std::vector<BusMonitorLocation> locations;
+	int address;
+	for (address=0;address<kDecoderROMSize;address++)
+	{
+		if (mAddressViolations[address])
+		{
+			BusMonitorLocation location;
+			location.mAddress = address;
+			location.mViolations = mAddressViolations[address];
+			locations.push_back(location);
+		}
+	}
+	std::sort(locations.begin(),locations.end(),SortByViolations);
+
+	printf("Microcode states with the most violations\n");
+	size_t j;
+	for (j=0;(j<locations.size()) && ((int)j<count);j++)
+	{
+		const int romAddress = locations[j].mAddress;
+		printf("Bank %d opcode $%02x tick %2d violations %10u :",romAddress >> 14,(romAddress >> 6) & 255,romAddress & 63,locations[j].mViolations);
+		for (i=0;i<kNumBusRules;i++)
+		{
+			if (mAddressRules[romAddress] & (1 << i))
+			{
+				printf(" %s.",kBusRuleNames[i]);
+			}
+		}
+		printf("\n");
+	}
+
+	return mViolations;
+}
+
+// One tick of a self-test sequence, the address and data bus are only given for the ticks where they change
+struct BusMonitorTestTick
+{
+	unsigned char mD1;
+	unsigned char mD2;
+	unsigned char mD4;
+	unsigned char mD5;
+	unsigned short mAddressBus;
+	unsigned char mDataBus;
+};
+
+const int kBusMonitorTestMaxTicks = 6;
+
+struct BusMonitorTest
+{
+	const char *mName;
+	int mNumTicks;
+	BusMonitorTestTick mTicks[kBusMonitorTestMaxTicks];
+	// The rules that must be violated, all others must not be
+	unsigned int mExpectedRules;
+};
+
+#define BUS_RULE(rule) (1 << (rule))
+
+static const BusMonitorTest kBusMonitorTests[] =
+{
+	{ "Memory read" , 6 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2BUSDDR } , { 0 , kD2CPUHasBus | kD2BUSDDR | kD2MemoryToDB } ,
+		{ 0 , kD2CPUHasBus | kD2BUSDDR | kD2MemoryToDB } , { 0 , kD2CPUHasBus | kD2BUSDDR } , { 0 , 0 } } , 0 },
+	{ "Memory write" , 5 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2R0ToDB } , { kD1RAMWrite , kD2CPUHasBus | kD2R0ToDB } ,
+		{ 0 , kD2CPUHasBus | kD2R0ToDB } , { 0 , 0 } } , 0 },
+	{ "Read after write" , 4 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2R0ToDB } , { kD1RAMWrite , kD2CPUHasBus | kD2R0ToDB } ,
+		{ 0 , kD2CPUHasBus | kD2BUSDDR | kD2MemoryToDB } } , BUS_RULE(kBusRuleReadAfterWrite) | BUS_RULE(kBusRuleDDRFlip) },
+	{ "Write after read" , 4 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2BUSDDR } , { 0 , kD2CPUHasBus | kD2BUSDDR | kD2MemoryToDB } ,
+		{ kD1RAMWrite , kD2CPUHasBus | kD2R0ToDB } } , BUS_RULE(kBusRuleWriteAfterRead) | BUS_RULE(kBusRuleDDRFlip) },
+	{ "Address before read" , 3 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2BUSDDR } ,
+		{ 0 , kD2CPUHasBus | kD2BUSDDR | kD2MemoryToDB , 0 , 0 , 0x1234 } } , BUS_RULE(kBusRuleAddressBeforeAccess) },
+	{ "Address after write" , 4 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2R0ToDB } , { kD1RAMWrite , kD2CPUHasBus | kD2R0ToDB } ,
+		{ 0 , kD2CPUHasBus | kD2R0ToDB , 0 , 0 , 0x1234 } } , BUS_RULE(kBusRuleAddressAfterWrite) },
+	{ "Data after write" , 4 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2R0ToDB } , { kD1RAMWrite , kD2CPUHasBus | kD2R0ToDB } ,
+		{ 0 , kD2CPUHasBus | kD2R1ToDB , 0 , 0 , 0 , 0x12 } } , BUS_RULE(kBusRuleDataAfterWrite) },
+	{ "Write without the bus" , 2 , { { 0 , kD2R0ToDB } , { kD1RAMWrite , kD2R0ToDB } } , BUS_RULE(kBusRuleAccessWithoutBus) },
+	{ "Bus without a request" , 2 , { { 0 , 0 } , { 0 , kD2CPUHasBus | kD2BUSDDR } } , BUS_RULE(kBusRuleHasBusWithoutWant) },
+	{ "BUSDDR flip while the CPU holds the bus" , 3 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus } , { 0 , kD2CPUHasBus | kD2BUSDDR } } ,
+		BUS_RULE(kBusRuleDDRFlip) },
+	{ "BUSDDR set while an external master has the bus" , 2 , { { 0 , 0 } , { 0 , kD2BUSDDR } } ,
+		BUS_RULE(kBusRuleDDRWithoutBus) | BUS_RULE(kBusRuleDDRFlip) },
+	{ "BUSDDR cleared while an external master has the bus" , 3 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUWantBus | kD2BUSDDR } , { 0 , kD2CPUWantBus } } ,
+		BUS_RULE(kBusRuleDDRWithoutBus) | BUS_RULE(kBusRuleDDRFlip) },
+	{ "Read without BUSDDR" , 3 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus } , { 0 , kD2CPUHasBus | kD2MemoryToDB } } , BUS_RULE(kBusRuleReadWithoutDDR) },
+	{ "Write with BUSDDR" , 3 , { { 0 , kD2CPUWantBus } , { 0 , kD2CPUHasBus | kD2BUSDDR } , { kD1RAMWrite , kD2CPUHasBus | kD2BUSDDR | kD2R0ToDB } } ,
+		BUS_RULE(kBusRuleWriteWithDDR) },
+	{ "Constant and multiply" , 1 , { { 0 , 0 , 0 , kD5ConstToDB | kD5MulToDB } } , BUS_RULE(kBusRuleTwoSources) },
+	{ "SP inc and dec" , 1 , { { 0 , 0 , 0 , kD5SPInc | kD5SPDec } } , BUS_RULE(kBusRuleSPIncDec) },
+	{ "SP counting then on the data bus" , 2 , { { 0 , 0 , 0 , kD5SPDec } , { 0 , kD2R3ToDB } } , BUS_RULE(kBusRuleSPCount) }
+};
+
+bool BusMonitor::SelfTest(void)
+{
+	const int numTests = sizeof(kBusMonitorTests) / sizeof(kBusMonitorTests[0]);
+	int failed = 0;
+	int i;
+	for (i=0;i<numTests;i++)
+	{
+		const BusMonitorTest &test = kBusMonitorTests[i];
+		BusMonitor monitor;
+		monitor.SetMaxReports(0);
+		int tick;
+		for (tick=0;tick<test.mNumTicks;tick++)
+		{
+			const BusMonitorTestTick &state = test.mTicks[tick];
+			monitor.CheckState(state.mD1,state.mD2,state.mD4,state.mD5,state.mAddressBus,state.mDataBus);
+		}
+
+		unsigned int violated = 0;
+		int rule;
+		for (rule=0;rule<kNumBusRules;rule++)
+		{
+			if (monitor.mRuleViolations[rule])
+			{
+				violated |= BUS_RULE(rule);
+			}
+		}
+		if (violated != test.mExpectedRules)
+		{
+			printf("Bus monitor self-test '%s' failed :",test.mName);
+			for (rule=0;rule<kNumBusRules;rule++)
+			{
+				if ((violated ^ test.mExpectedRules) & BUS_RULE(rule))
+				{
+					printf(" %s %s.",(violated & BUS_RULE(rule)) ? "unexpected" : "missing",kBusRuleNames[rule]);
+				}
+			}
+			printf("\n");
+			failed++;
+		}
+	}
+	printf("Bus monitor self-test %d of %d passed\n",numTests - failed,numTests);
+	return !failed;
+}
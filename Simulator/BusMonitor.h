@@ -0,0 +1,94 @@
+#ifndef _BUSMONITOR_H_
+#define _BUSMONITOR_H_
+
+#include <vector>
+#include "Simulator.h"
+
+// The checks are only compiled in when SIMULATOR_BUS_MONITOR is defined, as it is for the Debug configuration.
+// Without it BusMonitor::Check() is empty so the Release build used for benchmarks has no cost for the monitor.
+
+// The design rules checked by BusMonitor, in the order of kBusRuleNames in BusMonitor.cpp
+enum BusRule
+{
+	kBusRuleReadAfterWrite = 0,
+	kBusRuleWriteAfterRead,
+	kBusRuleAddressBeforeAccess,
+	kBusRuleAddressAfterWrite,
+	kBusRuleDataAfterWrite,
+	kBusRuleAccessWithoutBus,
+	kBusRuleHasBusWithoutWant,
+	kBusRuleDDRWithoutBus,
+	kBusRuleDDRFlip,
+	kBusRuleReadWithoutDDR,
+	kBusRuleWriteWithDDR,
+	kBusRuleTwoSources,
+	kBusRuleSPIncDec,
+	kBusRuleSPCount,
+	kNumBusRules
+};
+
+// Checks the decoder outputs and the buses of each executed tick against the tick before it, so unlike OpCode::ValidateStates() it sees
+// the real sequence across opcode boundaries, bank changes and the IRQ and NMI entries with the actual address bus and data bus values.
+// Each violation is reported with the total tick, the PC and the bank, opcode and tick of the microcode state that caused it.
+class BusMonitor
+{
+public:
+	BusMonitor();
+	virtual ~BusMonitor();
+
+	// True if SIMULATOR_BUS_MONITOR was defined for this build
+	static bool IsCompiledIn(void);
+
+	// Prints the first reports violations as they happen, the rest are only counted for PrintSummary()
+	void SetMaxReports(const unsigned int reports)
+	{
+		mMaxReports = reports;
+	}
+
+	// Call after each Simulator::Tick() to check the tick it executed
+	void Check(const Simulator &simulator)
+	{
+#ifdef SIMULATOR_BUS_MONITOR
+		CheckTick(simulator);
+#else
+		(void) simulator;
+#endif
+	}
+
+	// Prints the violations of each rule and the microcode states with the most violations. Returns the total number of violations.
+	unsigned long long PrintSummary(const int count) const;
+
+	// Runs short decoder output sequences that each break one or more rules, and the normal read and write sequences that break none,
+	// through the checks and compares the rules that were violated. Prints each failing sequence and returns false if any failed.
+	// It does not need SIMULATOR_BUS_MONITOR or the ROM images.
+	static bool SelfTest(void);
+
+protected:
+	void CheckTick(const Simulator &simulator);
+	// Checks the decoder outputs and the buses of one tick against the previous tick
+	void CheckState(const unsigned char d1,const unsigned char d2,const unsigned char d4,const unsigned char d5,const unsigned short addressBus,const unsigned char dataBus);
+	void Report(const BusRule rule);
+
+	unsigned int mMaxReports;
+	unsigned long long mViolations;
+	unsigned long long mRuleViolations[kNumBusRules];
+	// Allocated with one entry per decoder ROM address when the first violation happens
+	std::vector<unsigned int> mAddressViolations;
+	std::vector<unsigned short> mAddressRules;
+
+	// The tick being checked
+	int mROMAddress;
+	unsigned short mPC;
+	unsigned long long mTotalTicks;
+
+	// The previous tick
+	bool mHasPrevious;
+	unsigned char mPreviousD1;
+	unsigned char mPreviousD2;
+	unsigned char mPreviousD5;
+	bool mPreviousRead;
+	unsigned short mPreviousAddressBus;
+	unsigned char mPreviousDataBus;
+};
+
+#endif
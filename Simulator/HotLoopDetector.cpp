@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "HotLoopDetector.h"
+#include "Simulator.h"
+
+static const unsigned long long kHotLoopNever = ~0ULL;
+static const unsigned char kOpcodeRTI = 0x40;
+// Labels further than this before the address are not used
+static const int kHotLoopMaxLabelOffset = 256;
+// The oldest half of the credited intervals is dropped when there are more than this, an iteration that started before them
+// has its self ticks overcounted by the ticks of the loops that ran inside it in the dropped intervals
+static const size_t kHotLoopMaxCredited = 4096;
+
+// BPL, BMI, BVC, BVS, BCC, BCS, BNE, BEQ and the 65C02 BRA
+static bool IsRelativeBranch(const unsigned char opcode)
+{
+	return ((opcode & 0x1f) == 0x10) || (opcode == 0x80);
+}
+
+static bool SortBySelfTicks(const HotLoop &a,const HotLoop &b)
+{
+	return a.mSelfTicks > b.mSelfTicks;
+}
+
+static bool SortByAddress(const HotLoopLabel &a,const HotLoopLabel &b)
+{
+	return a.mAddress < b.mAddress;
+}
+
+HotLoopDetector::HotLoopDetector() : mLoopIndex(65536,-1) , mLastStart(65536,kHotLoopNever) , mHasPrevious(false) , mPreviousPC(0) , mPreviousOpcode(0)
+{
+}
+
+HotLoopDetector::~HotLoopDetector()
+{
+}
+
+bool HotLoopDetector::LoadLabels(const char *filename)
+{
+	FILE *fp = fopen(filename,"r");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",filename);
+		return false;
+	}
+
+	char line[256];
+	while (fgets(line,sizeof(line),fp))
+	{
+		HotLoopLabel label;
+		unsigned int address;
+		if ( (sscanf(line,"al C:%x .%63s",&address,label.mName) == 2) || (sscanf(line," %63[^ \t=] = $%x",label.mName,&address) == 2) )
+		{
+			label.mAddress = (unsigned short) address;
+			mLabels.push_back(label);
+		}
+	}
+	fclose(fp);
+
+	// Stable so the first label loaded for an address is used
+	std::stable_sort(mLabels.begin(),mLabels.end(),SortByAddress);
+	return true;
+}
+
+void HotLoopDetector::Sample(const Simulator &simulator)
+{
+	const unsigned short pc = simulator.GetPC();
+	const unsigned long long tick = simulator.GetTotalTicks();
+
+	// The IRQ or NMI entry at the target of a taken branch starts with the PC at the target so it counts the same as the target opcode
+	if (mHasPrevious && IsRelativeBranch(mPreviousOpcode) && (pc <= mPreviousPC))
+	{
+		int &index = mLoopIndex[mPreviousPC];
+		if (index < 0)
+		{
+			HotLoop loop;
+			loop.mTarget = pc;
+			loop.mBranch = mPreviousPC;
+			loop.mSelfTicks = 0;
+			loop.mTicks = 0;
+			loop.mIterations = 0;
+			loop.mEntries = 0;
+			loop.mLastTakenTick = kHotLoopNever;
+			index = (int) mLoops.size();
+			mLoops.push_back(loop);
+		}
+		HotLoop &loop = mLoops[index];
+		// The iteration that just ended started with the last taken branch of this loop, otherwise the loop was entered from somewhere else
+		if (!loop.mIterations || (loop.mLastTakenTick != mLastStart[pc]))
+		{
+			loop.mEntries++;
+		}
+		if (mLastStart[pc] != kHotLoopNever)
+		{
+			loop.mTicks += tick - mLastStart[pc];
+			loop.mSelfTicks += CreditTicks(mLastStart[pc],tick);
+		}
+		loop.mIterations++;
+		loop.mLastTakenTick = tick;
+	}
+
+	// Returning from an interrupt continues the opcode that was interrupted, so it does not start a new iteration
+	if (!mHasPrevious || (mPreviousOpcode != kOpcodeRTI))
+	{
+		mLastStart[pc] = tick;
+	}
+
+	mHasPrevious = true;
+	mPreviousPC = pc;
+	mPreviousOpcode = simulator.GetOpcode();
+}
+
+unsigned long long HotLoopDetector::CreditTicks(const unsigned long long start,const unsigned long long end)
+{
+	// Every interval ends at or before end so only the ones from the back that end after start overlap the iteration
+	HotLoopInterval merged;
+	merged.mStart = start;
+	merged.mEnd = end;
+	unsigned long long credited = 0;
+	while (!mCredited.empty() && (mCredited.back().mEnd >= start))
+	{
+		const HotLoopInterval &interval = mCredited.back();
+		credited += interval.mEnd - std::max(interval.mStart,start);
+		merged.mStart = std::min(merged.mStart,interval.mStart);
+		mCredited.pop_back();
+	}
+	mCredited.push_back(merged);
+
+	if (mCredited.size() > kHotLoopMaxCredited)
+	{
+		mCredited.erase(mCredited.begin(),mCredited.begin() + (kHotLoopMaxCredited / 2));
+	}
+
+	return (end - start) - credited;
+}
+
+const HotLoopLabel *HotLoopDetector::GetLabel(const unsigned short address) const
+{
+	// The first label after the address
+	size_t low = 0,high = mLabels.size();
+	while (low < high)
+	{
+		const size_t middle = (low + high) / 2;
+		if (mLabels[middle].mAddress <= address)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if (!low)
+	{
+		return 0;
+	}
+	// The first of the labels at the nearest address
+	size_t found = low - 1;
+	while (found && (mLabels[found-1].mAddress == mLabels[found].mAddress))
+	{
+		found--;
+	}
+	if ((address - mLabels[found].mAddress) >= kHotLoopMaxLabelOffset)
+	{
+		return 0;
+	}
+	return &mLabels[found];
+}
+
+void HotLoopDetector::PrintRanking(const unsigned long long totalTicks,const int count) const
+{
+	std::vector<HotLoop> sorted(mLoops);
+	std::sort(sorted.begin(),sorted.end(),SortBySelfTicks);
+
+	printf("Hot loops by self ticks, of %llu ticks. The inclusive ticks also have the ticks of the loops inside them.\n",totalTicks);
+	size_t i;
+	for (i=0;(i<sorted.size()) && ((int)i<count);i++)
+	{
+		const HotLoop &loop = sorted[i];
+		printf("$%04x-$%04x self %11llu %5.2f%% inclusive %11llu %6.2f%% iterations %10llu entries %8llu ticks/iteration %8.2f",loop.mTarget,loop.mBranch,
+			loop.mSelfTicks,totalTicks ? 100.0 * (double) loop.mSelfTicks / (double) totalTicks : 0.0,
+			loop.mTicks,totalTicks ? 100.0 * (double) loop.mTicks / (double) totalTicks : 0.0,loop.mIterations,loop.mEntries,
+			(double) loop.mTicks / (double) loop.mIterations);
+		const HotLoopLabel *label = GetLabel(loop.mTarget);
+		if (label)
+		{
+			if (label->mAddress == loop.mTarget)
+			{
+				printf(" %s",label->mName);
+			}
+			else
+			{
+				printf(" %s+%d",label->mName,loop.mTarget - label->mAddress);
+			}
+		}
+		printf("\n");
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef _HOTLOOPDETECTOR_H_
+#define _HOTLOOPDETECTOR_H_
+
+#include <vector>
+
+class Simulator;
+
+// A loop from the target of a backward branch up to the branch
+struct HotLoop
+{
+	unsigned short mTarget;
+	unsigned short mBranch;
+	// The ticks of the iterations that were not in an iteration of another loop that ended first, and all the ticks of the iterations
+	unsigned long long mSelfTicks;
+	unsigned long long mTicks;
+	unsigned long long mIterations;
+	unsigned long long mEntries;
+	unsigned long long mLastTakenTick;
+};
+
+// Ticks from mStart up to mEnd that are already in the self ticks of a loop
+struct HotLoopInterval
+{
+	unsigned long long mStart;
+	unsigned long long mEnd;
+};
+
+struct HotLoopLabel
+{
+	unsigned short mAddress;
+	char mName[64];
+};
+
+// Detects the loops in the 6502 code as it runs from the taken backward relative branches and ranks them by their self ticks,
+// for finding the Kernal or BootROM.a code to patch or the opcodes to shorten in the microcode.
+// Each taken backward branch is one iteration and adds the ticks since the branch target last started to the inclusive ticks, which includes
+// any subroutines and interrupts during the iteration and any loops inside it. Each tick is only added to the self ticks of the first
+// iteration that ends after it, which is the innermost loop, so the self ticks of all the loops add up to no more than the total ticks.
+class HotLoopDetector
+{
+public:
+	HotLoopDetector();
+	virtual ~HotLoopDetector();
+
+	// Loads the labels from an ACME VICE label file (!svl, "al C:e181 .Name") or symbol list (!sl, "Name = $e181") for PrintRanking()
+	bool LoadLabels(const char *filename);
+
+	// Call before each Simulator::Tick() that starts an opcode
+	void Sample(const Simulator &simulator);
+
+	// Prints the count loops with the most ticks, the total ticks are used for the percentages
+	void PrintRanking(const unsigned long long totalTicks,const int count) const;
+
+protected:
+	// Adds the iteration from start to end to the credited ticks and returns the ticks of it that were not already credited
+	unsigned long long CreditTicks(const unsigned long long start,const unsigned long long end);
+
+	// The nearest label at or before the address, or null if there is none
+	const HotLoopLabel *GetLabel(const unsigned short address) const;
+
+	std::vector<HotLoop> mLoops;
+	// The index in mLoops of the loop for each branch address, or -1
+	std::vector<int> mLoopIndex;
+	// The total tick each address last started an opcode, or kHotLoopNever
+	std::vector<unsigned long long> mLastStart;
+	// The ticks already in the self ticks of a loop in order, adjacent intervals are merged
+	std::vector<HotLoopInterval> mCredited;
+	std::vector<HotLoopLabel> mLabels;
+
+	bool mHasPrevious;
+	unsigned short mPreviousPC;
+	unsigned char mPreviousOpcode;
+};
+
+#endif
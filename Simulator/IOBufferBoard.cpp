@@ -0,0 +1,79 @@
+#include <string.h>
+#include <assert.h>
+#include "IOBufferBoard.h"
+
+IOBufferBoard::IOBufferBoard()
+{
+	Reset();
+}
+
+IOBufferBoard::~IOBufferBoard()
+{
+}
+
+void IOBufferBoard::Reset(void)
+{
+	memset(mOperands,0,sizeof(mOperands));
+	memset(mResults,0,sizeof(mResults));
+	mCommand = 0;
+	mStatus = 0;
+}
+
+void IOBufferBoard::HostWriteOperand(const int index,const unsigned char value)
+{
+	assert((index >= 0) && (index < kIOBufferBoardNumOperands));
+	mOperands[index] = value;
+}
+
+void IOBufferBoard::HostWriteCommand(const unsigned char command)
+{
+	mCommand = command;
+	mStatus |= kIOBufferBoardBusy;
+}
+
+unsigned char IOBufferBoard::HostReadStatus(void) const
+{
+	return mStatus;
+}
+
+unsigned char IOBufferBoard::HostReadResult(const int index) const
+{
+	assert((index >= 0) && (index < kIOBufferBoardNumResults));
+	return mResults[index];
+}
+
+unsigned char IOBufferBoard::CPURead(const unsigned short address) const
+{
+	assert(IsMapped(address));
+	if (address < kIOBufferBoardCommand)
+	{
+		return mOperands[address - kIOBufferBoardOperands];
+	}
+	if (address == kIOBufferBoardCommand)
+	{
+		return mCommand;
+	}
+	if (address == kIOBufferBoardStatus)
+	{
+		return mStatus;
+	}
+	if ((address >= kIOBufferBoardResults) && (address < kIOBufferBoardDone))
+	{
+		return mResults[address - kIOBufferBoardResults];
+	}
+	// Unconnected, the data bus floats high
+	return 0xff;
+}
+
+void IOBufferBoard::CPUWrite(const unsigned short address,const unsigned char value)
+{
+	assert(IsMapped(address));
+	if ((address >= kIOBufferBoardResults) && (address < kIOBufferBoardDone))
+	{
+		mResults[address - kIOBufferBoardResults] = value;
+	}
+	else if (address == kIOBufferBoardDone)
+	{
+		mStatus = value & ~kIOBufferBoardBusy;
+	}
+}
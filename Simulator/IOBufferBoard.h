@@ -0,0 +1,56 @@
+#ifndef _IOBUFFERBOARD_H_
+#define _IOBUFFERBOARD_H_
+
+// The IO buffer board latches as seen by the TTL processor, see C64Boot/CoProcessor.a for the protocol.
+const unsigned short kIOBufferBoardBase = 0xde80;
+const unsigned short kIOBufferBoardOperands = kIOBufferBoardBase;
+const unsigned short kIOBufferBoardCommand = kIOBufferBoardBase + 0x08;
+const unsigned short kIOBufferBoardStatus = kIOBufferBoardBase + 0x09;
+const unsigned short kIOBufferBoardResults = kIOBufferBoardBase + 0x10;
+const unsigned short kIOBufferBoardDone = kIOBufferBoardBase + 0x18;
+const unsigned short kIOBufferBoardEnd = kIOBufferBoardBase + 0x19;
+
+const int kIOBufferBoardNumOperands = 8;
+const int kIOBufferBoardNumResults = 8;
+
+const unsigned char kIOBufferBoardBusy = 0x80;
+
+// A host side model of the IO buffer board latches that sit between the C64 cartridge port and the TTL processor.
+// The host, i.e. the C64, writes the operands and command then polls the status. The TTL processor side is
+// connected with Simulator::SetIOBufferBoard() and sees the latches in its memory map.
+class IOBufferBoard
+{
+public:
+	IOBufferBoard();
+	virtual ~IOBufferBoard();
+
+	void Reset(void);
+
+	// Host side
+	void HostWriteOperand(const int index,const unsigned char value);
+	// Writing the command latch sets the busy flag
+	void HostWriteCommand(const unsigned char command);
+	unsigned char HostReadStatus(void) const;
+	unsigned char HostReadResult(const int index) const;
+
+	bool IsBusy(void) const
+	{
+		return (mStatus & kIOBufferBoardBusy) != 0;
+	}
+
+	// TTL processor side, only addresses for which IsMapped() is true should be used.
+	static bool IsMapped(const unsigned short address)
+	{
+		return (address >= kIOBufferBoardBase) && (address < kIOBufferBoardEnd);
+	}
+	unsigned char CPURead(const unsigned short address) const;
+	void CPUWrite(const unsigned short address,const unsigned char value);
+
+protected:
+	unsigned char mOperands[kIOBufferBoardNumOperands];
+	unsigned char mCommand;
+	unsigned char mStatus;
+	unsigned char mResults[kIOBufferBoardNumResults];
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <string.h>
+#include "ROMAnalyzer.h"
+#include "Simulator.h"
+
+static const char *kDBSourceNames[16] =
+{
+	"Unused","R0 (A)","R1 (X)","R2 (Y)","R3 (SP lo)","R4 (SP hi)","R5","R6",
+	"ST","Zero","ADDRWL","ADDRWH","ALURes","ALUTempST","Memory","FF"
+};
+
+static const char *kALUOpNames[kROMAnalyzerNumALUOps] =
+{
+	"Dec","Inc","Add","Sub","Or","And","Xor","Lsl","Lsr","Rol","Ror","Cmp","Sec","Clc","Clv","Flags",
+	"X_SignExtend","X_ZToCarry","X_VToCarry","X_BIT","X_4","X_5","X_6","X_7","X_8","X_9","X_10","X_11","X_12","X_13","X_14","X_15"
+};
+
+static const char *kDecoderBitNames[kNumDecoders][8] =
+{
+	{ "PCInc","OpCodeLoad","PCToAddress","AddrLLoad","AddrHLoad","PCLoad","RAMWrite","CycleReset" },
+	{ "DBSource0","DBSource1","DBSource2","DBSource3","DoBranchLoad","CPUWantBus","CPUHasBus","BUSDDR" },
+	{ "ALUIn1Load","ALUIn2Load","ALUIn3Load","ALUOp0","ALUOp1","ALUOp2","ALUOp3","ALUResLoad" },
+	{ "DBToR0","DBToR1","DBToR2","DBToR3","DBToR4","DBToR5","DBToR6","DBToST" },
+	{ "IRQStateLE","IllegalOp","IRQLineRST","ConstToDB","SPInc","SPDec","MulToDB","ALUBank" }
+};
+
+static int GetDBSource(const unsigned char d2,const unsigned char d5)
+{
+	if (d5 & kD5ConstToDB)
+	{
+		return 16 + (d2 & 15);
+	}
+	if (d5 & kD5MulToDB)
+	{
+		return 32;
+	}
+	return d2 & 15;
+}
+
+static int CountBits(unsigned char value)
+{
+	int count = 0;
+	while (value)
+	{
+		count += value & 1;
+		value >>= 1;
+	}
+	return count;
+}
+
+ROMAnalyzer::ROMAnalyzer()
+{
+	memset(mEntries,0,sizeof(mEntries));
+	memset(mAnalyzed,0,sizeof(mAnalyzed));
+	memset(&mTotal,0,sizeof(mTotal));
+	mNumEntries = 0;
+	memset(mDBSourceDriven,0,sizeof(mDBSourceDriven));
+	memset(mDBSourceLoaded,0,sizeof(mDBSourceLoaded));
+	memset(mALUOpResLoad,0,sizeof(mALUOpResLoad));
+	memset(mALUOpDoBranchLoad,0,sizeof(mALUOpDoBranchLoad));
+	memset(mBitsSet,0,sizeof(mBitsSet));
+	memset(mBitsToggled,0,sizeof(mBitsToggled));
+}
+
+ROMAnalyzer::~ROMAnalyzer()
+{
+}
+
+void ROMAnalyzer::Analyze(const Simulator &simulator)
+{
+	int bank,opcode;
+	for (bank=0;bank<kROMAnalyzerNumBanks;bank++)
+	{
+		for (opcode=0;opcode<256;opcode++)
+		{
+			const int address = (bank << 14) | (opcode << 6);
+			if (simulator.GetDecoderROM(4,address) & kD5IllegalOp)
+			{
+				// Not analysed but the bits are still used
+				int decoder;
+				for (decoder=0;decoder<kNumDecoders;decoder++)
+				{
+					mBitsSet[decoder] |= simulator.GetDecoderROM(decoder,address);
+				}
+				continue;
+			}
+			if (simulator.GetCanonicalBank(bank,opcode) != bank)
+			{
+				continue;
+			}
+			AnalyzeEntry(simulator,bank,opcode);
+		}
+	}
+}
+
+void ROMAnalyzer::AnalyzeEntry(const Simulator &simulator,const int bank,const int opcode)
+{
+	ROMAnalyzerCounts &counts = mEntries[bank][opcode];
+	mAnalyzed[bank][opcode] = true;
+	mNumEntries++;
+
+	unsigned char previous[kNumDecoders];
+	bool previousNoLatch = false;
+	int previousSource = -1;
+	int tick;
+	for (tick=0;tick<64;tick++)
+	{
+		const int address = (bank << 14) | (opcode << 6) | tick;
+		unsigned char d[kNumDecoders];
+		int decoder;
+		for (decoder=0;decoder<kNumDecoders;decoder++)
+		{
+			d[decoder] = simulator.GetDecoderROM(decoder,address);
+			mBitsSet[decoder] |= d[decoder];
+			if (tick)
+			{
+				mBitsToggled[decoder] |= d[decoder] ^ previous[decoder];
+			}
+			previous[decoder] = d[decoder];
+		}
+
+		const int source = GetDBSource(d[1],d[4]);
+		const bool dbLoad = (d[0] & (kD1AddrLLoad | kD1AddrHLoad | kD1OpCodeLoad | kD1RAMWrite)) || (d[2] & (kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load)) || d[3];
+		const bool otherEnable = (d[0] & (kD1PCInc | kD1PCLoad | kD1CycleReset)) || (d[2] & kD3ALUResLoad) || (d[1] & kD2DoBranchLoad) ||
+			(d[4] & (kD5SPInc | kD5SPDec | kD5IRQStateLE | kD5IRQLineRST | kD5IllegalOp));
+		const bool noLatch = !dbLoad && !otherEnable;
+
+		counts.mTicks++;
+		if (!dbLoad)
+		{
+			counts.mDataBusIdle++;
+		}
+		if (noLatch)
+		{
+			counts.mNoLatch++;
+		}
+		if (dbLoad && previousNoLatch && (source == previousSource) && (source != kD2Unused))
+		{
+			counts.mPresent++;
+		}
+		if (d[1] & (kD2CPUWantBus | kD2CPUHasBus))
+		{
+			counts.mExternalBus++;
+		}
+
+		if (source != kD2Unused)
+		{
+			mDBSourceDriven[source]++;
+			if (dbLoad)
+			{
+				mDBSourceLoaded[source]++;
+			}
+		}
+
+		const int aluOp = ((d[4] & kD5ALUBank) ? 16 : 0) | ((d[2] >> 3) & 15);
+		if (d[2] & kD3ALUResLoad)
+		{
+			mALUOpResLoad[aluOp]++;
+		}
+		if (d[1] & kD2DoBranchLoad)
+		{
+			mALUOpDoBranchLoad[aluOp]++;
+		}
+
+		previousNoLatch = noLatch;
+		previousSource = source;
+
+		if (d[0] & kD1CycleReset)
+		{
+			break;
+		}
+	}
+
+	mTotal.mTicks += counts.mTicks;
+	mTotal.mDataBusIdle += counts.mDataBusIdle;
+	mTotal.mNoLatch += counts.mNoLatch;
+	mTotal.mPresent += counts.mPresent;
+	mTotal.mExternalBus += counts.mExternalBus;
+}
+
+void ROMAnalyzer::PrintCounts(const char *name,const ROMAnalyzerCounts &counts) const
+{
+	const double ticks = counts.mTicks ? (double) counts.mTicks : 1.0;
+	printf("%-12s %6d %6d %5.1f%% %6d %5.1f%% %6d %5.1f%% %6d %5.1f%%\n",name,counts.mTicks,
+		counts.mDataBusIdle,100.0 * (double) counts.mDataBusIdle / ticks,
+		counts.mNoLatch,100.0 * (double) counts.mNoLatch / ticks,
+		counts.mPresent,100.0 * (double) counts.mPresent / ticks,
+		counts.mExternalBus,100.0 * (double) counts.mExternalBus / ticks);
+}
+
+void ROMAnalyzer::PrintReport(void) const
+{
+	// The present column counts the latch ticks so the tick before each one is the no latch tick that presents the data
+	printf("Entry         ticks  DB idle        no latch       present        external bus\n");
+	char buffer[32];
+	int opcode,bank;
+	for (opcode=0;opcode<256;opcode++)
+	{
+		if (!mAnalyzed[0][opcode])
+		{
+			continue;
+		}
+		sprintf(buffer,"$%02x",opcode);
+		PrintCounts(buffer,mEntries[0][opcode]);
+	}
+	for (bank=0;bank<kROMAnalyzerNumBanks;bank++)
+	{
+		ROMAnalyzerCounts bankCounts;
+		memset(&bankCounts,0,sizeof(bankCounts));
+		int entries = 0;
+		for (opcode=0;opcode<256;opcode++)
+		{
+			if (!mAnalyzed[bank][opcode])
+			{
+				continue;
+			}
+			entries++;
+			bankCounts.mTicks += mEntries[bank][opcode].mTicks;
+			bankCounts.mDataBusIdle += mEntries[bank][opcode].mDataBusIdle;
+			bankCounts.mNoLatch += mEntries[bank][opcode].mNoLatch;
+			bankCounts.mPresent += mEntries[bank][opcode].mPresent;
+			bankCounts.mExternalBus += mEntries[bank][opcode].mExternalBus;
+		}
+		if (!entries)
+		{
+			continue;
+		}
+		sprintf(buffer,"Bank %d (%d)",bank,entries);
+		PrintCounts(buffer,bankCounts);
+	}
+	sprintf(buffer,"All (%d)",mNumEntries);
+	PrintCounts(buffer,mTotal);
+
+	printf("\nALU op         ResLoad DoBranchLoad\n");
+	int i;
+	for (i=0;i<kROMAnalyzerNumALUOps;i++)
+	{
+		if (mALUOpResLoad[i] || mALUOpDoBranchLoad[i])
+		{
+			printf("%-14s %7d %12d\n",kALUOpNames[i],mALUOpResLoad[i],mALUOpDoBranchLoad[i]);
+		}
+	}
+
+	printf("\nDB source      driven  loaded\n");
+	for (i=0;i<kROMAnalyzerNumDBSources;i++)
+	{
+		if (!mDBSourceDriven[i])
+		{
+			continue;
+		}
+		if (i < 16)
+		{
+			sprintf(buffer,"%s",kDBSourceNames[i]);
+		}
+		else if (i < 32)
+		{
+			sprintf(buffer,"Const %d",i - 16);
+		}
+		else
+		{
+			sprintf(buffer,"Mul");
+		}
+		printf("%-14s %6d %7d\n",buffer,mDBSourceDriven[i],mDBSourceLoaded[i]);
+	}
+
+	printf("\nDecoder  set  toggled  never set\n");
+	int decoder,totalToggled = 0;
+	for (decoder=0;decoder<kNumDecoders;decoder++)
+	{
+		totalToggled += CountBits(mBitsToggled[decoder]);
+		printf("%d       $%02x      $%02x ",decoder+1,mBitsSet[decoder],mBitsToggled[decoder]);
+		int bit;
+		for (bit=0;bit<8;bit++)
+		{
+			if (!(mBitsSet[decoder] & (1<<bit)))
+			{
+				printf(" %s",kDecoderBitNames[decoder][bit]);
+			}
+		}
+		printf("\n");
+	}
+	printf("%d of %d decoder bits toggle %.1f%%\n",totalToggled,kNumDecoders * 8,100.0 * (double) totalToggled / (double) (kNumDecoders * 8));
+}
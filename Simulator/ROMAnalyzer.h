@@ -0,0 +1,64 @@
+#ifndef _ROMANALYZER_H_
+#define _ROMANALYZER_H_
+
+#include "../Microcode/OpCode.h"
+
+class Simulator;
+
+// Decoder 2 sources 0-15, then the kD5ConstToDB constants 0-15, then kD5MulToDB
+const int kROMAnalyzerNumDBSources = 33;
+// kD3ALUOp_* then the kD5ALUBank kD3ALUOpX_* functions
+const int kROMAnalyzerNumALUOps = 32;
+// Simulator::GetBank(), do branch (1) | IRQ state (2) | NMI state (4) | continuation (8)
+const int kROMAnalyzerNumBanks = 16;
+
+struct ROMAnalyzerCounts
+{
+	int mTicks;
+	// Nothing loads from the data bus and there is no kD1RAMWrite
+	int mDataBusIdle;
+	// A data bus idle tick that also has no PC, ALU result, do branch, SP, IRQ state or cycle reset enables, i.e. a pure present or hold tick
+	int mNoLatch;
+	// A no latch tick directly followed by a tick that latches the same data bus source, the "present, then latch" pairs from ValidateStates()
+	int mPresent;
+	// kD2CPUWantBus or kD2CPUHasBus
+	int mExternalBus;
+};
+
+// Statically analyses the loaded decoder ROM images without executing them. Each bank and opcode is decoded up to its kD1CycleReset,
+// the opcodes that start with kD5IllegalOp and the entries that are identical to the same opcode in an earlier bank are skipped.
+// The report shows where the horizontal microcode spends ticks that do no work and which decoder bits are never used.
+class ROMAnalyzer
+{
+public:
+	ROMAnalyzer();
+	virtual ~ROMAnalyzer();
+
+	void Analyze(const Simulator &simulator);
+
+	// Prints the per opcode counts for the normal bank, the aggregate counts of all analysed entries,
+	// the ALU op and data bus source usage and the decoder bits that are set and that toggle.
+	void PrintReport(void) const;
+
+protected:
+	void AnalyzeEntry(const Simulator &simulator,const int bank,const int opcode);
+	void PrintCounts(const char *name,const ROMAnalyzerCounts &counts) const;
+
+	ROMAnalyzerCounts mEntries[kROMAnalyzerNumBanks][256];
+	bool mAnalyzed[kROMAnalyzerNumBanks][256];
+	ROMAnalyzerCounts mTotal;
+	int mNumEntries;
+
+	// Ticks that drive each source onto the data bus and ticks where the driven source is also loaded by something
+	int mDBSourceDriven[kROMAnalyzerNumDBSources];
+	int mDBSourceLoaded[kROMAnalyzerNumDBSources];
+	// Ticks that use the ALU op with kD3ALUResLoad or kD2DoBranchLoad
+	int mALUOpResLoad[kROMAnalyzerNumALUOps];
+	int mALUOpDoBranchLoad[kROMAnalyzerNumALUOps];
+
+	// The decoder output bits that are ever set and that ever change from one tick to the next in an opcode
+	unsigned char mBitsSet[kNumDecoders];
+	unsigned char mBitsToggled[kNumDecoders];
+};
+
+#endif
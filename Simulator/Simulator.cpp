@@ -0,0 +1,435 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "Simulator.h"
+#include "IOBufferBoard.h"
+
+// Memory mapped devices as used by KernalROM.a, BootROM.a and LCD.a
+const unsigned short kCIA1InterruptControl = 0xdc0d;
+const unsigned short kLCDStatus = 0xde04;
+const unsigned short kGLCDStatus = 0xde09;
+
+Simulator::Simulator() : mIRQPeriod(0) , mNMIPeriod(0) , mIOBufferBoard(0) , mTotalTicks(0)
+{
+	memset(mDecoderROM,0,sizeof(mDecoderROM));
+	memset(mALU1ROM,0,sizeof(mALU1ROM));
+	memset(mALU2ROM,0,sizeof(mALU2ROM));
+	memset(mConstantROM,0,sizeof(mConstantROM));
+	memset(mMulROM,0,sizeof(mMulROM));
+	memset(mMemory,0,sizeof(mMemory));
+	Reset();
+}
+
+Simulator::~Simulator()
+{
+}
+
+static bool LoadFile(const char *filename,unsigned char *dest,const size_t maxSize,size_t *loaded = 0)
+{
+	FILE *fp = fopen(filename,"rb");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",filename);
+		return false;
+	}
+	size_t got = fread(dest,1,maxSize,fp);
+	fclose(fp);
+	if (loaded)
+	{
+		*loaded = got;
+	}
+	return got > 0;
+}
+
+bool Simulator::LoadROMs(const char *path)
+{
+	char buffer[256];
+	int decoder;
+	for (decoder = 1;decoder <= kNumDecoders;decoder++)
+	{
+		sprintf(buffer,"%sDecoderROM%d.bin",path,decoder);
+		if (!LoadFile(buffer,mDecoderROM[decoder-1],kDecoderROMSize))
+		{
+			return false;
+		}
+	}
+	sprintf(buffer,"%sALU1.bin",path);
+	if (!LoadFile(buffer,mALU1ROM,kALUROMSize))
+	{
+		return false;
+	}
+	sprintf(buffer,"%sALU2.bin",path);
+	if (!LoadFile(buffer,mALU2ROM,kALUROMSize))
+	{
+		return false;
+	}
+	sprintf(buffer,"%sConstantROM.bin",path);
+	if (!LoadFile(buffer,mConstantROM,kConstantROMSize))
+	{
+		return false;
+	}
+	sprintf(buffer,"%sMulROM.bin",path);
+	if (!LoadFile(buffer,mMulROM,kMulROMSize))
+	{
+		return false;
+	}
+	return true;
+}
+
+bool Simulator::LoadMemory(const char *filename,const int address)
+{
+	return LoadFile(filename,mMemory + address,65536 - address);
+}
+
+bool Simulator::IsSameDecoderState(const int address1,const int address2) const
+{
+	int decoder;
+	for (decoder=0;decoder<kNumDecoders;decoder++)
+	{
+		if (mDecoderROM[decoder][address1] != mDecoderROM[decoder][address2])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int Simulator::GetCanonicalBank(const int bank,const int opcode) const
+{
+	int earlier;
+	for (earlier=0;earlier<bank;earlier++)
+	{
+		int tick;
+		for (tick=0;tick<64;tick++)
+		{
+			if (!IsSameDecoderState((bank << 14) | (opcode << 6) | tick,(earlier << 14) | (opcode << 6) | tick))
+			{
+				break;
+			}
+		}
+		if (tick == 64)
+		{
+			return earlier;
+		}
+	}
+	return bank;
+}
+
+int Simulator::GetEntryTicks(const int bank,const int opcode) const
+{
+	int tick;
+	for (tick=0;tick<64;tick++)
+	{
+		if (mDecoderROM[0][(bank << 14) | (opcode << 6) | tick] & kD1CycleReset)
+		{
+			return tick + 1;
+		}
+	}
+	return 64;
+}
+
+int Simulator::GetOpcodeTicks(const int bank,const int opcode) const
+{
+	int ticks = 0;
+	int entryBank = bank;
+	int entryOpcode = opcode;
+	// Limited in case the continuations in the ROMs loop
+	int continuations;
+	for (continuations=0;continuations<256;continuations++)
+	{
+		const int length = GetEntryTicks(entryBank,entryOpcode);
+		ticks += length;
+		bool continues = false;
+		int tick;
+		for (tick=0;tick<length;tick++)
+		{
+			const int address = (entryBank << 14) | (entryOpcode << 6) | tick;
+			if (mDecoderROM[0][address] & kD1OpCodeLoad)
+			{
+				continues = (mDecoderROM[4][address] & kD5ConstToDB) && ((mDecoderROM[1][address] & 15) == kD2ConstContinuationToDB);
+			}
+		}
+		if (!continues)
+		{
+			break;
+		}
+		// The continuation is in the continuation bank with the same do branch, IRQ state and NMI state
+		entryOpcode = mConstantROM[((entryBank & 8) ? (1 << 12) : 0) | (entryOpcode << 4) | kD2ConstContinuationToDB];
+		entryBank |= 8;
+	}
+	return ticks;
+}
+
+void Simulator::Reset(void)
+{
+	memset(mRegisters,0,sizeof(mRegisters));
+	mST = 0;
+	mALUIn1 = 0;
+	mALUIn2 = 0;
+	mALUIn3 = 0;
+	mALURes = 0;
+	mALUTempST = 0;
+	mAddrL = 0;
+	mAddrH = 0;
+	mPC = 0;
+	mOpcode = 0xff;
+	mTempOpcode = 0xff;
+	mTempContinuation = false;
+	mContinuation = false;
+	mTempIsContinuation = false;
+	mIsContinuation = false;
+	mTick = 0;
+	mDoBranch = false;
+	mIRQState = false;
+	mExtWantIRQ = false;
+	mNMIState = false;
+	mNMIEdge = false;
+	mHalted = false;
+	mLastDecoderROMAddress = 0;
+	mLastPC = 0;
+	mLastAddressBus = 0;
+	mLastDataBus = 0;
+	mLastALUResult = 0;
+	mLastALUResultST = 0;
+}
+
+unsigned char Simulator::CPURead(const unsigned short address)
+{
+	if (mIOBufferBoard && IOBufferBoard::IsMapped(address))
+	{
+		return mIOBufferBoard->CPURead(address);
+	}
+	switch(address)
+	{
+		case kCIA1InterruptControl:
+			// Reading acknowledges the IRQ the same as the C64
+			mExtWantIRQ = false;
+			return 0x81;
+		case kLCDStatus:
+			// Never busy
+			return 0;
+		case kGLCDStatus:
+			// Always ready
+			return 3;
+		default:
+			break;
+	}
+	return mMemory[address];
+}
+
+void Simulator::CPUWrite(const unsigned short address,const unsigned char value)
+{
+	if (mIOBufferBoard && IOBufferBoard::IsMapped(address))
+	{
+		mIOBufferBoard->CPUWrite(address,value);
+		return;
+	}
+	// ROM is located $a000-$bfff and $e000-$ffff
+	if ( ((address >= 0xa000) && (address < 0xc000)) || (address >= 0xe000) )
+	{
+		return;
+	}
+	mMemory[address] = value;
+}
+
+bool Simulator::Tick(void)
+{
+	if (mHalted)
+	{
+		return false;
+	}
+
+	if (mIRQPeriod && ((mTotalTicks % mIRQPeriod) == 0) && mTotalTicks)
+	{
+		mExtWantIRQ = true;
+	}
+	if (mNMIPeriod && ((mTotalTicks % mNMIPeriod) == 0) && mTotalTicks)
+	{
+		mNMIEdge = true;
+	}
+
+	const int romAddress = GetDecoderROMAddress();
+	const unsigned char d1 = mDecoderROM[0][romAddress];
+	const unsigned char d2 = mDecoderROM[1][romAddress];
+	const unsigned char d3 = mDecoderROM[2][romAddress];
+	const unsigned char d4 = mDecoderROM[3][romAddress];
+	const unsigned char d5 = mDecoderROM[4][romAddress];
+
+	mTotalTicks++;
+	mLastDecoderROMAddress = romAddress;
+	mLastPC = mPC;
+
+	// The ALU output is combinatorial from the input latches and the selected operation
+	unsigned char aluResult,aluResultST;
+	CalculateALU(mALU1ROM,mALU2ROM,d3,d5,mALUIn1,mALUIn2,mALUIn3,aluResult,aluResultST);
+	mLastALUResult = aluResult;
+	mLastALUResultST = aluResultST;
+	if (d3 & kD3ALUResLoad)
+	{
+		mALURes = aluResult;
+		mALUTempST = aluResultST;
+	}
+	if (d2 & kD2DoBranchLoad)
+	{
+		mDoBranch = (aluResultST & (1<<0)) ? true : false;
+	}
+
+	unsigned short address = (d1 & kD1PCToAddress) ? mPC : (unsigned short)((mAddrH << 8) | mAddrL);
+
+	// Work out what is on the data bus
+	unsigned char db = 0xff;
+	// The constant generator and the nybble multiply ROM disable the decoder 2 data bus source select
+	switch((d5 & kD5ConstToDB) ? -1 : ((d5 & kD5MulToDB) ? -2 : (d2 & 15)))
+	{
+		case kD2R0ToDB:
+		case kD2R1ToDB:
+		case kD2R2ToDB:
+		case kD2R3ToDB:
+		case kD2R4ToDB:
+		case kD2R5ToDB:
+		case kD2R6ToDB:
+			db = mRegisters[(d2 & 15) - kD2R0ToDB];
+			break;
+		case kD2STToDB:
+			db = mST;
+			break;
+		case kD2ZeroToDB:
+			db = 0;
+			break;
+		case kD2ADDRWLToDB:
+			db = (unsigned char) (address & 0xff);
+			break;
+		case kD2ADDRWHToDB:
+			db = (unsigned char) (address >> 8);
+			break;
+		case kD2ALUResToDB:
+			db = mALURes;
+			break;
+		case kD2ALUTempSTToDB:
+			db = mALUTempST;
+			break;
+		case kD2MemoryToDB:
+			db = CPURead(address);
+			break;
+		case -1:
+			db = mConstantROM[(mContinuation ? (1 << 12) : 0) | (mOpcode << 4) | (d2 & 15)];
+			break;
+		case -2:
+		{
+			const unsigned char in1 = (d2 & kD2MulIn1Hi) ? (mALUIn1 >> 4) : (mALUIn1 & 15);
+			const unsigned char in2 = (d2 & kD2MulIn2Hi) ? (mALUIn2 >> 4) : (mALUIn2 & 15);
+			db = mMulROM[(((d2 >> 2) & 3) << 8) | (in2 << 4) | in1];
+			break;
+		}
+		case kD2Unused:
+		case kD2FFToDB:
+		default:
+			db = 0xff;
+			break;
+	}
+
+	mLastAddressBus = address;
+	mLastDataBus = db;
+
+	if (d1 & kD1RAMWrite)
+	{
+		CPUWrite(address,db);
+	}
+
+	// Register loads are delayed by DCDR4DLY so they see the data bus for this tick
+	int i;
+	for (i=0;i<7;i++)
+	{
+		if (d4 & (1<<i))
+		{
+			mRegisters[i] = db;
+		}
+	}
+	if (d4 & kD4DBToST)
+	{
+		mST = db;
+	}
+
+	// R3 (SP lo) is an up/down counter that counts on the clock edge at the end of the tick
+	if (d5 & kD5SPInc)
+	{
+		mRegisters[3]++;
+	}
+	if (d5 & kD5SPDec)
+	{
+		mRegisters[3]--;
+	}
+
+	if (d3 & kD3ALUIn1Load)
+	{
+		mALUIn1 = db;
+	}
+	if (d3 & kD3ALUIn2Load)
+	{
+		mALUIn2 = db;
+	}
+	if (d3 & kD3ALUIn3Load)
+	{
+		mALUIn3 = db;
+	}
+
+	if (d1 & kD1AddrLLoad)
+	{
+		mAddrL = db;
+	}
+	if (d1 & kD1AddrHLoad)
+	{
+		mAddrH = db;
+	}
+	if (d1 & kD1OpCodeLoad)
+	{
+		mTempOpcode = db;
+		mTempContinuation = (d5 & kD5ConstToDB) ? true : false;
+		mTempIsContinuation = mTempContinuation && ((d2 & 15) == kD2ConstContinuationToDB);
+	}
+
+	if (d1 & kD1PCInc)
+	{
+		if (d1 & kD1PCLoad)
+		{
+			mPC = (unsigned short)((mAddrH << 8) | mAddrL);
+		}
+		else
+		{
+			mPC++;
+		}
+	}
+
+	if (d5 & kD5IRQStateLE)
+	{
+		// U4:C tests the I flag mirror with EXTWANTIRQ, the mirror is loaded with the ST so it is always the same as the ST I flag
+		mIRQState = mExtWantIRQ && !(mST & (1<<2));
+		// The NMI state ignores the I flag and clears the NMI edge latch when it is set
+		mNMIState = mNMIEdge;
+		mNMIEdge = false;
+	}
+	if (d5 & kD5IllegalOp)
+	{
+		mHalted = true;
+	}
+
+	if (d1 & kD1CycleReset)
+	{
+		mTick = 0;
+		mOpcode = mTempOpcode;
+		mContinuation = mTempContinuation;
+		mIsContinuation = mTempIsContinuation;
+	}
+	else
+	{
+		mTick++;
+		if (mTick >= 64)
+		{
+			printf("Tick overflow for opcode $%02x at $%04x\n",mOpcode,mPC);
+			mHalted = true;
+		}
+	}
+
+	return !mHalted;
+}
@@ -0,0 +1,239 @@
+#ifndef _SIMULATOR_H_
+#define _SIMULATOR_H_
+
+#include "../Microcode/OpCode.h"
+
+class IOBufferBoard;
+
+// The decoder ROMs are addressed with: tick (6 bits) | opcode (8 bits) | do branch (1 bit) | IRQ state (1 bit) | NMI state (1 bit) | continuation (1 bit)
+const int kDecoderROMSize = 262144;
+// The ALU ROMs are addressed with: op (4 bits) | in1 nybble (4 bits) | in2 nybble (4 bits) | input flags (4 bits) | kD5ALUBank (1 bit)
+const int kALUROMSize = 131072;
+// The constant generator ROM is addressed with: decoder 2 lower nybble (4 bits) | opcode (8 bits) | continuation (1 bit)
+const int kConstantROMSize = 8192;
+// The nybble multiply ROM is addressed with: in1 nybble (4 bits) | in2 nybble (4 bits) | kD2MulShl4/kD2MulShr4 (2 bits)
+const int kMulROMSize = 1024;
+
+// A host side model of the TTL CPU that executes the decoder and ALU ROM images tick by tick.
+// The model is behavioural, it follows the design rules documented in OpCode.h for when the latches load
+// rather than modelling individual gate delays, so it can run the ROM images much faster than the schematic simulation.
+class Simulator
+{
+public:
+	Simulator();
+	virtual ~Simulator();
+
+	// Loads DecoderROM1-5.bin, ALU1/2.bin, ConstantROM.bin and MulROM.bin from the path, which should include any trailing separator.
+	bool LoadROMs(const char *path);
+
+	// Loads a binary image into the memory at the address. Images at $a000-$bfff and $e000-$ffff are treated as ROM.
+	bool LoadMemory(const char *filename,const int address);
+
+	// Emulates the reset line being held low, opcode 0xff and tick 0 are set.
+	void Reset(void);
+
+	// Executes one tick of the microcode. Returns false if the CPU has halted due to kD5IllegalOp.
+	bool Tick(void);
+
+	// Pulls EXTWANTIRQ low every period ticks, zero disables. The IRQ is acknowledged by reading CIA1InterruptControl.
+	void SetIRQPeriod(const unsigned int period)
+	{
+		mIRQPeriod = period;
+	}
+
+	// Maps the IO buffer board latches into the memory, zero disconnects the board.
+	void SetIOBufferBoard(IOBufferBoard *board)
+	{
+		mIOBufferBoard = board;
+	}
+
+	// Pulls EXTWANTNMI low every period ticks, zero disables. The NMI edge latch is set by each falling edge.
+	void SetNMIPeriod(const unsigned int period)
+	{
+		mNMIPeriod = period;
+	}
+
+	bool IsHalted(void) const
+	{
+		return mHalted;
+	}
+
+	// True on the tick that starts a new opcode, i.e. tick 0.
+	bool IsOpcodeStart(void) const
+	{
+		return mTick == 0;
+	}
+
+	unsigned short GetPC(void) const
+	{
+		return mPC;
+	}
+
+	unsigned char GetOpcode(void) const
+	{
+		return mOpcode;
+	}
+
+	unsigned char GetMicroTick(void) const
+	{
+		return mTick;
+	}
+
+	// The decoder bank that is selected by the do branch, IRQ state, NMI state and continuation flip-flops
+	int GetBank(void) const
+	{
+		return (mContinuation ? 8 : 0) | (mNMIState ? 4 : 0) | (mIRQState ? 2 : 0) | (mDoBranch ? 1 : 0);
+	}
+
+	// True while the opcode continues the one before it, it was loaded with kD2ConstContinuationToDB.
+	// This is not a hardware signal, it is for the tools that count the ticks of the continuations with the opcode they continue.
+	bool IsContinuation(void) const
+	{
+		return mIsContinuation;
+	}
+
+	// The decoder ROM address for the tick that Tick() executes next
+	int GetDecoderROMAddress(void) const
+	{
+		return (GetBank() << 14) | (mOpcode << 6) | mTick;
+	}
+
+	// The decoder output for the tick that Tick() executes next, the decoder is 0 to kNumDecoders-1 for DecoderROM1-5
+	unsigned char GetDecoderOutput(const int decoder) const
+	{
+		return mDecoderROM[decoder][GetDecoderROMAddress()];
+	}
+
+	// The loaded decoder ROM byte at any address, for tools that analyse the ROM images without executing them
+	unsigned char GetDecoderROM(const int decoder,const int address) const
+	{
+		return mDecoderROM[decoder][address];
+	}
+
+	// True if all decoder outputs are the same at both decoder ROM addresses
+	bool IsSameDecoderState(const int address1,const int address2) const;
+
+	// The lowest bank that has exactly the same microcode for the opcode, the IRQ and do branch banks of most opcodes are the same as the normal bank
+	int GetCanonicalBank(const int bank,const int opcode) const;
+
+	// The ticks up to and including the kD1CycleReset of the opcode in the bank
+	int GetEntryTicks(const int bank,const int opcode) const;
+
+	// The ticks of the opcode in the bank and the continuation opcodes it loads with kD2ConstContinuationToDB
+	int GetOpcodeTicks(const int bank,const int opcode) const;
+
+	// The state of the tick that the last Tick() executed, for the trace recorder
+	int GetLastDecoderROMAddress(void) const
+	{
+		return mLastDecoderROMAddress;
+	}
+
+	unsigned short GetLastPC(void) const
+	{
+		return mLastPC;
+	}
+
+	unsigned short GetLastAddressBus(void) const
+	{
+		return mLastAddressBus;
+	}
+
+	unsigned char GetLastDataBus(void) const
+	{
+		return mLastDataBus;
+	}
+
+	// The combinatorial ALU result and status of the tick, whether or not kD3ALUResLoad latched them
+	unsigned char GetLastALUResult(void) const
+	{
+		return mLastALUResult;
+	}
+
+	unsigned char GetLastALUResultST(void) const
+	{
+		return mLastALUResultST;
+	}
+
+	// True while EXTWANTIRQ is pulled low
+	bool IsExtWantIRQ(void) const
+	{
+		return mExtWantIRQ;
+	}
+
+	unsigned long long GetTotalTicks(void) const
+	{
+		return mTotalTicks;
+	}
+
+	unsigned char ReadMemory(const unsigned short address) const
+	{
+		return mMemory[address];
+	}
+
+	// Writes the memory directly, including the ROM areas, for the self tests that build their code in memory
+	void WriteMemory(const unsigned short address,const unsigned char value)
+	{
+		mMemory[address] = value;
+	}
+
+	unsigned char GetRegister(const int index) const
+	{
+		return mRegisters[index];
+	}
+
+	unsigned char GetST(void) const
+	{
+		return mST;
+	}
+
+protected:
+	unsigned char CPURead(const unsigned short address);
+	void CPUWrite(const unsigned short address,const unsigned char value);
+
+	unsigned char mDecoderROM[kNumDecoders][kDecoderROMSize];
+	unsigned char mALU1ROM[kALUROMSize];
+	unsigned char mALU2ROM[kALUROMSize];
+	unsigned char mConstantROM[kConstantROMSize];
+	unsigned char mMulROM[kMulROMSize];
+	unsigned char mMemory[65536];
+
+	// R0-R6
+	unsigned char mRegisters[7];
+	unsigned char mST;
+	unsigned char mALUIn1;
+	unsigned char mALUIn2;
+	unsigned char mALUIn3;
+	unsigned char mALURes;
+	unsigned char mALUTempST;
+	unsigned char mAddrL;
+	unsigned char mAddrH;
+	unsigned short mPC;
+	unsigned char mOpcode;
+	unsigned char mTempOpcode;
+	// The continuation flip-flop, loaded with the opcode latches from kD5ConstToDB
+	bool mTempContinuation;
+	bool mContinuation;
+	bool mTempIsContinuation;
+	bool mIsContinuation;
+	unsigned char mTick;
+	bool mDoBranch;
+	bool mIRQState;
+	bool mExtWantIRQ;
+	bool mNMIState;
+	bool mNMIEdge;
+	bool mHalted;
+
+	int mLastDecoderROMAddress;
+	unsigned short mLastPC;
+	unsigned short mLastAddressBus;
+	unsigned char mLastDataBus;
+	unsigned char mLastALUResult;
+	unsigned char mLastALUResultST;
+
+	unsigned int mIRQPeriod;
+	unsigned int mNMIPeriod;
+	IOBufferBoard *mIOBufferBoard;
+	unsigned long long mTotalTicks;
+};
+
+#endif
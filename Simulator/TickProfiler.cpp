@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "TickProfiler.h"
+#include "Simulator.h"
+
+TickProfiler::TickProfiler()
+{
+	Reset();
+}
+
+TickProfiler::~TickProfiler()
+{
+}
+
+void TickProfiler::Reset(void)
+{
+	memset(mTicks,0,sizeof(mTicks));
+	memset(mExecutions,0,sizeof(mExecutions));
+	memset(mOpcodeTicks,0,sizeof(mOpcodeTicks));
+	memset(mBranchExecutions,0,sizeof(mBranchExecutions));
+	memset(mTakenExecutions,0,sizeof(mTakenExecutions));
+	mTotalTicks = 0;
+	mGotBranchLoad = false;
+	mGotTaken = false;
+	mExecuting = 0xff;
+}
+
+void TickProfiler::Sample(const Simulator &simulator)
+{
+	const int bank = simulator.GetBank();
+	const int opcode = simulator.GetOpcode();
+	const int tick = simulator.GetMicroTick();
+
+	mTicks[bank][opcode][tick]++;
+	mTotalTicks++;
+
+	if ((tick == 0) && !simulator.IsContinuation())
+	{
+		mExecuting = opcode;
+		mExecutions[opcode]++;
+		mGotBranchLoad = false;
+		mGotTaken = false;
+	}
+	else if (mGotBranchLoad && !mGotTaken && (bank & 1))
+	{
+		// The do branch latch loaded a taken branch on an earlier tick of this execution
+		mTakenExecutions[mExecuting]++;
+		mGotTaken = true;
+	}
+	mOpcodeTicks[mExecuting]++;
+
+	if ( !mGotBranchLoad && (simulator.GetDecoderOutput(1) & kD2DoBranchLoad) )
+	{
+		mBranchExecutions[mExecuting]++;
+		mGotBranchLoad = true;
+	}
+}
+
+unsigned long long TickProfiler::GetOpcodeTicks(const int opcode) const
+{
+	return mOpcodeTicks[opcode];
+}
+
+bool TickProfiler::WriteHeatMap(const char *prefix) const
+{
+	char buffer[256];
+	sprintf(buffer,"%sHeatMap.csv",prefix);
+	FILE *fp = fopen(buffer,"w");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",buffer);
+		return false;
+	}
+	// The tick 0 count is the number of executions that started in the bank
+	fprintf(fp,"bank,opcode,ticks");
+	int tick;
+	for (tick=0;tick<kTickProfilerNumTicks;tick++)
+	{
+		fprintf(fp,",t%d",tick);
+	}
+	fprintf(fp,"\n");
+
+	unsigned long long maxCount = 0;
+	int bank,opcode;
+	for (bank=0;bank<kTickProfilerNumBanks;bank++)
+	{
+		for (opcode=0;opcode<256;opcode++)
+		{
+			unsigned long long total = 0;
+			for (tick=0;tick<kTickProfilerNumTicks;tick++)
+			{
+				total += mTicks[bank][opcode][tick];
+				maxCount = std::max(maxCount,mTicks[bank][opcode][tick]);
+			}
+			if (!total)
+			{
+				continue;
+			}
+			fprintf(fp,"%d,$%02x,%llu",bank,opcode,total);
+			for (tick=0;tick<kTickProfilerNumTicks;tick++)
+			{
+				fprintf(fp,",%llu",mTicks[bank][opcode][tick]);
+			}
+			fprintf(fp,"\n");
+		}
+	}
+	fclose(fp);
+
+	sprintf(buffer,"%sHeatMap.pgm",prefix);
+	fp = fopen(buffer,"wb");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",buffer);
+		return false;
+	}
+	fprintf(fp,"P5\n%d %d\n255\n",kTickProfilerNumTicks,kTickProfilerNumBanks * 256);
+	const double scale = maxCount ? (255.0 / log(1.0 + (double) maxCount)) : 0.0;
+	for (bank=0;bank<kTickProfilerNumBanks;bank++)
+	{
+		for (opcode=0;opcode<256;opcode++)
+		{
+			for (tick=0;tick<kTickProfilerNumTicks;tick++)
+			{
+				fputc((unsigned char) (log(1.0 + (double) mTicks[bank][opcode][tick]) * scale),fp);
+			}
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+struct RankedOpcode
+{
+	int mOpcode;
+	unsigned long long mSaved;
+
+	bool operator<(const RankedOpcode &other) const
+	{
+		return mSaved > other.mSaved;
+	}
+};
+
+void TickProfiler::PrintRanking(const int ticksShorter,const int count) const
+{
+	std::vector<RankedOpcode> ranked;
+	int opcode;
+	for (opcode=0;opcode<256;opcode++)
+	{
+		if (!mExecutions[opcode])
+		{
+			continue;
+		}
+		RankedOpcode entry;
+		entry.mOpcode = opcode;
+		entry.mSaved = std::min(mExecutions[opcode] * ticksShorter,GetOpcodeTicks(opcode) - mExecutions[opcode]);
+		ranked.push_back(entry);
+	}
+	std::sort(ranked.begin(),ranked.end());
+
+	printf("Ticks saved if the opcode were %d ticks shorter, of %llu profiled ticks\n",ticksShorter,mTotalTicks);
+	size_t i;
+	for (i=0;(i<ranked.size()) && ((int)i<count);i++)
+	{
+		const int op = ranked[i].mOpcode;
+		const unsigned long long ticks = GetOpcodeTicks(op);
+		printf("$%02x executions %10llu ticks %11llu %5.2f%% average %5.2f saved %10llu %5.2f%%",op,mExecutions[op],ticks,
+			100.0 * (double) ticks / (double) mTotalTicks,(double) ticks / (double) mExecutions[op],
+			ranked[i].mSaved,100.0 * (double) ranked[i].mSaved / (double) mTotalTicks);
+		if (mBranchExecutions[op])
+		{
+			printf(" taken %llu of %llu",mTakenExecutions[op],mBranchExecutions[op]);
+		}
+		printf("\n");
+	}
+}
+
+// The NMOS 6502 cycles for each opcode without the page crossing or taken branch cycles, including the undocumented opcodes.
+// Zero is a HALT or a slot this design uses for something without a 6502 equivalent, the move and fill block opcodes and MUL.
+// $fc is the IRQ and NMI entry and $ff the boot, so they use the 7 cycle interrupt and reset sequences.
+static const int kNMOS6502Cycles[256] =
+{
+	7,6,0,8,3,3,5,5,3,2,2,2,4,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	6,6,0,8,3,3,5,5,4,2,2,2,4,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	6,6,0,8,3,3,5,5,3,2,2,2,3,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	6,6,0,8,3,3,5,5,4,2,2,2,5,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	2,6,2,6,3,3,3,3,2,2,2,0,4,4,4,4,
+	2,6,0,6,4,4,4,4,2,5,2,0,5,5,5,5,
+	2,6,2,6,3,3,3,3,2,2,2,0,4,4,4,4,
+	2,5,0,5,4,4,4,4,2,4,2,0,4,4,4,4,
+	2,6,2,8,3,3,5,5,2,2,2,0,4,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,4,4,7,7,
+	2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+	2,5,0,8,4,4,6,6,2,4,2,7,7,4,7,7
+};
+
+// The same for the 65C02 ROM set, the WDC 65C02 cycles for the opcodes it replaces (BRA, PHX, STZ, TSB, the (zp) modes and so on) and for
+// the shift and rotate abs,X and JMP (abs) that are a cycle shorter or longer. The NMOS undocumented opcodes it keeps use the NMOS cycles.
+static const int k65C02Cycles[256] =
+{
+	7,6,0,8,5,3,5,5,3,2,2,2,6,4,6,6,
+	2,5,5,8,5,4,6,6,2,4,2,7,6,4,6,7,
+	6,6,0,8,3,3,5,5,4,2,2,2,4,4,6,6,
+	2,5,5,8,4,4,6,6,2,4,2,7,4,4,6,7,
+	6,6,0,8,3,3,5,5,3,2,2,2,3,4,6,6,
+	2,5,5,8,4,4,6,6,2,4,3,7,4,4,6,7,
+	6,6,0,8,3,3,5,5,4,2,2,2,6,4,6,6,
+	2,5,5,8,4,4,6,6,2,4,4,7,6,4,6,7,
+	3,6,2,6,3,3,3,3,2,2,2,0,4,4,4,4,
+	2,6,5,6,4,4,4,4,2,5,2,0,4,5,5,5,
+	2,6,2,6,3,3,3,3,2,2,2,0,4,4,4,4,
+	2,5,5,5,4,4,4,4,2,4,2,0,4,4,4,4,
+	2,6,2,8,3,3,5,5,2,2,2,0,4,4,6,6,
+	2,5,5,8,4,4,6,6,2,4,3,7,4,4,7,7,
+	2,6,2,8,3,3,5,5,2,2,2,2,4,4,6,6,
+	2,5,5,8,4,4,6,6,2,4,4,7,7,4,7,7
+};
+
+// Roughly four ticks are one 6502 cycle, opcodes that take longer are marked in the comparison
+const int kTicksPer6502Cycle = 4;
+
+static const char *kBankNames[kTickProfilerNumBanks] =
+{
+	"normal","do branch","IRQ","IRQ do branch","NMI","NMI do branch","NMI IRQ","NMI IRQ do branch",
+	"continuation","continuation do branch","continuation IRQ","continuation IRQ do branch","continuation NMI","continuation NMI do branch",
+	"continuation NMI IRQ","continuation NMI IRQ do branch"
+};
+
+bool TickProfiler::IsTickCovered(const Simulator &simulator,const int bank,const int opcode,const int tick) const
+{
+	int other;
+	for (other=0;other<kTickProfilerNumBanks;other++)
+	{
+		// The continuation banks hold other programs in the same opcode slots, so they only cover each other
+		if ((bank ^ other) & 8)
+		{
+			continue;
+		}
+		if (mTicks[other][opcode][tick] && simulator.IsSameDecoderState((bank << 14) | (opcode << 6) | tick,(other << 14) | (opcode << 6) | tick))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int TickProfiler::PrintCoverage(const Simulator &simulator) const
+{
+	int totalEntries = 0,totalCovered = 0,totalTicks = 0,totalTicksCovered = 0;
+	int bank;
+	for (bank=0;bank<kTickProfilerNumBanks;bank++)
+	{
+		int entries = 0,covered = 0,ticks = 0,ticksCovered = 0;
+		std::vector<int> uncovered;
+		std::vector<int> partial;
+		int opcode;
+		for (opcode=0;opcode<256;opcode++)
+		{
+			const int address = (bank << 14) | (opcode << 6);
+			if ((simulator.GetDecoderROM(4,address) & kD5IllegalOp) || (simulator.GetCanonicalBank(bank,opcode) != bank))
+			{
+				continue;
+			}
+			const int length = simulator.GetEntryTicks(bank,opcode);
+			int entryCovered = 0;
+			int tick;
+			for (tick=0;tick<length;tick++)
+			{
+				if (IsTickCovered(simulator,bank,opcode,tick))
+				{
+					entryCovered++;
+				}
+			}
+			entries++;
+			ticks += length;
+			ticksCovered += entryCovered;
+			if (entryCovered == length)
+			{
+				covered++;
+			}
+			else if (entryCovered)
+			{
+				partial.push_back(opcode);
+			}
+			else
+			{
+				uncovered.push_back(opcode);
+			}
+		}
+		if (!entries)
+		{
+			continue;
+		}
+		totalEntries += entries;
+		totalCovered += covered;
+		totalTicks += ticks;
+		totalTicksCovered += ticksCovered;
+
+		printf("Bank %d %s entries %d covered %d partial %d uncovered %d, ticks %d of %d %.1f%%\n",bank,kBankNames[bank],entries,covered,
+			(int) partial.size(),(int) uncovered.size(),ticksCovered,ticks,100.0 * (double) ticksCovered / (double) ticks);
+		size_t i;
+		for (i=0;i<uncovered.size();i++)
+		{
+			printf("%s$%02x",(i % 16) ? " " : "  Uncovered ",uncovered[i]);
+			if (((i % 16) == 15) || (i == uncovered.size()-1))
+			{
+				printf("\n");
+			}
+		}
+		for (i=0;i<partial.size();i++)
+		{
+			const int op = partial[i];
+			const int length = simulator.GetEntryTicks(bank,op);
+			int tick;
+			printf("  Partial $%02x ticks not executed",op);
+			for (tick=0;tick<length;tick++)
+			{
+				if (!IsTickCovered(simulator,bank,op,tick))
+				{
+					printf(" %d",tick);
+				}
+			}
+			printf("\n");
+		}
+	}
+	printf("Coverage entries %d of %d %.1f%%, ticks %d of %d %.1f%%\n",totalCovered,totalEntries,100.0 * (double) totalCovered / (double) totalEntries,
+		totalTicksCovered,totalTicks,100.0 * (double) totalTicksCovered / (double) totalTicks);
+	return totalEntries - totalCovered;
+}
+
+double TickProfiler::PrintCycleComparison(const Simulator &simulator,const double clockMHz,const bool is65C02) const
+{
+	const int *cpuCycles = is65C02 ? k65C02Cycles : kNMOS6502Cycles;
+	printf("Opcode ticks doBranch cycles ticks/cycle 6502MHz   executions average ticks\n");
+	int opcode;
+	for (opcode=0;opcode<256;opcode++)
+	{
+		const int cycles = cpuCycles[opcode];
+		if (!cycles || (simulator.GetDecoderROM(4,opcode << 6) & kD5IllegalOp))
+		{
+			continue;
+		}
+		// The ticks include the continuations of an opcode that is split
+		int ticks = simulator.GetOpcodeTicks(0,opcode);
+		printf("$%02x    %5d",opcode,ticks);
+		const int doBranchTicks = simulator.GetOpcodeTicks(1,opcode);
+		if ((simulator.GetCanonicalBank(1,opcode) != 0) || (doBranchTicks != ticks))
+		{
+			// The bank switches at kD2DoBranchLoad so the do branch ticks count from the start of the opcode.
+			// The cycles are for a branch that is not taken, which is the shorter entry.
+			printf(" %8d",doBranchTicks);
+			ticks = std::min(ticks,doBranchTicks);
+		}
+		else
+		{
+			printf("         ");
+		}
+		const double ticksPerCycle = (double) ticks / (double) cycles;
+		printf(" %6d %10.2f%s %7.2f",cycles,ticksPerCycle,(ticksPerCycle > kTicksPer6502Cycle) ? "*" : " ",clockMHz / ticksPerCycle);
+		if (mExecutions[opcode])
+		{
+			printf(" %12llu %13.2f",mExecutions[opcode],(double) GetOpcodeTicks(opcode) / (double) mExecutions[opcode]);
+		}
+		printf("\n");
+	}
+
+	if (!mTotalTicks)
+	{
+		return 0.0;
+	}
+	// All sampled ticks count, including the continuation opcodes that finish an opcode and the ticks spent waiting in interrupt entries,
+	// but the page crossing cycles of the NMOS 6502 do not so the figure is slightly pessimistic
+	unsigned long long totalCycles = 0;
+	for (opcode=0;opcode<256;opcode++)
+	{
+		totalCycles += mExecutions[opcode] * cpuCycles[opcode];
+		if (cpuCycles[opcode] && mBranchExecutions[opcode])
+		{
+			// A taken branch is one cycle longer. Some branches set the do branch latch when they are not taken, the taken entry is the longer one.
+			if (simulator.GetOpcodeTicks(1,opcode) > simulator.GetOpcodeTicks(0,opcode))
+			{
+				totalCycles += mTakenExecutions[opcode];
+			}
+			else
+			{
+				totalCycles += mBranchExecutions[opcode] - mTakenExecutions[opcode];
+			}
+		}
+	}
+	const double effectiveMHz = clockMHz * (double) totalCycles / (double) mTotalTicks;
+	printf("Effective 6502 MHz %.3f at a %.1fMHz tick clock, %llu %s cycles in %llu ticks is %.2f ticks per cycle\n",effectiveMHz,clockMHz,
+		totalCycles,is65C02 ? "65C02" : "NMOS 6502",mTotalTicks,totalCycles ? (double) mTotalTicks / (double) totalCycles : 0.0);
+	return effectiveMHz;
+}
@@ -0,0 +1,79 @@
+#ifndef _TICKPROFILER_H_
+#define _TICKPROFILER_H_
+
+class Simulator;
+
+// The banks are Simulator::GetBank(), do branch (1) | IRQ state (2) | NMI state (4) | continuation (8)
+const int kTickProfilerNumBanks = 16;
+const int kTickProfilerNumTicks = 64;
+
+// Collects the dynamic counts per decoder bank, opcode and tick while the simulator runs real code, for example the Kernal or BootROM.a.
+// The heat map shows which microcode states actually use the time and the ranking shows where shortening an opcode pays off.
+class TickProfiler
+{
+public:
+	TickProfiler();
+	virtual ~TickProfiler();
+
+	void Reset(void);
+
+	// Call before each Simulator::Tick() to count the tick that is about to execute.
+	void Sample(const Simulator &simulator);
+
+	// Writes <prefix>HeatMap.csv with one row per bank and opcode that executed and one column per tick,
+	// and <prefix>HeatMap.pgm which is the same table as a log scaled greyscale image with 256 opcode rows per bank.
+	bool WriteHeatMap(const char *prefix) const;
+
+	// Prints the count opcodes that would save the most ticks if every execution were ticksShorter ticks shorter.
+	// Each execution keeps at least one tick. The opcodes that use kD2DoBranchLoad also show how often the branch was taken.
+	void PrintRanking(const int ticksShorter,const int count) const;
+
+	// Prints the microcode coverage of the loaded decoder ROMs for the ticks that were sampled. Only the entries that differ from the same opcode
+	// in an earlier bank are counted, see Simulator::GetCanonicalBank(). A tick is covered when the same decoder outputs for the opcode and tick
+	// executed in any bank with the same continuation bit, so the do branch entries that only differ after kD2DoBranchLoad are covered by the
+	// normal bank up to that tick.
+	// Returns the number of entries that have uncovered ticks.
+	int PrintCoverage(const Simulator &simulator) const;
+
+	// Prints the ticks of each opcode in the loaded decoder ROMs next to the 6502 cycles and the 6502 MHz equivalent at the tick clock,
+	// then the effective 6502 MHz of the sampled ticks, which is the 6502 cycles of the executed opcodes over the time they took.
+	// The cycles are the NMOS 6502 ones, or the 65C02 ones if is65C02 is set because the 65C02 ROM set is loaded.
+	// Returns the effective 6502 MHz, or zero if nothing was sampled.
+	double PrintCycleComparison(const Simulator &simulator,const double clockMHz,const bool is65C02) const;
+
+	unsigned long long GetTicks(const int bank,const int opcode,const int tick) const
+	{
+		return mTicks[bank][opcode][tick];
+	}
+
+	// The continuations count as part of the opcode they continue
+	unsigned long long GetExecutions(const int opcode) const
+	{
+		return mExecutions[opcode];
+	}
+
+	unsigned long long GetTotalTicks(void) const
+	{
+		return mTotalTicks;
+	}
+
+protected:
+	unsigned long long GetOpcodeTicks(const int opcode) const;
+	bool IsTickCovered(const Simulator &simulator,const int bank,const int opcode,const int tick) const;
+
+	unsigned long long mTicks[kTickProfilerNumBanks][256][kTickProfilerNumTicks];
+	unsigned long long mExecutions[256];
+	// The ticks of each opcode including its continuations
+	unsigned long long mOpcodeTicks[256];
+	// Executions that used kD2DoBranchLoad and those that then finished in a do branch bank
+	unsigned long long mBranchExecutions[256];
+	unsigned long long mTakenExecutions[256];
+	unsigned long long mTotalTicks;
+
+	bool mGotBranchLoad;
+	bool mGotTaken;
+	// The opcode that the current continuation continues
+	int mExecuting;
+};
+
+#endif
@@ -0,0 +1,492 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "TimingAnalyzer.h"
+#include "Simulator.h"
+
+struct TimingDelayEntry
+{
+	const char *mName;
+	const char *mPart;
+	double mNs;
+};
+
+// Typical propagation delays at 5V for the parts used by Processor8BitData16BitAddress.DSN, indexed by TimingDelay.
+// The ROM access times are the speed grade of the parts, which is the value the main.cpp clock notes use.
+// The ROM parts are the smallest that hold the images: 256K decoder images, 128K ALU images, 8K constant ROM and 1K mul ROM.
+static const TimingDelayEntry kTimingDelays[kNumTimingDelays] =
+{
+	{ "counter" ,			"74161" ,		20.0 },
+	{ "decoder ROM" ,		"27C2001-15" ,	150.0 },
+	{ "DCDRxLTCH" ,			"74HCT373" ,	18.0 },
+	{ "DCDR4DLY" ,			"74HCT374" ,	18.0 },
+	{ "register" ,			"74HCT374" ,	18.0 },
+	{ "setup" ,				"74HCT374" ,	12.0 },
+	{ "gate" ,				"7432" ,		14.0 },
+	{ "DB select" ,			"74154" ,		23.0 },
+	{ "DB enable" ,			"74HCT245" ,	25.0 },
+	{ "DB buffer" ,			"74HCT245" ,	13.0 },
+	{ "address enable" ,	"74HCT245" ,	25.0 },
+	{ "address buffer" ,	"74HCT245" ,	13.0 },
+	{ "memory" ,			"6264/2764-15" ,150.0 },
+	{ "ALU ROM" ,			"27C1001-15" ,	150.0 },
+	{ "constant ROM" ,		"27C64-15" ,	150.0 },
+	{ "mul select" ,		"74HC157" ,		15.0 },
+	{ "mul ROM" ,			"27C64-15" ,	150.0 }
+};
+
+// GetSlack() returns this when the check does not apply to the tick
+static const double kTimingNoPath = 1000000000.0;
+
+static const char *kTimingCheckNames[kNumTimingChecks] =
+{
+	"control","data bus","ALU","PC load"
+};
+
+static void AddStage(TimingPath &path,const TimingDelay delay)
+{
+	if (path.mNumStages < kTimingMaxStages)
+	{
+		path.mStages[path.mNumStages++] = delay;
+	}
+}
+
+static const TimingPath &GetLater(const TimingPath &a,const TimingPath &b)
+{
+	return (b.GetArrival() > a.GetArrival()) ? b : a;
+}
+
+double TimingPath::GetArrival(void) const
+{
+	double arrival = mStart;
+	int i;
+	for (i=0;i<mNumStages;i++)
+	{
+		arrival += kTimingDelays[mStages[i]].mNs;
+	}
+	return arrival;
+}
+
+TimingAnalyzer::TimingAnalyzer() : mNumStates(0)
+{
+	memset(mStates,0,sizeof(mStates));
+}
+
+TimingAnalyzer::~TimingAnalyzer()
+{
+}
+
+void TimingAnalyzer::Analyze(const Simulator &simulator)
+{
+	mResults.clear();
+	int bank,opcode;
+	for (bank=0;bank<kTimingAnalyzerNumBanks;bank++)
+	{
+		for (opcode=0;opcode<256;opcode++)
+		{
+			if (simulator.GetDecoderROM(4,(bank << 14) | (opcode << 6)) & kD5IllegalOp)
+			{
+				continue;
+			}
+			if (simulator.GetCanonicalBank(bank,opcode) != bank)
+			{
+				continue;
+			}
+			AnalyzeEntry(simulator,bank,opcode);
+		}
+	}
+}
+
+void TimingAnalyzer::AnalyzeEntry(const Simulator &simulator,const int bank,const int opcode)
+{
+	mNumStates = simulator.GetEntryTicks(bank,opcode);
+	int tick,decoder;
+	for (tick=0;tick<mNumStates;tick++)
+	{
+		for (decoder=0;decoder<kNumDecoders;decoder++)
+		{
+			mStates[tick][decoder] = simulator.GetDecoderROM(decoder,(bank << 14) | (opcode << 6) | tick);
+		}
+	}
+
+	for (tick=0;tick<mNumStates;tick++)
+	{
+		int check;
+		for (check=0;check<kNumTimingChecks;check++)
+		{
+			TimingPath path;
+			if (GetSlack(tick,(TimingCheck) check,1000.0,path) >= kTimingNoPath)
+			{
+				continue;
+			}
+			// The slack increases with the period since every path starts no later than NOTCLK of the tick
+			double low = 1.0,high = 10000.0;
+			while (high - low > 0.01)
+			{
+				const double period = (low + high) * 0.5;
+				if (GetSlack(tick,(TimingCheck) check,period,path) >= 0.0)
+				{
+					high = period;
+				}
+				else
+				{
+					low = period;
+				}
+			}
+			TimingResult result;
+			result.mBank = bank;
+			result.mOpcode = opcode;
+			result.mTick = tick;
+			result.mCheck = (TimingCheck) check;
+			result.mPeriod = high;
+			GetSlack(tick,(TimingCheck) check,high,result.mPath);
+			mResults.push_back(result);
+		}
+	}
+}
+
+// The decoder outputs for the tick reach the CPU when the DCDRxLTCH latches open at NOTCLK, or after the counter and the decoder ROM if that is later
+void TimingAnalyzer::GetDecoderPath(const int tick,const double period,TimingPath &path) const
+{
+	path.mStartTick = tick;
+	path.mNumStages = 0;
+	const double access = kTimingDelays[kDelayCounter].mNs + kTimingDelays[kDelayDecoderROM].mNs;
+	if (period * 0.5 >= access)
+	{
+		path.mStart = (tick * period) + (period * 0.5);
+		path.mStartName = "NOTCLK";
+	}
+	else
+	{
+		path.mStart = tick * period;
+		path.mStartName = "clock";
+		AddStage(path,kDelayCounter);
+		AddStage(path,kDelayDecoderROM);
+	}
+	AddStage(path,kDelayDecoderLatch);
+}
+
+// The clock edge at the end of the tick, -1 is the edge that starts the opcode
+void TimingAnalyzer::GetEdgePath(const int tick,const double period,TimingPath &path) const
+{
+	path.mStartTick = tick + 1;
+	path.mStart = (tick + 1) * period;
+	path.mStartName = "clock";
+	path.mNumStages = 0;
+}
+
+// The last tick before this tick that loads any of the mask bits, or -1 if the opcode does not load it
+int TimingAnalyzer::GetLastLoad(const int tick,const int decoder,const unsigned char mask) const
+{
+	int previous;
+	for (previous=tick-1;previous>=0;previous--)
+	{
+		if (mStates[previous][decoder] & mask)
+		{
+			return previous;
+		}
+	}
+	return -1;
+}
+
+// The address bus is stable after the kD1PCToAddress select and the selected PC or address latches
+void TimingAnalyzer::GetAddressPath(const int tick,const double period,TimingPath &path) const
+{
+	int start = tick;
+	while ( (start > 0) && ((mStates[start-1][0] & kD1PCToAddress) == (mStates[tick][0] & kD1PCToAddress)) )
+	{
+		start--;
+	}
+	TimingPath select;
+	GetDecoderPath(start,period,select);
+	AddStage(select,kDelayAddressEnable);
+
+	TimingPath source;
+	if (mStates[tick][0] & kD1PCToAddress)
+	{
+		GetEdgePath(GetLastLoad(tick,0,kD1PCInc),period,source);
+		AddStage(source,kDelayCounter);
+	}
+	else
+	{
+		GetEdgePath(GetLastLoad(tick,0,kD1AddrLLoad | kD1AddrHLoad),period,source);
+		AddStage(source,kDelayRegister);
+	}
+	AddStage(source,kDelayAddressBuffer);
+	path = GetLater(select,source);
+}
+
+// Returns false if the tick does not drive the data bus
+bool TimingAnalyzer::GetDataBusPath(const int tick,const double period,TimingPath &path) const
+{
+	const unsigned char d2 = mStates[tick][1];
+	const unsigned char d5 = mStates[tick][4];
+	const unsigned char sourceMask = kD5ConstToDB | kD5MulToDB;
+	if ( !(d5 & sourceMask) && ((d2 & 15) == kD2Unused) )
+	{
+		return false;
+	}
+
+	// A source presented on earlier ticks is already selected
+	int start = tick;
+	while ( (start > 0) && ((mStates[start-1][1] & 15) == (d2 & 15)) && ((mStates[start-1][4] & sourceMask) == (d5 & sourceMask)) )
+	{
+		start--;
+	}
+	TimingPath select;
+	GetDecoderPath(start,period,select);
+
+	TimingPath source;
+	GetEdgePath(-1,period,source);
+	if (d5 & kD5ConstToDB)
+	{
+		AddStage(select,kDelayConstantROM);
+		// The constant generator is also addressed by the opcode latch
+		AddStage(source,kDelayRegister);
+		AddStage(source,kDelayConstantROM);
+	}
+	else if (d5 & kD5MulToDB)
+	{
+		AddStage(select,kDelayMulSelect);
+		AddStage(select,kDelayMulROM);
+		GetEdgePath(GetLastLoad(tick,2,kD3ALUIn1Load | kD3ALUIn2Load),period,source);
+		AddStage(source,kDelayRegister);
+		AddStage(source,kDelayMulSelect);
+		AddStage(source,kDelayMulROM);
+	}
+	else
+	{
+		AddStage(select,kDelayDBSelect);
+		switch(d2 & 15)
+		{
+			case kD2R0ToDB:
+			case kD2R1ToDB:
+			case kD2R2ToDB:
+			case kD2R4ToDB:
+			case kD2R5ToDB:
+			case kD2R6ToDB:
+				GetEdgePath(GetLastLoad(tick,3,1 << ((d2 & 15) - kD2R0ToDB)),period,source);
+				AddStage(source,kDelayRegister);
+				break;
+			case kD2R3ToDB:
+			{
+				// R3 is also an up/down counter
+				GetEdgePath(GetLastLoad(tick,3,kD4DBToR3),period,source);
+				AddStage(source,kDelayRegister);
+				TimingPath count;
+				GetEdgePath(GetLastLoad(tick,4,kD5SPInc | kD5SPDec),period,count);
+				AddStage(count,kDelayCounter);
+				source = GetLater(source,count);
+				break;
+			}
+			case kD2STToDB:
+				GetEdgePath(GetLastLoad(tick,3,kD4DBToST),period,source);
+				AddStage(source,kDelayRegister);
+				break;
+			case kD2ADDRWLToDB:
+			case kD2ADDRWHToDB:
+				GetAddressPath(tick,period,source);
+				break;
+			case kD2ALUResToDB:
+			case kD2ALUTempSTToDB:
+				GetEdgePath(GetLastLoad(tick,2,kD3ALUResLoad),period,source);
+				AddStage(source,kDelayRegister);
+				break;
+			case kD2MemoryToDB:
+				GetAddressPath(tick,period,source);
+				AddStage(source,kDelayMemory);
+				break;
+			default:
+				break;
+		}
+	}
+	AddStage(select,kDelayDBEnable);
+	AddStage(source,kDelayDBBuffer);
+	path = GetLater(select,source);
+	return true;
+}
+
+double TimingAnalyzer::GetSlack(const int tick,const TimingCheck check,const double period,TimingPath &path) const
+{
+	const unsigned char *d = mStates[tick];
+	const double deadline = ((tick + 1) * period) - kTimingDelays[kDelaySetup].mNs;
+
+	switch(check)
+	{
+		case kTimingCheckControl:
+		{
+			// The strobe for each decoder output changes when the decoder output changes
+			const unsigned char strobes[kNumDecoders] =
+			{
+				kD1PCInc | kD1OpCodeLoad | kD1AddrLLoad | kD1AddrHLoad | kD1PCLoad | kD1RAMWrite | kD1CycleReset,
+				kD2DoBranchLoad,
+				kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load | kD3ALUResLoad,
+				0xff,
+				kD5IRQStateLE | kD5SPInc | kD5SPDec
+			};
+			bool got = false;
+			int decoder;
+			for (decoder=0;decoder<kNumDecoders;decoder++)
+			{
+				if (!(d[decoder] & strobes[decoder]))
+				{
+					continue;
+				}
+				int start = tick;
+				while ( (start > 0) && (mStates[start-1][decoder] == d[decoder]) )
+				{
+					start--;
+				}
+				TimingPath strobe;
+				GetDecoderPath(start,period,strobe);
+				if (decoder == 3)
+				{
+					AddStage(strobe,kDelayDecoder4Delay);
+				}
+				AddStage(strobe,kDelayGate);
+				path = got ? GetLater(path,strobe) : strobe;
+				got = true;
+			}
+			if (!got)
+			{
+				return kTimingNoPath;
+			}
+			break;
+		}
+
+		case kTimingCheckDataBus:
+			if ( !(d[0] & (kD1AddrLLoad | kD1AddrHLoad | kD1OpCodeLoad | kD1RAMWrite)) && !(d[2] & (kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load)) && !d[3] )
+			{
+				return kTimingNoPath;
+			}
+			if (!GetDataBusPath(tick,period,path))
+			{
+				return kTimingNoPath;
+			}
+			break;
+
+		case kTimingCheckALU:
+		{
+			if ( !(d[2] & kD3ALUResLoad) && !(d[1] & kD2DoBranchLoad) )
+			{
+				return kTimingNoPath;
+			}
+			const unsigned char opMask = 15 << 3;
+			int start = tick;
+			while ( (start > 0) && ((mStates[start-1][2] & opMask) == (d[2] & opMask)) && ((mStates[start-1][4] & kD5ALUBank) == (d[4] & kD5ALUBank)) )
+			{
+				start--;
+			}
+			TimingPath op;
+			GetDecoderPath(start,period,op);
+			AddStage(op,kDelayALUROM);
+			AddStage(op,kDelayALUROM);
+			TimingPath inputs;
+			GetEdgePath(GetLastLoad(tick,2,kD3ALUIn1Load | kD3ALUIn2Load | kD3ALUIn3Load),period,inputs);
+			AddStage(inputs,kDelayRegister);
+			AddStage(inputs,kDelayALUROM);
+			AddStage(inputs,kDelayALUROM);
+			path = GetLater(op,inputs);
+			break;
+		}
+
+		case kTimingCheckPCLoad:
+			if ( (d[0] & (kD1PCLoad | kD1PCInc)) != (kD1PCLoad | kD1PCInc) )
+			{
+				return kTimingNoPath;
+			}
+			GetEdgePath(GetLastLoad(tick,0,kD1AddrLLoad | kD1AddrHLoad),period,path);
+			AddStage(path,kDelayRegister);
+			break;
+
+		default:
+			return kTimingNoPath;
+	}
+
+	return deadline - path.GetArrival();
+}
+
+void TimingAnalyzer::PrintPath(const TimingResult &result) const
+{
+	printf("Bank %d $%02x tick %2d %-8s %6.1fns %5.2fMHz : tick %d %s %.1f",result.mBank,result.mOpcode,result.mTick,kTimingCheckNames[result.mCheck],
+		result.mPeriod,1000.0 / result.mPeriod,result.mPath.mStartTick,result.mPath.mStartName,result.mPath.mStart);
+	int i;
+	for (i=0;i<result.mPath.mNumStages;i++)
+	{
+		printf(" + %s %.0f",kTimingDelays[result.mPath.mStages[i]].mName,kTimingDelays[result.mPath.mStages[i]].mNs);
+	}
+	printf(" + setup %.0f = tick %d clock %.1f\n",kTimingDelays[kDelaySetup].mNs,result.mTick + 1,(result.mTick + 1) * result.mPeriod);
+}
+
+static bool SortBySlowest(const TimingResult &a,const TimingResult &b)
+{
+	return a.mPeriod > b.mPeriod;
+}
+
+int TimingAnalyzer::PrintReport(const double targetMHz,const int count) const
+{
+	printf("Delay           Part            ns\n");
+	int i;
+	for (i=0;i<kNumTimingDelays;i++)
+	{
+		printf("%-15s %-12s %5.1f\n",kTimingDelays[i].mName,kTimingDelays[i].mPart,kTimingDelays[i].mNs);
+	}
+	if (mResults.empty())
+	{
+		return 0;
+	}
+
+	std::vector<TimingResult> sorted = mResults;
+	std::sort(sorted.begin(),sorted.end(),SortBySlowest);
+	printf("\nMaximum safe clock %.2fMHz, period %.1fns, from %d checked paths\n",1000.0 / sorted[0].mPeriod,sorted[0].mPeriod,(int) sorted.size());
+	for (i=0;(i<(int)sorted.size()) && (i<count);i++)
+	{
+		PrintPath(sorted[i]);
+	}
+
+	const double targetPeriod = 1000.0 / targetMHz;
+	int failed = 0;
+	bool opcodes[kTimingAnalyzerNumBanks][256];
+	memset(opcodes,0,sizeof(opcodes));
+	int checks[kNumTimingChecks];
+	memset(checks,0,sizeof(checks));
+	for (i=0;i<(int)sorted.size();i++)
+	{
+		if (sorted[i].mPeriod > targetPeriod)
+		{
+			failed++;
+			opcodes[sorted[i].mBank][sorted[i].mOpcode] = true;
+			checks[sorted[i].mCheck]++;
+		}
+	}
+	printf("\n%d paths fail %.2fMHz, period %.1fns :",failed,targetMHz,targetPeriod);
+	for (i=0;i<kNumTimingChecks;i++)
+	{
+		printf(" %s %d",kTimingCheckNames[i],checks[i]);
+	}
+	printf("\n");
+	int bank;
+	for (bank=0;bank<kTimingAnalyzerNumBanks;bank++)
+	{
+		int printed = 0;
+		int opcode;
+		for (opcode=0;opcode<256;opcode++)
+		{
+			if (!opcodes[bank][opcode])
+			{
+				continue;
+			}
+			if (!(printed % 16))
+			{
+				printf(printed ? "\n          " : "  Bank %d :",bank);
+			}
+			printf(" $%02x",opcode);
+			printed++;
+		}
+		if (printed)
+		{
+			printf("\n");
+		}
+	}
+	return failed;
+}
@@ -0,0 +1,105 @@
+#ifndef _TIMINGANALYZER_H_
+#define _TIMINGANALYZER_H_
+
+#include <vector>
+#include "../Microcode/OpCode.h"
+
+class Simulator;
+
+// The propagation delays used by the paths, see kTimingDelays in TimingAnalyzer.cpp for the parts and values
+enum TimingDelay
+{
+	kDelayCounter = 0,		// 74161 tick counter and PC, clock to output
+	kDelayDecoderROM,		// Decoder ROM access
+	kDelayDecoderLatch,		// DCDRxLTCH 74HCT373, data or latch enable to output
+	kDelayDecoder4Delay,	// DCDR4DLY 74HCT374 on the decoder 4 register load strobes
+	kDelayRegister,			// 74HCT374 registers, clock to output
+	kDelaySetup,			// 74HCT374 setup before the clock
+	kDelayGate,				// Strobe gating with the clock
+	kDelayDBSelect,			// 74154 decoder 2 data bus source select
+	kDelayDBEnable,			// 74HCT245 output enable to output
+	kDelayDBBuffer,			// 74HCT245 input to output
+	kDelayAddressEnable,	// 74HCT245 address bus buffer output enable to output for kD1PCToAddress
+	kDelayAddressBuffer,	// 74HCT245 address bus buffer input to output
+	kDelayMemory,			// External RAM or ROM access
+	kDelayALUROM,			// One ALU ROM access, ALU2 waits for the carry and special flag from ALU1
+	kDelayConstantROM,		// Constant generator ROM access
+	kDelayMulSelect,		// Nybble multiply 74HC157 select
+	kDelayMulROM,			// Nybble multiply ROM access
+
+	kNumTimingDelays
+};
+
+enum TimingCheck
+{
+	kTimingCheckControl = 0,	// A load strobe from the decoder latches reaches the clock gating
+	kTimingCheckDataBus,		// The data bus source reaches a latch loaded from the data bus or the memory for kD1RAMWrite
+	kTimingCheckALU,			// The ALU result reaches the result latches for kD3ALUResLoad or the do branch latch for kD2DoBranchLoad
+	kTimingCheckPCLoad,			// The address latches reach the PC for kD1PCLoad
+
+	kNumTimingChecks
+};
+
+const int kTimingMaxStages = 8;
+// Simulator::GetBank(), do branch (1) | IRQ state (2) | NMI state (4) | continuation (8)
+const int kTimingAnalyzerNumBanks = 16;
+
+// The critical path to one check, the start is the clock edge or NOTCLK that launches it, followed by the delays of each stage
+struct TimingPath
+{
+	double mStart;
+	const char *mStartName;
+	int mStartTick;
+	int mStages[kTimingMaxStages];
+	int mNumStages;
+
+	double GetArrival(void) const;
+};
+
+struct TimingResult
+{
+	int mBank;
+	int mOpcode;
+	int mTick;
+	TimingCheck mCheck;
+	// The shortest clock period in ns that meets the check
+	double mPeriod;
+	TimingPath mPath;
+};
+
+// Statically analyses the loaded decoder ROM images for the longest path in each tick. Each tick starts on the clock rising edge and
+// the decoder outputs reach the CPU when the DCDRxLTCH latches open at the NOTCLK half cycle, or later if the decoder ROM is slower.
+// The latches load on the clock edge at the end of the tick, so a path that starts on an earlier tick, for example a data bus
+// source presented one tick before it is latched or ALU inputs that are stable for several ticks, gets several clock periods.
+// Each check is solved for the shortest clock period that meets it, the longest of these is the maximum safe clock for the ROM set.
+class TimingAnalyzer
+{
+public:
+	TimingAnalyzer();
+	virtual ~TimingAnalyzer();
+
+	void Analyze(const Simulator &simulator);
+
+	// Prints the delay table, the maximum safe clock, the count slowest ticks with their critical paths and the opcodes that fail the target clock.
+	// Returns the number of ticks that fail the target clock.
+	int PrintReport(const double targetMHz,const int count) const;
+
+protected:
+	void AnalyzeEntry(const Simulator &simulator,const int bank,const int opcode);
+	// Returns the slack in ns of the check at the tick for the clock period, and the critical path
+	double GetSlack(const int tick,const TimingCheck check,const double period,TimingPath &path) const;
+	void GetDecoderPath(const int tick,const double period,TimingPath &path) const;
+	void GetEdgePath(const int tick,const double period,TimingPath &path) const;
+	void GetAddressPath(const int tick,const double period,TimingPath &path) const;
+	bool GetDataBusPath(const int tick,const double period,TimingPath &path) const;
+	int GetLastLoad(const int tick,const int decoder,const unsigned char mask) const;
+	void PrintPath(const TimingResult &result) const;
+
+	// The states of the entry being analysed
+	unsigned char mStates[64][kNumDecoders];
+	int mNumStates;
+
+	std::vector<TimingResult> mResults;
+};
+
+#endif
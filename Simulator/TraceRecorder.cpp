@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <string.h>
+#include "TraceRecorder.h"
+
+static const char kTraceMagic[8] = { 'T','T','L','T','R','A','C','E' };
+static const char kTraceIndexMagic[8] = { 'T','T','L','I','N','D','E','X' };
+static const unsigned int kTraceVersion = 1;
+// The most bytes one delta encoded record can use
+static const size_t kTraceMaxRecordSize = 32;
+
+// The mask byte at the start of each record, the fields follow in this order
+const unsigned char kTraceTicks = (1<<0);			// Varint ticks since the previous record, otherwise 1
+const unsigned char kTraceROMAddress = (1<<1);		// 3 byte decoder ROM address, otherwise the previous address plus 1 which is the next tick of the opcode
+const unsigned char kTraceDecoders = (1<<2);		// The decoder outputs, otherwise the same as the last record in the block with the same decoder ROM address
+const unsigned char kTracePCInc = (1<<3);			// The previous PC plus 1
+const unsigned char kTracePC = (1<<4);				// 2 byte PC, otherwise the previous PC
+const unsigned char kTraceAddressPC = (1<<5);		// The address bus is the PC
+const unsigned char kTraceAddress = (1<<6);			// 2 byte address bus, otherwise the previous address bus
+const unsigned char kTraceData = (1<<7);			// 1 byte data bus, otherwise the previous data bus
+
+// LZ77 with a hash of the next 8 bytes to find matches in the last 64K of the block.
+// Each sequence is a varint literal count, the literals, a 2 byte match offset and a varint match length minus kLZMinMatch.
+// A zero offset ends the block.
+static const int kLZHashBits = 14;
+static const size_t kLZMinMatch = 8;
+
+static unsigned char *WriteVarint(unsigned char *dest,size_t value)
+{
+	while (value >= 0x80)
+	{
+		*dest++ = (unsigned char) (value | 0x80);
+		value >>= 7;
+	}
+	*dest++ = (unsigned char) value;
+	return dest;
+}
+
+static const unsigned char *ReadVarint(const unsigned char *src,const unsigned char *end,size_t &value)
+{
+	value = 0;
+	int shift = 0;
+	while (src < end)
+	{
+		const unsigned char got = *src++;
+		value |= (size_t) (got & 0x7f) << shift;
+		if (!(got & 0x80))
+		{
+			return src;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+static unsigned long long Read64(const unsigned char *src)
+{
+	unsigned long long value;
+	memcpy(&value,src,sizeof(value));
+	return value;
+}
+
+// The dest must have room for size plus 16 bytes for the worst case, the hash must have 1 << kLZHashBits entries
+static size_t CompressLZ(const unsigned char *src,const size_t size,unsigned char *dest,int *hash)
+{
+	memset(hash,0xff,sizeof(int) << kLZHashBits);
+	unsigned char *out = dest;
+	size_t anchor = 0;
+	size_t pos = 0;
+	// Like LZ4 the search steps further the longer it goes without a match, so data that does not compress is passed over quickly
+	size_t misses = 0;
+	while (pos + kLZMinMatch <= size)
+	{
+		const unsigned long long value = Read64(src + pos);
+		const unsigned int slot = (unsigned int) ((value * 0x9e3779b185ebca87ULL) >> (64 - kLZHashBits));
+		const int candidate = hash[slot];
+		hash[slot] = (int) pos;
+		if ( (candidate < 0) || ((pos - candidate) > 0xffff) || (Read64(src + candidate) != value) )
+		{
+			pos += 1 + (misses++ >> 5);
+			continue;
+		}
+		misses = 0;
+		size_t length = kLZMinMatch;
+		while ( (pos + length + 8 <= size) && (Read64(src + candidate + length) == Read64(src + pos + length)) )
+		{
+			length += 8;
+		}
+		while ( (pos + length < size) && (src[candidate + length] == src[pos + length]) )
+		{
+			length++;
+		}
+		out = WriteVarint(out,pos - anchor);
+		memcpy(out,src + anchor,pos - anchor);
+		out += pos - anchor;
+		const size_t offset = pos - candidate;
+		*out++ = (unsigned char) offset;
+		*out++ = (unsigned char) (offset >> 8);
+		out = WriteVarint(out,length - kLZMinMatch);
+		pos += length;
+		anchor = pos;
+	}
+	out = WriteVarint(out,size - anchor);
+	memcpy(out,src + anchor,size - anchor);
+	out += size - anchor;
+	*out++ = 0;
+	*out++ = 0;
+	return out - dest;
+}
+
+static bool DecompressLZ(const unsigned char *src,const size_t size,unsigned char *dest,const size_t destSize)
+{
+	const unsigned char *end = src + size;
+	size_t pos = 0;
+	while (src)
+	{
+		size_t literals;
+		src = ReadVarint(src,end,literals);
+		if (!src || (src + literals + 2 > end) || (pos + literals > destSize))
+		{
+			return false;
+		}
+		memcpy(dest + pos,src,literals);
+		src += literals;
+		pos += literals;
+		const size_t offset = src[0] | (src[1] << 8);
+		src += 2;
+		if (!offset)
+		{
+			return pos == destSize;
+		}
+		size_t length;
+		src = ReadVarint(src,end,length);
+		length += kLZMinMatch;
+		if (!src || (offset > pos) || (pos + length > destSize))
+		{
+			return false;
+		}
+		// The match can overlap the bytes it writes
+		size_t i;
+		for (i=0;i<length;i++,pos++)
+		{
+			dest[pos] = dest[pos - offset];
+		}
+	}
+	return false;
+}
+
+static void Write32(FILE *fp,const unsigned int value)
+{
+	fwrite(&value,sizeof(value),1,fp);
+}
+
+static void Write64(FILE *fp,const unsigned long long value)
+{
+	fwrite(&value,sizeof(value),1,fp);
+}
+
+TraceRecorder::TraceRecorder() : mFile(0) , mInstructionsOnly(false) , mSimulator(0) , mNumRecords(0) , mWorkPending(false) , mStopWorker(false) , mNumWork(0) ,
+	mRingPosition(0)
+{
+	memset(mSeen,0,sizeof(mSeen));
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	Close();
+}
+
+bool TraceRecorder::Open(const Simulator &simulator,const char *filename,const bool instructionsOnly)
+{
+	Close();
+	mFile = fopen(filename,"wb");
+	if (!mFile)
+	{
+		printf("Could not open '%s'\n",filename);
+		return false;
+	}
+	mInstructionsOnly = instructionsOnly;
+	mSimulator = &simulator;
+	mRecordTicks.resize(kTraceBlockRecords);
+	mRecords.resize(kTraceBlockRecords);
+	mNumRecords = 0;
+	mWorkTicks.resize(kTraceBlockRecords);
+	mWork.resize(kTraceBlockRecords);
+	mNumWork = 0;
+	mBlock.resize(kTraceBlockRecords * kTraceMaxRecordSize);
+	mCompressed.resize(mBlock.size() + 16);
+	mHash.resize(1 << kLZHashBits);
+	mIndexOffsets.clear();
+	mIndexTicks.clear();
+
+	fwrite(kTraceMagic,sizeof(kTraceMagic),1,mFile);
+	Write32(mFile,kTraceVersion);
+	Write32(mFile,instructionsOnly ? 1 : 0);
+
+	mWorkPending = false;
+	mStopWorker = false;
+	mWorker = std::thread(&TraceRecorder::WorkerThread,this);
+	return true;
+}
+
+void TraceRecorder::QueueBlock(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (mWorkPending)
+	{
+		mCondition.wait(lock);
+	}
+	mRecordTicks.swap(mWorkTicks);
+	mRecords.swap(mWork);
+	mNumWork = mNumRecords;
+	mNumRecords = 0;
+	mWorkPending = true;
+	mCondition.notify_all();
+}
+
+void TraceRecorder::WorkerThread(void)
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		while (!mWorkPending && !mStopWorker)
+		{
+			mCondition.wait(lock);
+		}
+		if (!mWorkPending)
+		{
+			return;
+		}
+		lock.unlock();
+		EncodeBlock();
+		lock.lock();
+		mWorkPending = false;
+		mCondition.notify_all();
+	}
+}
+
+void TraceRecorder::EncodeBlock(void)
+{
+	if (!mNumWork)
+	{
+		return;
+	}
+	const unsigned long long firstTick = mWorkTicks[0];
+	unsigned long long previousTick = firstTick - 1;
+	// The first record always stores its decoder ROM address, PC, address and data bus
+	int previousAddress = -1;
+	unsigned short previousPC = 0,previousAddressBus = 0;
+	unsigned char previousDataBus = 0;
+	memset(mSeen,0,sizeof(mSeen));
+	unsigned char *out = &mBlock[0];
+	unsigned int i;
+	for (i=0;i<mNumWork;i++)
+	{
+		const TraceTick &record = mWork[i];
+		unsigned char *start = out++;
+		unsigned char mask = 0;
+
+		const unsigned long long ticks = mWorkTicks[i] - previousTick;
+		previousTick = mWorkTicks[i];
+		if (ticks != 1)
+		{
+			mask |= kTraceTicks;
+			out = WriteVarint(out,(size_t) ticks);
+		}
+		// The decoder ROM address, PC, address and data bus change in patterns that are hard to predict, so the fields are always written
+		// and then only kept if they changed, which avoids a branch for each one
+		const int address = record.GetDecoderROMAddress();
+		const unsigned short pc = record.GetPC();
+		const unsigned short addressBus = record.GetAddressBus();
+		const unsigned char dataBus = record.GetDataBus();
+		const int addressJumped = (address != previousAddress + 1);
+		mask |= (unsigned char) (addressJumped * kTraceROMAddress);
+		out[0] = (unsigned char) address;
+		out[1] = (unsigned char) (address >> 8);
+		out[2] = (unsigned char) (address >> 16);
+		out += addressJumped * 3;
+		if (!(mSeen[address >> 3] & (1 << (address & 7))))
+		{
+			mSeen[address >> 3] |= (unsigned char) (1 << (address & 7));
+			mask |= kTraceDecoders;
+			int decoder;
+			for (decoder=0;decoder<kNumDecoders;decoder++)
+			{
+				*out++ = mSimulator->GetDecoderROM(decoder,address);
+			}
+		}
+		const int pcInc = (pc == (unsigned short) (previousPC + 1));
+		const int pcChanged = (pc != previousPC) & !pcInc;
+		const int addressChanged = (addressBus != previousAddressBus);
+		const int addressIsPC = addressChanged & (addressBus == pc);
+		const int addressOther = addressChanged & !addressIsPC;
+		const int dataChanged = (dataBus != previousDataBus);
+		mask |= (unsigned char) ((pcInc * kTracePCInc) | (pcChanged * kTracePC) | (addressIsPC * kTraceAddressPC) | (addressOther * kTraceAddress) | (dataChanged * kTraceData));
+		out[0] = (unsigned char) pc;
+		out[1] = (unsigned char) (pc >> 8);
+		out += pcChanged * 2;
+		out[0] = (unsigned char) addressBus;
+		out[1] = (unsigned char) (addressBus >> 8);
+		out += addressOther * 2;
+		out[0] = dataBus;
+		out += dataChanged;
+		*start = mask;
+		previousAddress = address;
+		previousPC = pc;
+		previousAddressBus = addressBus;
+		previousDataBus = dataBus;
+	}
+
+	const size_t blockSize = out - &mBlock[0];
+	const size_t compressed = CompressLZ(&mBlock[0],blockSize,&mCompressed[0],&mHash[0]);
+	mIndexOffsets.push_back((unsigned long long) _ftelli64(mFile));
+	mIndexTicks.push_back(firstTick);
+	Write32(mFile,(unsigned int) compressed);
+	Write32(mFile,(unsigned int) blockSize);
+	Write32(mFile,mNumWork);
+	Write64(mFile,firstTick);
+	fwrite(&mCompressed[0],1,compressed,mFile);
+}
+
+bool TraceRecorder::Close(void)
+{
+	if (!mFile)
+	{
+		return false;
+	}
+	QueueBlock();
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (mWorkPending)
+		{
+			mCondition.wait(lock);
+		}
+		mStopWorker = true;
+		mCondition.notify_all();
+	}
+	mWorker.join();
+
+	const unsigned long long indexOffset = (unsigned long long) _ftelli64(mFile);
+	size_t i;
+	for (i=0;i<mIndexOffsets.size();i++)
+	{
+		Write64(mFile,mIndexOffsets[i]);
+		Write64(mFile,mIndexTicks[i]);
+	}
+	Write32(mFile,(unsigned int) mIndexOffsets.size());
+	Write64(mFile,indexOffset);
+	fwrite(kTraceIndexMagic,sizeof(kTraceIndexMagic),1,mFile);
+	const bool ok = !ferror(mFile);
+	fclose(mFile);
+	mFile = 0;
+	return ok;
+}
+
+void TraceRecorder::SetRingSize(const size_t ticks)
+{
+	mRing.clear();
+	mRing.resize(ticks);
+	mRingPosition = 0;
+}
+
+bool TraceRecorder::DumpRing(const Simulator &simulator,const char *filename)
+{
+	if (mRing.empty() || !Open(simulator,filename,false))
+	{
+		return false;
+	}
+	// Before the ring wraps the oldest entry is at the start
+	const unsigned long long total = simulator.GetTotalTicks();
+	const size_t count = (total < mRing.size()) ? (size_t) total : mRing.size();
+	size_t position = (count < mRing.size()) ? 0 : mRingPosition;
+	size_t i;
+	for (i=0;i<count;i++)
+	{
+		mRecordTicks[mNumRecords] = total - count + i;
+		mRecords[mNumRecords] = mRing[position];
+		if (++mNumRecords == kTraceBlockRecords)
+		{
+			QueueBlock();
+		}
+		if (++position == mRing.size())
+		{
+			position = 0;
+		}
+	}
+	printf("Wrote the last %llu ticks to '%s'\n",(unsigned long long) count,filename);
+	return Close();
+}
+
+bool TraceRecorder::Dump(const char *filename,const unsigned long long fromTick,const unsigned long long count)
+{
+	FILE *fp = fopen(filename,"rb");
+	if (!fp)
+	{
+		printf("Could not open '%s'\n",filename);
+		return false;
+	}
+	char magic[8];
+	unsigned int version = 0,instructionsOnly = 0;
+	unsigned int blocks = 0;
+	unsigned long long indexOffset = 0;
+	bool ok = (fread(magic,sizeof(magic),1,fp) == 1) && !memcmp(magic,kTraceMagic,sizeof(magic)) &&
+		(fread(&version,sizeof(version),1,fp) == 1) && (version == kTraceVersion) && (fread(&instructionsOnly,sizeof(instructionsOnly),1,fp) == 1);
+	const __int64 footerSize = sizeof(blocks) + sizeof(indexOffset) + sizeof(magic);
+	ok = ok && !_fseeki64(fp,-footerSize,SEEK_END) && (fread(&blocks,sizeof(blocks),1,fp) == 1) && (fread(&indexOffset,sizeof(indexOffset),1,fp) == 1) &&
+		(fread(magic,sizeof(magic),1,fp) == 1) && !memcmp(magic,kTraceIndexMagic,sizeof(magic));
+	std::vector<unsigned long long> index(blocks * 2 + 1);
+	ok = ok && !_fseeki64(fp,(__int64) indexOffset,SEEK_SET) && (!blocks || (fread(&index[0],sizeof(unsigned long long),blocks * 2,fp) == blocks * 2));
+	if (!ok)
+	{
+		printf("'%s' is not a trace file\n",filename);
+		fclose(fp);
+		return false;
+	}
+
+	// The last block that starts at or before the tick
+	unsigned int block = 0;
+	while ( (block + 1 < blocks) && (index[(block + 1) * 2 + 1] <= fromTick) )
+	{
+		block++;
+	}
+
+	std::vector<unsigned char> compressed,raw;
+	std::vector<unsigned char> decoders(kDecoderROMSize * kNumDecoders);
+	unsigned long long printed = 0;
+	for (;(block < blocks) && (printed < count);block++)
+	{
+		unsigned int compressedSize = 0,rawSize = 0,records = 0;
+		unsigned long long tick = 0;
+		ok = !_fseeki64(fp,(__int64) index[block * 2],SEEK_SET) && (fread(&compressedSize,sizeof(compressedSize),1,fp) == 1) && (fread(&rawSize,sizeof(rawSize),1,fp) == 1) &&
+			(fread(&records,sizeof(records),1,fp) == 1) && (fread(&tick,sizeof(tick),1,fp) == 1);
+		compressed.resize(compressedSize + 1);
+		raw.resize(rawSize + kTraceMaxRecordSize);
+		ok = ok && (fread(&compressed[0],1,compressedSize,fp) == compressedSize) && DecompressLZ(&compressed[0],compressedSize,&raw[0],rawSize);
+		if (!ok)
+		{
+			printf("Block %u of '%s' is corrupt\n",block,filename);
+			fclose(fp);
+			return false;
+		}
+
+		TraceRecord record;
+		memset(&record,0,sizeof(record));
+		record.mTotalTick = tick - 1;
+		record.mDecoderROMAddress = -1;
+		const unsigned char *src = &raw[0];
+		const unsigned char *end = src + rawSize;
+		unsigned int i;
+		for (i=0;(i < records) && (printed < count) && src;i++)
+		{
+			const unsigned char mask = *src++;
+			size_t ticks = 1;
+			if (mask & kTraceTicks)
+			{
+				src = ReadVarint(src,end,ticks);
+			}
+			// The raw buffer is padded so a corrupt record cannot read past it before this check
+			if (!src || (src > end))
+			{
+				break;
+			}
+			record.mTotalTick += ticks;
+			if (mask & kTraceROMAddress)
+			{
+				record.mDecoderROMAddress = src[0] | (src[1] << 8) | (src[2] << 16);
+				src += 3;
+			}
+			else
+			{
+				record.mDecoderROMAddress++;
+			}
+			unsigned char *stored = &decoders[(record.mDecoderROMAddress & (kDecoderROMSize - 1)) * kNumDecoders];
+			if (mask & kTraceDecoders)
+			{
+				memcpy(stored,src,kNumDecoders);
+				src += kNumDecoders;
+			}
+			memcpy(record.mDecoder,stored,kNumDecoders);
+			if (mask & kTracePCInc)
+			{
+				record.mPC++;
+			}
+			else if (mask & kTracePC)
+			{
+				record.mPC = (unsigned short) (src[0] | (src[1] << 8));
+				src += 2;
+			}
+			if (mask & kTraceAddressPC)
+			{
+				record.mAddressBus = record.mPC;
+			}
+			else if (mask & kTraceAddress)
+			{
+				record.mAddressBus = (unsigned short) (src[0] | (src[1] << 8));
+				src += 2;
+			}
+			if (mask & kTraceData)
+			{
+				record.mDataBus = *src++;
+			}
+			if (record.mTotalTick < fromTick)
+			{
+				continue;
+			}
+			const int address = record.mDecoderROMAddress;
+			printf("%10llu $%04x bank %d $%02x tick %2d address $%04x data $%02x decoders $%02x $%02x $%02x $%02x $%02x\n",record.mTotalTick,record.mPC,
+				address >> 14,(address >> 6) & 255,address & 63,record.mAddressBus,record.mDataBus,
+				record.mDecoder[0],record.mDecoder[1],record.mDecoder[2],record.mDecoder[3],record.mDecoder[4]);
+			printed++;
+		}
+	}
+	fclose(fp);
+	return true;
+}
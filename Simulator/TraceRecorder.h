@@ -0,0 +1,152 @@
+#ifndef _TRACERECORDER_H_
+#define _TRACERECORDER_H_
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Simulator.h"
+
+// One traced tick, the decoder outputs are looked up from the decoder ROM address when they are needed
+struct TraceRecord
+{
+	unsigned long long mTotalTick;
+	int mDecoderROMAddress;
+	unsigned short mPC;
+	unsigned short mAddressBus;
+	unsigned char mDataBus;
+	unsigned char mDecoder[kNumDecoders];
+};
+
+// The state of one tick as it is recorded, by the block buffers and the ring buffer, before it is delta encoded.
+// It is packed into 64 bits so the ring buffer is smaller: decoder ROM address (18 bits) | data bus (8 bits) | address bus (16 bits) | PC (16 bits)
+struct TraceTick
+{
+	unsigned long long mValue;
+
+	void Set(const Simulator &simulator)
+	{
+		mValue = (unsigned long long) simulator.GetLastDecoderROMAddress() | ((unsigned long long) simulator.GetLastDataBus() << 18) |
+			((unsigned long long) simulator.GetLastAddressBus() << 26) | ((unsigned long long) simulator.GetLastPC() << 42);
+	}
+	int GetDecoderROMAddress(void) const
+	{
+		return (int) (mValue & (kDecoderROMSize - 1));
+	}
+	unsigned char GetDataBus(void) const
+	{
+		return (unsigned char) (mValue >> 18);
+	}
+	unsigned short GetAddressBus(void) const
+	{
+		return (unsigned short) (mValue >> 26);
+	}
+	unsigned short GetPC(void) const
+	{
+		return (unsigned short) (mValue >> 42);
+	}
+};
+
+const unsigned int kTraceBlockRecords = 65536;
+
+// Records the state of each tick, or only the first tick of each opcode, to a compressed trace file.
+// Record() only copies the tick to the block being recorded. When that is full it is swapped with the block a worker thread encodes and
+// writes, so the encoding runs alongside the simulation instead of in it and Record() only waits if the worker falls a whole block behind.
+// Each record is delta encoded against the previous record with a mask byte of the fields that changed, the decoder outputs are only
+// stored the first time their decoder ROM address appears in a block. Each block of records is then LZ compressed.
+// Every block can be decoded on its own and the index at the end of the file has the first tick of each block, so Dump() can seek to any tick.
+// File layout:
+//   Header : "TTLTRACE" , version (4 bytes) , instructions only (4 bytes)
+//   Blocks : compressed size (4 bytes) , raw size (4 bytes) , records (4 bytes) , first tick (8 bytes) , compressed data
+//   Index  : for each block the file offset (8 bytes) and first tick (8 bytes)
+//   Footer : blocks (4 bytes) , index offset (8 bytes) , "TTLINDEX"
+class TraceRecorder
+{
+public:
+	TraceRecorder();
+	virtual ~TraceRecorder();
+
+	// Opens the trace file, instructions only records the first tick of each opcode instead of every tick.
+	// The worker thread uses the simulator to look up the decoder outputs, the decoder ROMs must not be loaded again until Close().
+	bool Open(const Simulator &simulator,const char *filename,const bool instructionsOnly);
+
+	// Call after each Simulator::Tick() to record the tick it executed. The tick is only copied here, the worker thread encodes it.
+	void Record(const Simulator &simulator)
+	{
+		// The opcode and the continuation flip-flop have not changed yet since no opcode is one tick long
+		if (mInstructionsOnly && ((simulator.GetLastDecoderROMAddress() & 63) || simulator.IsContinuation()))
+		{
+			return;
+		}
+		mRecordTicks[mNumRecords] = simulator.GetTotalTicks() - 1;
+		mRecords[mNumRecords].Set(simulator);
+		if (++mNumRecords == kTraceBlockRecords)
+		{
+			QueueBlock();
+		}
+	}
+
+	// Waits for the worker thread then writes the last block and the index
+	bool Close(void);
+
+	// Keeps the last ticks in memory instead of writing them, DumpRing() writes them to a trace file
+	void SetRingSize(const size_t ticks);
+
+	// Call after each Simulator::Tick() to keep the tick it executed in the ring buffer
+	void RecordRing(const Simulator &simulator)
+	{
+		mRing[mRingPosition].Set(simulator);
+		if (++mRingPosition == mRing.size())
+		{
+			mRingPosition = 0;
+		}
+	}
+
+	// Writes the ticks in the ring buffer, up to the last Simulator::Tick(), to a trace file
+	bool DumpRing(const Simulator &simulator,const char *filename);
+
+	// Prints count records of the trace file starting from the record at or after the tick
+	static bool Dump(const char *filename,const unsigned long long fromTick,const unsigned long long count);
+
+protected:
+	// Waits for the worker thread to finish the last block it was given then gives it the recorded block
+	void QueueBlock(void);
+	void WorkerThread(void);
+	// Delta encodes, compresses and writes the block given to the worker thread
+	void EncodeBlock(void);
+
+	FILE *mFile;
+	bool mInstructionsOnly;
+	const Simulator *mSimulator;
+
+	// The block being recorded
+	std::vector<unsigned long long> mRecordTicks;
+	std::vector<TraceTick> mRecords;
+	unsigned int mNumRecords;
+
+	// Everything from here on is only used by the worker thread while it runs, apart from the hand over in QueueBlock()
+	std::thread mWorker;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mWorkPending;
+	bool mStopWorker;
+	std::vector<unsigned long long> mWorkTicks;
+	std::vector<TraceTick> mWork;
+	unsigned int mNumWork;
+
+	// The delta encoded block, each block starts from a known previous record so it can be decoded on its own
+	std::vector<unsigned char> mBlock;
+	std::vector<unsigned char> mCompressed;
+	std::vector<int> mHash;
+	// One bit per decoder ROM address that has had its decoder outputs stored in the block
+	unsigned char mSeen[kDecoderROMSize / 8];
+
+	std::vector<unsigned long long> mIndexOffsets;
+	std::vector<unsigned long long> mIndexTicks;
+
+	std::vector<TraceTick> mRing;
+	size_t mRingPosition;
+};
+
+#endif
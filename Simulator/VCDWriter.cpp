@@ -0,0 +1,396 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include "VCDWriter.h"
+
+// The net names from Processor8BitData16BitAddress.EDF. The decoder outputs are the Q outputs of DCDR1LTCH (U26), DCDR2LTCH (U27),
+// DCDR3LTCH (U28), DCDR4DLY (U29) and DCDR5LTCH (U129) in bit order. The data bus source select outputs of DCDR2LTCH only have the
+// automatic net names, and the decoder 5 outputs from IRQLINERST onwards are not in the netlist yet so they are named after their
+// OpCode.h bit. VCD names cannot contain spaces so "REG0 LE" is REG0_LE.
+static const char *kVCDSignalNames[kVCDNumSignals] =
+{
+	"PCINC","OPLE","PCOE","ADDRLLLE","ADDRLHLE","PCLE","MEMWRITE","RESETCLOCK",
+	"#00694","#00695","#00696","#00697","BRANCHLE","CPUWANTBUS","CPUHASBUS","BUSDDR",
+	"ALU1LE","ALU2LE","ALU3LE","ALUOP0","ALUOP1","ALUOP2","ALUOP3","ALURESLE",
+	"REG0_LE","REG1_LE","REG2_LE","REG3_LE","REG4_LE","REG5_LE","REG6_LE","STATUS_LE",
+	"IRQSTATELE","ILLEGALOP","IRQLINERST","CONSTTODB","SPINC","SPDEC","MULTODB","ALUBANK",
+	// EXTWANTIRQ is active low. The ALU flags are the combinatorial outputs of ALU1 (U53) and ALU2 (U54) before ALURESLE latches them,
+	// ZERO1 and ZERO2 are high when the lo and hi nybble of the result are zero.
+	"EXTWANTIRQ","ALUCARRY","ZERO1","ZERO2","OVERFLOW","NEGATIVE",
+	"D","A"
+};
+
+const int kVCDExtWantIRQ = 40;
+const int kVCDALUCarry = 41;
+const int kVCDZero1 = 42;
+const int kVCDZero2 = 43;
+const int kVCDOverflow = 44;
+const int kVCDNegative = 45;
+
+const unsigned long long kVCDNever = ~0ULL;
+
+// The VCD identifier of each signal is one printable character
+static char GetIdentifier(const int signal)
+{
+	return (char) ('!' + signal);
+}
+
+// Case insensitive, * matches any number of characters
+static bool WildcardMatch(const char *pattern,const char *name)
+{
+	while (*pattern && (*pattern != '*'))
+	{
+		if (toupper(*pattern) != toupper(*name))
+		{
+			return false;
+		}
+		pattern++;
+		name++;
+	}
+	if (!*pattern)
+	{
+		return !*name;
+	}
+	do
+	{
+		if (WildcardMatch(pattern + 1,name))
+		{
+			return true;
+		}
+	} while (*name++);
+	return false;
+}
+
+static bool SortByStart(const VCDWindow &a,const VCDWindow &b)
+{
+	return a.mStart < b.mStart;
+}
+
+VCDWriter::VCDWriter() : mFile(0) , mPeriod(1) , mWindow(0) , mWindowStart(kVCDNever) , mWindowEnd(kVCDNever) , mInWindow(false) , mStarted(false) ,
+	mFiltered(false) , mSelectedBits(0) , mBits(0) , mDataBus(0) , mAddressBus(0) , mChanges(0) , mBufferSize(0)
+{
+	memset(mSelected,0,sizeof(mSelected));
+}
+
+VCDWriter::~VCDWriter()
+{
+	Close();
+}
+
+void VCDWriter::AddWindow(const unsigned long long firstTick,const unsigned long long ticks)
+{
+	VCDWindow window;
+	window.mStart = firstTick;
+	window.mEnd = ((kVCDNever - firstTick) > ticks) ? (firstTick + ticks) : kVCDNever;
+	mWindows.push_back(window);
+}
+
+bool VCDWriter::AddFilter(const char *names)
+{
+	mFiltered = true;
+	bool ok = true;
+	char name[64];
+	while (*names)
+	{
+		size_t length = strcspn(names,",");
+		if (length >= sizeof(name))
+		{
+			length = sizeof(name) - 1;
+		}
+		memcpy(name,names,length);
+		name[length] = '\0';
+		names += strcspn(names,",");
+		if (*names)
+		{
+			names++;
+		}
+		bool matched = false;
+		int i;
+		for (i=0;i<kVCDNumSignals;i++)
+		{
+			if (WildcardMatch(name,kVCDSignalNames[i]))
+			{
+				mSelected[i] = true;
+				matched = true;
+			}
+		}
+		if (!matched)
+		{
+			printf("No VCD signal matches '%s'\n",name);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+bool VCDWriter::Open(const char *filename,const double clockMHz)
+{
+	Close();
+	mFile = fopen(filename,"wb");
+	if (!mFile)
+	{
+		printf("Could not open '%s'\n",filename);
+		return false;
+	}
+
+	// The time scale is 1ps so the clock period is close enough to exact
+	mPeriod = (unsigned long long) (1000000.0 / clockMHz + 0.5);
+	if (!mPeriod)
+	{
+		mPeriod = 1;
+	}
+
+	int i;
+	mSelectedBits = 0;
+	for (i=0;i<kVCDNumSignals;i++)
+	{
+		if (!mFiltered)
+		{
+			mSelected[i] = true;
+		}
+		if (mSelected[i] && (i < kVCDNumBitSignals))
+		{
+			mSelectedBits |= 1ULL << i;
+		}
+	}
+
+	// Overlapping windows are merged so the ticks are only written once
+	if (mWindows.empty())
+	{
+		AddWindow(0,kVCDNever);
+	}
+	std::sort(mWindows.begin(),mWindows.end(),SortByStart);
+	std::vector<VCDWindow> merged;
+	size_t window;
+	for (window=0;window<mWindows.size();window++)
+	{
+		if (!merged.empty() && (mWindows[window].mStart <= merged.back().mEnd))
+		{
+			merged.back().mEnd = std::max(merged.back().mEnd,mWindows[window].mEnd);
+		}
+		else
+		{
+			merged.push_back(mWindows[window]);
+		}
+	}
+	mWindows = merged;
+	mWindow = 0;
+	mWindowStart = mWindows[0].mStart;
+	mWindowEnd = mWindows[0].mEnd;
+	mInWindow = false;
+	mStarted = false;
+	mChanges = 0;
+	mBufferSize = 0;
+
+	fprintf(mFile,"$version TTL CPU Simulator $end\n");
+	fprintf(mFile,"$comment Each tick is %.3fMHz, the values change at NOTCLK when the decoder latches open $end\n",clockMHz);
+	fprintf(mFile,"$timescale 1ps $end\n");
+	fprintf(mFile,"$scope module CPU $end\n");
+	for (i=0;i<kVCDNumSignals;i++)
+	{
+		if (!mSelected[i])
+		{
+			continue;
+		}
+		if (i == kVCDSignalDataBus)
+		{
+			fprintf(mFile,"$var wire 8 %c %s [7:0] $end\n",GetIdentifier(i),kVCDSignalNames[i]);
+		}
+		else if (i == kVCDSignalAddressBus)
+		{
+			fprintf(mFile,"$var wire 16 %c %s [15:0] $end\n",GetIdentifier(i),kVCDSignalNames[i]);
+		}
+		else
+		{
+			fprintf(mFile,"$var wire 1 %c %s $end\n",GetIdentifier(i),kVCDSignalNames[i]);
+		}
+	}
+	fprintf(mFile,"$upscope $end\n");
+	fprintf(mFile,"$enddefinitions $end\n");
+	return true;
+}
+
+void VCDWriter::WriteTick(const Simulator &simulator,const unsigned long long tick)
+{
+	// Moves to the window that has the tick, the ticks after a window are unknown until the next window
+	while (tick >= mWindowEnd)
+	{
+		if (mInWindow)
+		{
+			WriteTime(mWindowEnd);
+			WriteAll(true);
+			mInWindow = false;
+		}
+		if (++mWindow >= mWindows.size())
+		{
+			mWindowStart = kVCDNever;
+			mWindowEnd = kVCDNever;
+			return;
+		}
+		mWindowStart = mWindows[mWindow].mStart;
+		mWindowEnd = mWindows[mWindow].mEnd;
+	}
+	if (tick < mWindowStart)
+	{
+		return;
+	}
+
+	const int address = simulator.GetLastDecoderROMAddress();
+	unsigned long long bits = 0;
+	int decoder;
+	for (decoder=0;decoder<kNumDecoders;decoder++)
+	{
+		bits |= (unsigned long long) simulator.GetDecoderROM(decoder,address) << (decoder * 8);
+	}
+	const unsigned char result = simulator.GetLastALUResult();
+	const unsigned char resultST = simulator.GetLastALUResultST();
+	bits |= (unsigned long long) (simulator.IsExtWantIRQ() ? 0 : 1) << kVCDExtWantIRQ;
+	bits |= (unsigned long long) (resultST & 1) << kVCDALUCarry;
+	bits |= (unsigned long long) ((result & 0x0f) ? 0 : 1) << kVCDZero1;
+	bits |= (unsigned long long) ((result & 0xf0) ? 0 : 1) << kVCDZero2;
+	bits |= (unsigned long long) ((resultST >> 6) & 1) << kVCDOverflow;
+	bits |= (unsigned long long) ((resultST >> 7) & 1) << kVCDNegative;
+	bits &= mSelectedBits;
+	const unsigned char dataBus = simulator.GetLastDataBus();
+	const unsigned short addressBus = simulator.GetLastAddressBus();
+
+	if (!mInWindow)
+	{
+		mBits = bits;
+		mDataBus = dataBus;
+		mAddressBus = addressBus;
+		WriteTime(tick);
+		WriteAll(false);
+		mInWindow = true;
+		return;
+	}
+
+	unsigned long long changed = bits ^ mBits;
+	const bool dataChanged = mSelected[kVCDSignalDataBus] && (dataBus != mDataBus);
+	const bool addressChanged = mSelected[kVCDSignalAddressBus] && (addressBus != mAddressBus);
+	if (!changed && !dataChanged && !addressChanged)
+	{
+		return;
+	}
+	WriteTime(tick);
+	int signal = 0;
+	while (changed)
+	{
+		// Skips eight unchanged signals at a time
+		if (!(changed & 0xff))
+		{
+			changed >>= 8;
+			signal += 8;
+			continue;
+		}
+		if (changed & 1)
+		{
+			WriteBit(signal,((bits >> signal) & 1) ? '1' : '0');
+		}
+		changed >>= 1;
+		signal++;
+	}
+	mBits = bits;
+	if (dataChanged)
+	{
+		WriteVector(kVCDSignalDataBus,dataBus,8);
+		mDataBus = dataBus;
+	}
+	if (addressChanged)
+	{
+		WriteVector(kVCDSignalAddressBus,addressBus,16);
+		mAddressBus = addressBus;
+	}
+}
+
+void VCDWriter::WriteAll(const bool unknown)
+{
+	const char *command = unknown ? "$dumpoff\n" : (mStarted ? "$dumpon\n" : "$dumpvars\n");
+	memcpy(mBuffer + mBufferSize,command,strlen(command));
+	mBufferSize += strlen(command);
+	mStarted = true;
+	int i;
+	for (i=0;i<kVCDNumBitSignals;i++)
+	{
+		if (mSelected[i])
+		{
+			WriteBit(i,unknown ? 'x' : (((mBits >> i) & 1) ? '1' : '0'));
+		}
+	}
+	if (mSelected[kVCDSignalDataBus])
+	{
+		WriteVector(kVCDSignalDataBus,unknown ? ~0U : mDataBus,unknown ? 0 : 8);
+	}
+	if (mSelected[kVCDSignalAddressBus])
+	{
+		WriteVector(kVCDSignalAddressBus,unknown ? ~0U : mAddressBus,unknown ? 0 : 16);
+	}
+	memcpy(mBuffer + mBufferSize,"$end\n",5);
+	mBufferSize += 5;
+}
+
+void VCDWriter::WriteTime(const unsigned long long tick)
+{
+	if (mBufferSize > sizeof(mBuffer) - 64)
+	{
+		Flush();
+	}
+	mBufferSize += sprintf(mBuffer + mBufferSize,"#%llu\n",tick * mPeriod + mPeriod / 2);
+}
+
+void VCDWriter::WriteBit(const int signal,const char value)
+{
+	if (mBufferSize > sizeof(mBuffer) - 64)
+	{
+		Flush();
+	}
+	mBuffer[mBufferSize++] = value;
+	mBuffer[mBufferSize++] = GetIdentifier(signal);
+	mBuffer[mBufferSize++] = '\n';
+	mChanges++;
+}
+
+// A zero width writes an unknown value
+void VCDWriter::WriteVector(const int signal,const unsigned int value,const int width)
+{
+	if (mBufferSize > sizeof(mBuffer) - 64)
+	{
+		Flush();
+	}
+	mBuffer[mBufferSize++] = 'b';
+	if (!width)
+	{
+		mBuffer[mBufferSize++] = 'x';
+	}
+	int bit;
+	for (bit=width-1;bit>=0;bit--)
+	{
+		mBuffer[mBufferSize++] = ((value >> bit) & 1) ? '1' : '0';
+	}
+	mBuffer[mBufferSize++] = ' ';
+	mBuffer[mBufferSize++] = GetIdentifier(signal);
+	mBuffer[mBufferSize++] = '\n';
+	mChanges++;
+}
+
+void VCDWriter::Flush(void)
+{
+	fwrite(mBuffer,1,mBufferSize,mFile);
+	mBufferSize = 0;
+}
+
+bool VCDWriter::Close(void)
+{
+	if (!mFile)
+	{
+		return false;
+	}
+	Flush();
+	const bool ok = !ferror(mFile);
+	fclose(mFile);
+	mFile = 0;
+	mWindowStart = kVCDNever;
+	printf("Wrote %llu VCD value changes\n",mChanges);
+	return ok;
+}
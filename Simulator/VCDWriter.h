@@ -0,0 +1,88 @@
+#ifndef _VCDWRITER_H_
+#define _VCDWRITER_H_
+
+#include <stdio.h>
+#include <vector>
+#include "Simulator.h"
+
+// The 1 bit signals, in the order of kVCDSignalNames in VCDWriter.cpp, followed by the data bus and the address bus vectors
+const int kVCDNumBitSignals = 46;
+const int kVCDSignalDataBus = kVCDNumBitSignals;
+const int kVCDSignalAddressBus = kVCDNumBitSignals + 1;
+const int kVCDNumSignals = kVCDNumBitSignals + 2;
+
+// The ticks from mStart up to but not including mEnd
+struct VCDWindow
+{
+	unsigned long long mStart;
+	unsigned long long mEnd;
+};
+
+// Writes the decoder latch outputs, the data and address bus, EXTWANTIRQ and the ALU flags of each tick to a VCD file that can be
+// compared with the Proteus schematic simulation in a waveform viewer. The signals use the net names from the Proteus netlist.
+// Only the value changes are written as they happen, so the memory used does not depend on the length of the capture. The capture
+// can be limited to windows of ticks and to a set of signals, between windows the signals are written as unknown with $dumpoff.
+class VCDWriter
+{
+public:
+	VCDWriter();
+	virtual ~VCDWriter();
+
+	// Only writes ticks from the first tick for the number of ticks, call before Open(). Without any windows every tick is written.
+	void AddWindow(const unsigned long long firstTick,const unsigned long long ticks);
+
+	// Only writes the signals that match the comma separated names, which can use * as a wildcard, call before Open().
+	// Returns false if a name does not match any signal. Without any filters every signal is written.
+	bool AddFilter(const char *names);
+
+	// Each tick is one period of the clock in MHz
+	bool Open(const char *filename,const double clockMHz);
+
+	// Call after each Simulator::Tick() to write the changes of the tick it executed
+	void Record(const Simulator &simulator)
+	{
+		const unsigned long long tick = simulator.GetTotalTicks() - 1;
+		if (tick >= mWindowStart)
+		{
+			WriteTick(simulator,tick);
+		}
+	}
+
+	bool Close(void);
+
+protected:
+	void WriteTick(const Simulator &simulator,const unsigned long long tick);
+	// Writes every selected signal, or unknown for all of them, for $dumpvars, $dumpon and $dumpoff
+	void WriteAll(const bool unknown);
+	void WriteTime(const unsigned long long tick);
+	void WriteBit(const int signal,const char value);
+	void WriteVector(const int signal,const unsigned int value,const int width);
+	void Flush(void);
+
+	FILE *mFile;
+	unsigned long long mPeriod;
+
+	std::vector<VCDWindow> mWindows;
+	size_t mWindow;
+	// The first tick to write, past the last window when the capture is complete
+	unsigned long long mWindowStart;
+	unsigned long long mWindowEnd;
+	bool mInWindow;
+	bool mStarted;
+
+	bool mSelected[kVCDNumSignals];
+	bool mFiltered;
+	unsigned long long mSelectedBits;
+
+	// The values last written
+	unsigned long long mBits;
+	unsigned char mDataBus;
+	unsigned short mAddressBus;
+	unsigned long long mChanges;
+
+	// Bounded output buffer
+	char mBuffer[65536];
+	size_t mBufferSize;
+};
+
+#endif
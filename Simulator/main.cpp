@@ -0,0 +1,896 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Simulator.h"
+#include "IOBufferBoard.h"
+#include "TickProfiler.h"
+#include "ROMAnalyzer.h"
+#include "TimingAnalyzer.h"
+#include "TraceRecorder.h"
+#include "VCDWriter.h"
+#include "BusMonitor.h"
+#include "HotLoopDetector.h"
+
+// Command line host simulator for the TTL CPU ROM images created by the Microcode project.
+// Usage: Simulator [-roms <path>] [-irq <ticks>] [-nmi <ticks>] [-ticks <count>] [-trace] [-peek <hex address>] [-profile <file prefix>] <image.bin> <hex address> ...
+// By default the ROMs are loaded from "../" and KernalROM.bin/BASICROM.bin are used as the memory images.
+// Simulator -copro <count> [-mhz <clock>] benchmarks the C64Boot/CoProcessor.a firmware, by default loaded from CoProcessor.bin
+// in the ROM path, with count random operations per command through the IO buffer board model.
+// -profile <file prefix> collects the ticks per bank, opcode and tick, writes <file prefix>HeatMap.csv/.pgm and prints the opcodes
+// ranked by the ticks saved if they were -profileticks <ticks> shorter, by default 4 which is roughly one 6502 cycle.
+// -coverage marks the bank, opcode and tick of each executed microcode state and prints the entries of each bank that the run did not
+// cover, for example when running the KernalROM.a self-test. The exit code is 2 if there are uncovered entries and the CPU did not halt.
+// -cycles prints the ticks of each opcode next to the NMOS 6502 cycles and the effective 6502 MHz of the run at the -mhz <clock> tick clock.
+// -65c02 loads the 65C02 ROM set from "../65C02/", unless -roms is used, and compares against the 65C02 cycles instead.
+// -tracefile <file> records the first tick of each opcode to a compressed trace file, or every tick with -traceticks.
+// -ring <million ticks> keeps the last ticks in memory and writes them to the -tracefile, by default Ring.trace, if the CPU halts.
+// Recording each opcode has no measurable cost. -traceticks costs about half as much CPU time again as the simulation, about 17ns
+// per tick to delta encode and compress on the worker thread against about 38ns per tick to simulate, so only use it for short runs.
+// The ring costs about 7% with 1 million ticks and about 25% with 20 million, where the buffer no longer fits in the caches.
+// -vcd <file> writes the decoder latch outputs, the buses, EXTWANTIRQ and the ALU flags with the Proteus net names to a VCD file,
+// each tick is one period of the -mhz <clock>. -vcdwindow <first tick> <ticks> limits the capture and can be used more than once,
+// -vcdsignals <names> limits it to the comma separated signal names, which can use * as a wildcard, for example -vcdsignals PCINC,ALUOP*,D,A
+// -busmonitor [<reports>] checks each tick against the previous tick for bus contention and design rule violations, prints the first
+// reports violations, by default 20, with the tick, PC, bank, opcode and tick then the count of each rule and the microcode states with the
+// most violations. The exit code is 3 if there are violations and the CPU did not halt. The checks are only compiled in with
+// SIMULATOR_BUS_MONITOR defined, as it is for the Debug configuration, so the Release build has no cost for them.
+// Simulator -busmonitortest runs the bus monitor rules against short sequences that break them, the exit code is 1 if any rule is not detected.
+// Simulator -blocktest runs MVB and FLB with random counts, pointers and registers and checks the memory and registers, checks the
+// loop opcodes $9b and $bb halt when they are executed directly and prints the ticks per byte against the 6502 loops. The exit code is 1 if any fail.
+// -hotloops [<count>] detects the loops from the taken backward branches and prints the count loops, by default 20, with the most
+// self ticks with their inclusive ticks and iterations. -labels <file> loads the labels from an ACME !svl .lbl or !sl .map file for the loop addresses,
+// for example -hotloops -labels ../C64Boot/C64Boot.lbl ../BootROM.bin e000 finds the next fast boot patch or the opcodes to shorten in the microcode.
+// Simulator -dumptrace <file> [-from <tick>] [-count <records>] prints the records of a trace file from the tick.
+// Simulator -analyze statically analyses the decoder ROM images without executing them and prints the idle ticks, the ALU op
+// and data bus source usage and the decoder bits that are never used.
+// Simulator -timing <MHz> statically analyses the critical path of each tick in the decoder ROM images with the delay table in
+// TimingAnalyzer.cpp and prints the maximum safe clock, the slowest ticks and the opcodes that fail the clock. The exit code is 2 if any fail.
+
+static Simulator sSimulator;
+static IOBufferBoard sIOBufferBoard;
+static TickProfiler sTickProfiler;
+static TraceRecorder sTraceRecorder;
+static VCDWriter sVCDWriter;
+static BusMonitor sBusMonitor;
+static HotLoopDetector sHotLoopDetector;
+
+// The pseudo-opcode that enters the IRQ or NMI and the opcode that leaves it
+const unsigned char kOpcodeStartIRQ = 0xfc;
+const unsigned char kOpcodeRTI = 0x40;
+const unsigned short kIRQVector = 0xfffe;
+const unsigned short kNMIVector = 0xfffa;
+
+// Matches CoProCommand_* in CoProcessor.a
+struct CoProcessorCommand
+{
+	const char *mName;
+	int mLength;
+	int mResultLength;
+};
+
+static const CoProcessorCommand kCoProcessorCommands[] =
+{
+	{ "Add16" , 2 , 3 },
+	{ "Add32" , 4 , 5 },
+	{ "Mul16" , 2 , 4 },
+	{ "Mul32" , 4 , 8 },
+	{ "Div16" , 2 , 6 },
+	{ "Div32" , 4 , 8 }
+};
+const int kNumCoProcessorCommands = sizeof(kCoProcessorCommands) / sizeof(kCoProcessorCommands[0]);
+const unsigned char kCoProStatusOK = 0;
+const unsigned char kCoProStatusDivideByZero = 1;
+
+// The host side cost of one operation in C64 cycles excluding the busy wait, lda #/sta abs for each operand byte and the command,
+// lda abs/sta abs for each result byte and one bit abs/bpl for the status.
+static int GetC64HandshakeCycles(const CoProcessorCommand &command)
+{
+	return ((command.mLength * 2) + 1) * 6 + (command.mResultLength * 8) + 6;
+}
+
+static void CalculateCoProcessorReference(const int commandIndex,const unsigned long long a,const unsigned long long b,unsigned char *result,unsigned char &status)
+{
+	unsigned long long value = 0;
+	status = kCoProStatusOK;
+	switch(commandIndex)
+	{
+		case 0:
+		case 1:
+			value = a + b;
+			break;
+		case 2:
+		case 3:
+			value = a * b;
+			break;
+		default:
+			if (!b)
+			{
+				status = kCoProStatusDivideByZero;
+				break;
+			}
+			value = (a / b) | ((a % b) << 32);
+			break;
+	}
+	int i;
+	for (i=0;i<kIOBufferBoardNumResults;i++)
+	{
+		result[i] = (unsigned char) (value >> (i*8));
+	}
+}
+
+static unsigned int GetRandom(void)
+{
+	return ((unsigned int) rand() << 16) ^ ((unsigned int) rand() << 4) ^ (unsigned int) rand();
+}
+
+// Runs the operation through the IO buffer board and returns the ticks from the command write to the status write, or zero if it failed.
+static unsigned long long RunCoProcessorOperation(const int commandIndex,const unsigned long long a,const unsigned long long b)
+{
+	const CoProcessorCommand &command = kCoProcessorCommands[commandIndex];
+	int i;
+	for (i=0;i<command.mLength;i++)
+	{
+		sIOBufferBoard.HostWriteOperand(i,(unsigned char) (a >> (i*8)));
+		sIOBufferBoard.HostWriteOperand(i+4,(unsigned char) (b >> (i*8)));
+	}
+	sIOBufferBoard.HostWriteCommand((unsigned char) commandIndex);
+	unsigned long long start = sSimulator.GetTotalTicks();
+	while (sIOBufferBoard.IsBusy())
+	{
+		if (!sSimulator.Tick() || (sSimulator.GetTotalTicks() - start > 1000000))
+		{
+			printf("%s $%llx $%llx did not finish, PC $%04x\n",command.mName,a,b,sSimulator.GetPC());
+			return 0;
+		}
+	}
+	unsigned long long ticks = sSimulator.GetTotalTicks() - start;
+
+	unsigned char expected[kIOBufferBoardNumResults];
+	unsigned char status;
+	CalculateCoProcessorReference(commandIndex,a,b,expected,status);
+	if (sIOBufferBoard.HostReadStatus() != status)
+	{
+		printf("%s $%llx $%llx status $%02x expected $%02x\n",command.mName,a,b,sIOBufferBoard.HostReadStatus(),status);
+		return 0;
+	}
+	if (status == kCoProStatusOK)
+	{
+		for (i=0;i<command.mResultLength;i++)
+		{
+			if (sIOBufferBoard.HostReadResult(i) != expected[i])
+			{
+				printf("%s $%llx $%llx result byte %d $%02x expected $%02x\n",command.mName,a,b,i,sIOBufferBoard.HostReadResult(i),expected[i]);
+				return 0;
+			}
+		}
+	}
+	return ticks;
+}
+
+static int RunCoProcessorBenchmark(const int count,const double clockMHz)
+{
+	sSimulator.SetIOBufferBoard(&sIOBufferBoard);
+	sIOBufferBoard.Reset();
+	sSimulator.Reset();
+	// Let the firmware reach its busy wait
+	while (sSimulator.GetTotalTicks() < 1000)
+	{
+		if (!sSimulator.Tick())
+		{
+			printf("Halted at $%04x opcode $%02x\n",sSimulator.GetPC(),sSimulator.GetOpcode());
+			return 1;
+		}
+	}
+
+	printf("Coprocessor at %.1fMHz, C64 at 1MHz\n",clockMHz);
+	printf("Command  ticks/op     us/op      ops/sec  C64 handshake cycles  C64 cycles/op\n");
+	int commandIndex;
+	for (commandIndex=0;commandIndex<kNumCoProcessorCommands;commandIndex++)
+	{
+		const CoProcessorCommand &command = kCoProcessorCommands[commandIndex];
+		const unsigned long long mask = (command.mLength == 4) ? 0xffffffffULL : 0xffffULL;
+		// The divide by zero status is checked before the timed operations
+		if ((commandIndex >= 4) && !RunCoProcessorOperation(commandIndex,GetRandom() & mask,0))
+		{
+			return 1;
+		}
+		unsigned long long totalTicks = 0;
+		int i;
+		for (i=0;i<count;i++)
+		{
+			unsigned long long a = GetRandom() & mask;
+			unsigned long long b = GetRandom() & mask;
+			// Also exercise the smaller values that produce short carries and large quotients
+			if (i & 1)
+			{
+				b >>= (GetRandom() % (command.mLength * 8));
+			}
+			if ((commandIndex >= 4) && !b)
+			{
+				b = 1;
+			}
+			unsigned long long ticks = RunCoProcessorOperation(commandIndex,a,b);
+			if (!ticks)
+			{
+				return 1;
+			}
+			totalTicks += ticks;
+		}
+		const double ticksPerOp = (double) totalTicks / (double) count;
+		const double microSeconds = ticksPerOp / clockMHz;
+		const int handshake = GetC64HandshakeCycles(command);
+		printf("%-7s %9.1f %9.2f %12.0f %21d %14.0f\n",command.mName,ticksPerOp,microSeconds,1000000.0 / microSeconds,handshake,(double) handshake + microSeconds);
+	}
+	printf("Offloading to the coprocessor is faster when the native C64 routine takes more than the C64 cycles/op\n");
+	return 0;
+}
+
+const unsigned short kBlockTestCode = 0x1000;
+const unsigned short kResetVector = 0xfffc;
+const unsigned char kOpcodeMVB = 0x8b;
+const unsigned char kOpcodeFLB = 0xab;
+const unsigned char kOpcodeMVBLoop = 0x9b;
+const unsigned char kOpcodeFLBLoop = 0xbb;
+const unsigned char kOpcodeHalt = 0x02;
+const int kBlockTestCases = 32;
+// The destination is checked from one byte before it up to one byte after it
+const unsigned short kBlockTestSource = 0x6000;
+const unsigned short kBlockTestDestination = 0x7000;
+const unsigned char kBlockTestZeroPage[] = { 0x10 , 0x40 , 0xfc };
+const int kNumBlockTestZeroPage = sizeof(kBlockTestZeroPage) / sizeof(kBlockTestZeroPage[0]);
+
+// The state after the code halts and the ticks from the first opcode at timedFrom up to the opcode that halted
+struct BlockTestResult
+{
+	unsigned short mHaltPC;
+	unsigned char mHaltOpcode;
+	unsigned char mA,mX,mY,mST;
+	unsigned long long mTicks;
+};
+
+// Writes the code at kBlockTestCode followed by HALT, resets to it and runs it until the CPU halts
+static bool RunBlockTestCode(const unsigned char *code,const int length,const unsigned short timedFrom,BlockTestResult &result)
+{
+	int i;
+	for (i=0;i<length;i++)
+	{
+		sSimulator.WriteMemory((unsigned short) (kBlockTestCode + i),code[i]);
+	}
+	sSimulator.WriteMemory((unsigned short) (kBlockTestCode + length),kOpcodeHalt);
+	sSimulator.WriteMemory(kResetVector,kBlockTestCode & 0xff);
+	sSimulator.WriteMemory(kResetVector + 1,kBlockTestCode >> 8);
+	sSimulator.Reset();
+
+	bool timing = false;
+	unsigned long long start = 0,lastStart = 0;
+	unsigned short lastPC = 0;
+	do
+	{
+		if (sSimulator.IsOpcodeStart() && !sSimulator.IsContinuation())
+		{
+			lastStart = sSimulator.GetTotalTicks();
+			lastPC = sSimulator.GetPC();
+			if (!timing && (lastPC == timedFrom))
+			{
+				timing = true;
+				start = lastStart;
+			}
+		}
+		if (sSimulator.GetTotalTicks() > 10000000)
+		{
+			printf("Block test code did not halt, PC $%04x\n",sSimulator.GetPC());
+			return false;
+		}
+	} while (sSimulator.Tick());
+
+	result.mHaltPC = lastPC;
+	result.mHaltOpcode = sSimulator.GetOpcode();
+	result.mA = sSimulator.GetRegister(0);
+	result.mX = sSimulator.GetRegister(1);
+	result.mY = sSimulator.GetRegister(2);
+	result.mST = sSimulator.GetST();
+	result.mTicks = timing ? (lastStart - start) : 0;
+	return true;
+}
+
+// Runs one MVB or FLB with random registers, flags and memory and checks the memory and registers against the same code without it.
+// Returns the ticks of the opcode or zero if it failed.
+static unsigned long long RunBlockTestCase(const bool isMove,const int count)
+{
+	const unsigned short source = (unsigned short) (kBlockTestSource + (GetRandom() % 512));
+	const unsigned short destination = (unsigned short) (kBlockTestDestination + 1 + (GetRandom() % 512));
+	const unsigned char zeroPage = kBlockTestZeroPage[GetRandom() % kNumBlockTestZeroPage];
+	const unsigned char a = (unsigned char) GetRandom();
+	const unsigned char y = (unsigned char) GetRandom();
+	int i;
+	unsigned char sourceBytes[256],destinationBytes[258];
+	for (i=0;i<count;i++)
+	{
+		sourceBytes[i] = (unsigned char) GetRandom();
+		sSimulator.WriteMemory((unsigned short) (source + i),sourceBytes[i]);
+	}
+	for (i=0;i<count+2;i++)
+	{
+		destinationBytes[i] = (unsigned char) GetRandom();
+		sSimulator.WriteMemory((unsigned short) (destination - 1 + i),destinationBytes[i]);
+	}
+	sSimulator.WriteMemory(zeroPage,destination & 0xff);
+	sSimulator.WriteMemory(zeroPage + 1,destination >> 8);
+	sSimulator.WriteMemory(zeroPage + 2,source & 0xff);
+	sSimulator.WriteMemory(zeroPage + 3,source >> 8);
+
+	// LDX #count-1 , LDY #y , SEC or CLC , LDA #a , MVB/FLB zp
+	unsigned char code[] = { 0xa2 , (unsigned char) (count - 1) , 0xa0 , y , (unsigned char) ((GetRandom() & 1) ? 0x38 : 0x18) , 0xa9 , a , isMove ? kOpcodeMVB : kOpcodeFLB , zeroPage };
+	const int blockOpcode = sizeof(code) - 2;
+	const char *name = isMove ? "MVB" : "FLB";
+	BlockTestResult result;
+	if (!RunBlockTestCode(code,sizeof(code),(unsigned short) (kBlockTestCode + blockOpcode),result))
+	{
+		return 0;
+	}
+	if ((result.mHaltPC != kBlockTestCode + sizeof(code)) || (result.mHaltOpcode != kOpcodeHalt))
+	{
+		printf("%s count %d halted at $%04x opcode $%02x\n",name,count,result.mHaltPC,result.mHaltOpcode);
+		return 0;
+	}
+
+	for (i=0;i<count+2;i++)
+	{
+		unsigned char expected = destinationBytes[i];
+		if ((i > 0) && (i <= count))
+		{
+			expected = isMove ? sourceBytes[i-1] : a;
+		}
+		const unsigned char got = sSimulator.ReadMemory((unsigned short) (destination - 1 + i));
+		if (got != expected)
+		{
+			printf("%s count %d from $%04x to $%04x byte %d is $%02x expected $%02x\n",name,count,source,destination,i-1,got,expected);
+			return 0;
+		}
+	}
+
+	// The same code without the opcode gives A, Y and the flags
+	BlockTestResult reference;
+	code[blockOpcode] = 0xea;
+	code[blockOpcode+1] = 0xea;
+	if (!RunBlockTestCode(code,sizeof(code),0,reference))
+	{
+		return 0;
+	}
+	if ((result.mA != reference.mA) || (result.mX != 0xff) || (result.mY != reference.mY) || (result.mST != reference.mST))
+	{
+		printf("%s count %d A $%02x X $%02x Y $%02x ST $%02x expected A $%02x X $ff Y $%02x ST $%02x\n",name,count,result.mA,result.mX,result.mY,result.mST,reference.mA,reference.mY,reference.mST);
+		return 0;
+	}
+	return result.mTicks;
+}
+
+// Checks the opcode halts when it is executed directly
+static bool RunBlockTestHalt(const unsigned char opcode)
+{
+	BlockTestResult result;
+	if (!RunBlockTestCode(&opcode,1,0,result))
+	{
+		return false;
+	}
+	if ((result.mHaltPC != kBlockTestCode) || (result.mHaltOpcode != opcode))
+	{
+		printf("Opcode $%02x did not halt, the CPU halted at $%04x opcode $%02x\n",opcode,result.mHaltPC,result.mHaltOpcode);
+		return false;
+	}
+	return true;
+}
+
+// Tests MVB and FLB against random memory, counts and registers, times them against the 6502 loops they replace
+// and checks the loop opcodes halt when they are executed directly
+static int RunBlockTest(void)
+{
+	int isMove;
+	for (isMove=1;isMove>=0;isMove--)
+	{
+		int i;
+		for (i=0;i<kBlockTestCases;i++)
+		{
+			// The end cases then random counts
+			static const int kCounts[] = { 1 , 2 , 255 , 256 };
+			const int count = (i < 4) ? kCounts[i] : 1 + (int) (GetRandom() % 256);
+			if (!RunBlockTestCase(isMove != 0,count))
+			{
+				return 1;
+			}
+		}
+	}
+	if (!RunBlockTestHalt(kOpcodeMVBLoop) || !RunBlockTestHalt(kOpcodeFLBLoop))
+	{
+		return 1;
+	}
+
+	// 256 bytes with each opcode and with the 6502 loop
+	// LDY #0 , LDA abs,Y , STA abs,Y , INY , BNE
+	const unsigned char moveLoop[] = { 0xa0 , 0x00 , 0xb9 , kBlockTestSource & 0xff , kBlockTestSource >> 8 , 0x99 , kBlockTestDestination & 0xff , kBlockTestDestination >> 8 , 0xc8 , 0xd0 , 0xf7 };
+	// LDY #0 , STA abs,Y , INY , BNE
+	const unsigned char fillLoop[] = { 0xa0 , 0x00 , 0x99 , kBlockTestDestination & 0xff , kBlockTestDestination >> 8 , 0xc8 , 0xd0 , 0xfa };
+	BlockTestResult moveLoopResult,fillLoopResult;
+	if (!RunBlockTestCode(moveLoop,sizeof(moveLoop),kBlockTestCode + 2,moveLoopResult) || !RunBlockTestCode(fillLoop,sizeof(fillLoop),kBlockTestCode + 2,fillLoopResult))
+	{
+		return 1;
+	}
+	const unsigned long long moveTicks = RunBlockTestCase(true,256);
+	const unsigned long long fillTicks = RunBlockTestCase(false,256);
+	if (!moveTicks || !fillTicks)
+	{
+		return 1;
+	}
+	printf("Ticks per byte for 256 bytes\n");
+	printf("MVB %6.2f lda abs,y/sta abs,y/iny/bne %6.2f\n",(double) moveTicks / 256.0,(double) moveLoopResult.mTicks / 256.0);
+	printf("FLB %6.2f sta abs,y/iny/bne %6.2f\n",(double) fillTicks / 256.0,(double) fillLoopResult.mTicks / 256.0);
+	printf("Block test passed, %d moves and %d fills\n",kBlockTestCases,kBlockTestCases);
+	return 0;
+}
+
+int main(int argc,char **argv)
+{
+	const char *romPath = 0;
+	unsigned long long maxTicks = 10000000;
+	bool trace = false;
+	bool blockTest = false;
+	bool gotImage = false;
+	int numPeeks = 0;
+	unsigned short peeks[16];
+	int coProcessorCount = 0;
+	double clockMHz = 3.0;
+	unsigned int irqPeriod = 0;
+	unsigned int nmiPeriod = 0;
+	const char *profilePrefix = 0;
+	int profileTicks = 4;
+	bool analyze = false;
+	bool coverage = false;
+	bool cycles = false;
+	bool is65C02 = false;
+	double timingMHz = 0.0;
+	const char *traceFile = 0;
+	bool traceTicks = false;
+	unsigned int ringMillions = 0;
+	const char *dumpTrace = 0;
+	unsigned long long dumpFrom = 0;
+	unsigned long long dumpCount = 100;
+	const char *vcdFile = 0;
+	bool busMonitor = false;
+	bool busMonitorTest = false;
+	int hotLoops = 0;
+
+	int i;
+	for (i=1;i<argc;i++)
+	{
+		if (!strcmp(argv[i],"-roms") && (i+1 < argc))
+		{
+			romPath = argv[++i];
+		}
+		else if (!strcmp(argv[i],"-irq") && (i+1 < argc))
+		{
+			irqPeriod = strtoul(argv[++i],0,0);
+			sSimulator.SetIRQPeriod(irqPeriod);
+		}
+		else if (!strcmp(argv[i],"-nmi") && (i+1 < argc))
+		{
+			nmiPeriod = strtoul(argv[++i],0,0);
+			sSimulator.SetNMIPeriod(nmiPeriod);
+		}
+		else if (!strcmp(argv[i],"-ticks") && (i+1 < argc))
+		{
+			sscanf(argv[++i],"%llu",&maxTicks);
+		}
+		else if (!strcmp(argv[i],"-peek") && (i+1 < argc) && (numPeeks < 16))
+		{
+			peeks[numPeeks++] = (unsigned short) strtoul(argv[++i],0,16);
+		}
+		else if (!strcmp(argv[i],"-copro") && (i+1 < argc))
+		{
+			coProcessorCount = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i],"-mhz") && (i+1 < argc))
+		{
+			clockMHz = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i],"-profile") && (i+1 < argc))
+		{
+			profilePrefix = argv[++i];
+		}
+		else if (!strcmp(argv[i],"-profileticks") && (i+1 < argc))
+		{
+			profileTicks = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i],"-tracefile") && (i+1 < argc))
+		{
+			traceFile = argv[++i];
+		}
+		else if (!strcmp(argv[i],"-traceticks"))
+		{
+			traceTicks = true;
+		}
+		else if (!strcmp(argv[i],"-ring") && (i+1 < argc))
+		{
+			ringMillions = strtoul(argv[++i],0,0);
+		}
+		else if (!strcmp(argv[i],"-dumptrace") && (i+1 < argc))
+		{
+			dumpTrace = argv[++i];
+		}
+		else if (!strcmp(argv[i],"-from") && (i+1 < argc))
+		{
+			sscanf(argv[++i],"%llu",&dumpFrom);
+		}
+		else if (!strcmp(argv[i],"-count") && (i+1 < argc))
+		{
+			sscanf(argv[++i],"%llu",&dumpCount);
+		}
+		else if (!strcmp(argv[i],"-vcd") && (i+1 < argc))
+		{
+			vcdFile = argv[++i];
+		}
+		else if (!strcmp(argv[i],"-vcdwindow") && (i+2 < argc))
+		{
+			unsigned long long firstTick = 0,ticks = 0;
+			sscanf(argv[++i],"%llu",&firstTick);
+			sscanf(argv[++i],"%llu",&ticks);
+			sVCDWriter.AddWindow(firstTick,ticks);
+		}
+		else if (!strcmp(argv[i],"-vcdsignals") && (i+1 < argc))
+		{
+			if (!sVCDWriter.AddFilter(argv[++i]))
+			{
+				return -1;
+			}
+		}
+		else if (!strcmp(argv[i],"-busmonitor"))
+		{
+			busMonitor = true;
+			if ((i+1 < argc) && (argv[i+1][0] >= '0') && (argv[i+1][0] <= '9'))
+			{
+				sBusMonitor.SetMaxReports(strtoul(argv[++i],0,0));
+			}
+		}
+		else if (!strcmp(argv[i],"-busmonitortest"))
+		{
+			busMonitorTest = true;
+		}
+		else if (!strcmp(argv[i],"-hotloops"))
+		{
+			hotLoops = 20;
+			if ((i+1 < argc) && (argv[i+1][0] >= '0') && (argv[i+1][0] <= '9'))
+			{
+				hotLoops = atoi(argv[++i]);
+			}
+		}
+		else if (!strcmp(argv[i],"-labels") && (i+1 < argc))
+		{
+			if (!sHotLoopDetector.LoadLabels(argv[++i]))
+			{
+				return -1;
+			}
+		}
+		else if (!strcmp(argv[i],"-cycles"))
+		{
+			cycles = true;
+		}
+		else if (!strcmp(argv[i],"-65c02"))
+		{
+			is65C02 = true;
+		}
+		else if (!strcmp(argv[i],"-coverage"))
+		{
+			coverage = true;
+		}
+		else if (!strcmp(argv[i],"-timing") && (i+1 < argc))
+		{
+			timingMHz = atof(argv[++i]);
+		}
+		else if (!strcmp(argv[i],"-analyze"))
+		{
+			analyze = true;
+		}
+		else if (!strcmp(argv[i],"-trace"))
+		{
+			trace = true;
+		}
+		else if (!strcmp(argv[i],"-blocktest"))
+		{
+			blockTest = true;
+		}
+		else if (i+1 < argc)
+		{
+			if (!sSimulator.LoadMemory(argv[i],strtoul(argv[i+1],0,16)))
+			{
+				return -1;
+			}
+			gotImage = true;
+			i++;
+		}
+		else
+		{
+			printf("Unknown option '%s'\n",argv[i]);
+			return -1;
+		}
+	}
+
+	if (dumpTrace)
+	{
+		return TraceRecorder::Dump(dumpTrace,dumpFrom,dumpCount) ? 0 : 1;
+	}
+
+	if (busMonitorTest)
+	{
+		return BusMonitor::SelfTest() ? 0 : 1;
+	}
+
+	if (!romPath)
+	{
+		romPath = is65C02 ? "../65C02/" : "../";
+	}
+
+	if (!sSimulator.LoadROMs(romPath))
+	{
+		return -1;
+	}
+
+	if (analyze)
+	{
+		ROMAnalyzer analyzer;
+		analyzer.Analyze(sSimulator);
+		analyzer.PrintReport();
+		return 0;
+	}
+
+	if (timingMHz > 0.0)
+	{
+		TimingAnalyzer analyzer;
+		analyzer.Analyze(sSimulator);
+		return analyzer.PrintReport(timingMHz,20) ? 2 : 0;
+	}
+
+	if (blockTest)
+	{
+		return RunBlockTest();
+	}
+
+	if (!gotImage && coProcessorCount)
+	{
+		char buffer[256];
+		sprintf(buffer,"%sCoProcessor.bin",romPath);
+		if (!sSimulator.LoadMemory(buffer,0xe000))
+		{
+			return -1;
+		}
+		gotImage = true;
+	}
+
+	if (coProcessorCount)
+	{
+		return RunCoProcessorBenchmark(coProcessorCount,clockMHz);
+	}
+
+	if (!gotImage)
+	{
+		char buffer[256];
+		sprintf(buffer,"%sKernalROM.bin",romPath);
+		if (!sSimulator.LoadMemory(buffer,0xe000))
+		{
+			return -1;
+		}
+		sprintf(buffer,"%sBASICROM.bin",romPath);
+		if (!sSimulator.LoadMemory(buffer,0xa000))
+		{
+			return -1;
+		}
+	}
+
+	sSimulator.Reset();
+
+	if (ringMillions)
+	{
+		sTraceRecorder.SetRingSize((size_t) ringMillions * 1000000);
+	}
+	else if (traceFile && !sTraceRecorder.Open(sSimulator,traceFile,!traceTicks))
+	{
+		return -1;
+	}
+	if (vcdFile && !sVCDWriter.Open(vcdFile,clockMHz))
+	{
+		return -1;
+	}
+	if (busMonitor && !BusMonitor::IsCompiledIn())
+	{
+		printf("The bus monitor is not compiled in, define SIMULATOR_BUS_MONITOR\n");
+		return -1;
+	}
+
+	unsigned long long instructions = 0;
+	// Ticks from the start of the IRQ or NMI entry up to the first opcode after the RTI. An NMI can interrupt an IRQ so the entries are stacked.
+	unsigned long long irqs = 0,irqTicks = 0;
+	unsigned long long nmis = 0,nmiTicks = 0;
+	// The latency is from the EXTWANTIRQ or EXTWANTNMI assertion to the first opcode of the handler, which includes the wait for the
+	// current opcode to finish. The entry is from the start of the entry to the first opcode of the handler, so it is only the microcode.
+	unsigned long long irqEntries = 0,irqLatency = 0,irqMaxLatency = 0,irqEntryTicks = 0;
+	unsigned long long nmiEntries = 0,nmiLatency = 0,nmiMaxLatency = 0,nmiEntryTicks = 0;
+	const int kMaxNesting = 16;
+	unsigned long long interruptStart[kMaxNesting];
+	unsigned long long interruptAsserted[kMaxNesting];
+	bool interruptIsNMI[kMaxNesting];
+	int nesting = 0;
+	// The nesting entry that has not reached the first opcode of its handler yet. There is no IRQ check during the entry so there is only one.
+	int entering = -1;
+	unsigned char lastOpcode = 0;
+	while (sSimulator.GetTotalTicks() < maxTicks)
+	{
+		// The continuations are part of the opcode they continue
+		if (sSimulator.IsOpcodeStart() && !sSimulator.IsContinuation())
+		{
+			instructions++;
+			if (nesting && (lastOpcode == kOpcodeRTI))
+			{
+				nesting--;
+				const unsigned long long ticks = sSimulator.GetTotalTicks() - interruptStart[nesting];
+				if (interruptIsNMI[nesting])
+				{
+					nmis++;
+					nmiTicks += ticks;
+				}
+				else
+				{
+					irqs++;
+					irqTicks += ticks;
+				}
+			}
+			if ((entering >= 0) && (sSimulator.GetOpcode() != kOpcodeStartIRQ))
+			{
+				// The handler starts at the vector, anything else is still part of the entry
+				const unsigned short vector = interruptIsNMI[entering] ? kNMIVector : kIRQVector;
+				if (sSimulator.GetPC() == (sSimulator.ReadMemory(vector) | (sSimulator.ReadMemory(vector+1) << 8)))
+				{
+					const unsigned long long latency = sSimulator.GetTotalTicks() - interruptAsserted[entering];
+					const unsigned long long entry = sSimulator.GetTotalTicks() - interruptStart[entering];
+					if (interruptIsNMI[entering])
+					{
+						nmiEntries++;
+						nmiLatency += latency;
+						nmiMaxLatency = (latency > nmiMaxLatency) ? latency : nmiMaxLatency;
+						nmiEntryTicks += entry;
+					}
+					else
+					{
+						irqEntries++;
+						irqLatency += latency;
+						irqMaxLatency = (latency > irqMaxLatency) ? latency : irqMaxLatency;
+						irqEntryTicks += entry;
+					}
+					entering = -1;
+				}
+			}
+			if ((sSimulator.GetOpcode() == kOpcodeStartIRQ) && (nesting < kMaxNesting))
+			{
+				interruptStart[nesting] = sSimulator.GetTotalTicks();
+				// The NMI state selects the NMI banks until the first opcode of the handler
+				interruptIsNMI[nesting] = (sSimulator.GetBank() & 4) ? true : false;
+				// EXTWANTIRQ and the EXTWANTNMI edge are asserted on multiples of their periods
+				const unsigned int period = interruptIsNMI[nesting] ? nmiPeriod : irqPeriod;
+				interruptAsserted[nesting] = interruptStart[nesting] - (period ? (interruptStart[nesting] % period) : 0);
+				entering = nesting;
+				nesting++;
+			}
+			lastOpcode = sSimulator.GetOpcode();
+			if (hotLoops)
+			{
+				sHotLoopDetector.Sample(sSimulator);
+			}
+			if (trace)
+			{
+				printf("%10llu $%04x : $%02x A=$%02x X=$%02x Y=$%02x SP=$%02x ST=$%02x\n",sSimulator.GetTotalTicks(),sSimulator.GetPC(),sSimulator.GetOpcode(),sSimulator.GetRegister(0),sSimulator.GetRegister(1),sSimulator.GetRegister(2),sSimulator.GetRegister(3),sSimulator.GetST());
+			}
+		}
+		if (profilePrefix || coverage || cycles)
+		{
+			sTickProfiler.Sample(sSimulator);
+		}
+		const bool running = sSimulator.Tick();
+		if (ringMillions)
+		{
+			sTraceRecorder.RecordRing(sSimulator);
+		}
+		else if (traceFile)
+		{
+			sTraceRecorder.Record(sSimulator);
+		}
+		if (vcdFile)
+		{
+			sVCDWriter.Record(sSimulator);
+		}
+		if (busMonitor)
+		{
+			sBusMonitor.Check(sSimulator);
+		}
+		if (!running)
+		{
+			break;
+		}
+	}
+
+	if (ringMillions)
+	{
+		if (sSimulator.IsHalted())
+		{
+			sTraceRecorder.DumpRing(sSimulator,traceFile ? traceFile : "Ring.trace");
+		}
+	}
+	else if (traceFile)
+	{
+		sTraceRecorder.Close();
+	}
+	if (vcdFile)
+	{
+		sVCDWriter.Close();
+	}
+
+	if (sSimulator.IsHalted())
+	{
+		printf("Halted at $%04x opcode $%02x\n",sSimulator.GetPC(),sSimulator.GetOpcode());
+	}
+	for (i=0;i<numPeeks;i++)
+	{
+		printf("$%04x = $%02x\n",peeks[i],sSimulator.ReadMemory(peeks[i]));
+	}
+	printf("Ticks %llu instructions %llu ticks/instruction %.2f\n",sSimulator.GetTotalTicks(),instructions,instructions ? (double)sSimulator.GetTotalTicks() / (double)instructions : 0.0);
+	if (irqs)
+	{
+		printf("IRQs %llu ticks/IRQ %.2f\n",irqs,(double)irqTicks / (double)irqs);
+	}
+	if (irqEntries)
+	{
+		printf("IRQ latency ticks to the handler average %.2f maximum %llu, entry ticks %.2f\n",(double)irqLatency / (double)irqEntries,irqMaxLatency,(double)irqEntryTicks / (double)irqEntries);
+	}
+	if (nmis)
+	{
+		printf("NMIs %llu ticks/NMI %.2f\n",nmis,(double)nmiTicks / (double)nmis);
+	}
+	if (nmiEntries)
+	{
+		printf("NMI latency ticks to the handler average %.2f maximum %llu, entry ticks %.2f\n",(double)nmiLatency / (double)nmiEntries,nmiMaxLatency,(double)nmiEntryTicks / (double)nmiEntries);
+	}
+
+	if (profilePrefix)
+	{
+		sTickProfiler.WriteHeatMap(profilePrefix);
+		sTickProfiler.PrintRanking(profileTicks,20);
+	}
+
+	if (cycles)
+	{
+		sTickProfiler.PrintCycleComparison(sSimulator,clockMHz,is65C02);
+	}
+
+	if (hotLoops)
+	{
+		sHotLoopDetector.PrintRanking(sSimulator.GetTotalTicks(),hotLoops);
+	}
+
+	int uncovered = 0;
+	if (coverage)
+	{
+		uncovered = sTickProfiler.PrintCoverage(sSimulator);
+	}
+
+	unsigned long long busViolations = 0;
+	if (busMonitor)
+	{
+		busViolations = sBusMonitor.PrintSummary(20);
+	}
+
+	if (sSimulator.IsHalted())
+	{
+		return 1;
+	}
+	if (uncovered)
+	{
+		return 2;
+	}
+	return busViolations ? 3 : 0;
+}